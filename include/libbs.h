@@ -28,6 +28,7 @@
 #define __BS_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,7 +58,8 @@ typedef enum BSresult {
 	BS_NULL,         /* NULL pointer passed as input */
 	BS_MEMORY,       /* Memory allocation problem */
 	BS_OVERFLOW,     /* Integer overflow */
-	BS_BAD_ENCODING  /* Unknown encoding scheme */
+	BS_BAD_ENCODING, /* Unknown encoding scheme */
+	BS_SHORT_BUFFER  /* Output buffer too short */
 } BSresult;
 
 /**
@@ -201,7 +203,17 @@ void bs_stream_reset(BS *bs);
  * Reads an encoded string into the byte stream.
  * Supported encodings currently include:
  *  - base64
+ *  - base64url
+ *  - base64mime (76-column lines separated by CRLF)
+ *  - base64pem  (64-column lines separated by LF)
+ *  - base32
+ *  - base32hex
+ *  - base32crockford (case-insensitive, unpadded; hyphens are ignored)
+ *  - ascii85 (without <~ ~> delimiters; 'z' abbreviates four zero bytes)
+ *  - z85     (a final partial group of N bytes is written as N + 1 digits)
  *  - hex
+ * The line-wrapped base64 encodings ignore whitespace (' ', HT, CR and LF)
+ * anywhere in the input, so there is no need to filter it out beforehand.
  * Returns BS_OK if the string is loaded correctly
  * Returns BS_MEMORY if memory cannot be allocated
  * Returns BS_INVALID if the input cannot be decoded, e.g. if the length is
@@ -216,6 +228,83 @@ BSresult bs_decode(
 	size_t length
 );
 
+/**
+ * Decode a string, skipping separators
+ * Loads the byte stream from INPUT as for bs_decode(), but first drops every
+ * character whose bit is set in SKIP (laid out as for bs_filter_bitmap()).
+ * This suits input broken up by separators, e.g. "de:ad:be:ef" as hex with ':'
+ * skipped. For most encodings, filtering and decoding proceed together a small
+ * chunk at a time, so no filtered copy of the whole input is made. Encodings
+ * with variable-length groups (ascii85) filter into a temporary copy of the
+ * whole input first.
+ * Padding may only appear at the end of the filtered input.
+ * Returns BS_OK if the string is loaded correctly
+ * Returns BS_MEMORY if memory cannot be allocated
+ * Returns BS_INVALID if the filtered input cannot be decoded
+ * Returns BS_BAD_ENCODING if the specified encoding is not known
+ * Do not attempt to use the bytestream if the return value is other than BS_OK.
+ */
+BSresult bs_decode_skip(
+	BS *bs,
+	const char *encoding,
+	const char *input,
+	size_t length,
+	const BSbyte skip[32]
+);
+
+/**
+ * Decode a string into a buffer
+ * Decodes INPUT with the specified ENCODING, writing the bytes to OUTPUT rather
+ * than to a byte stream. OUTPUT must be at least CAPACITY bytes long; the number
+ * of bytes decoded is passed back in WRITTEN.
+ * Returns BS_OK if the string is decoded correctly
+ * Returns BS_SHORT_BUFFER if CAPACITY is too small, in which case nothing is
+ * written. bs_decode_validate can be used to find the size needed.
+ * Returns BS_INVALID if the input cannot be decoded
+ * Returns BS_BAD_ENCODING if the specified encoding is not known
+ * Do not attempt to use OUTPUT if the return value is other than BS_OK.
+ */
+BSresult bs_decode_into(
+	const char *encoding,
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t capacity,
+	size_t *written
+);
+
+/**
+ * Decode a byte stream in place
+ * Treats the contents of the byte stream as a string with the specified
+ * ENCODING, and replaces them with the decoded bytes.
+ * Encodings which never produce more bytes than they read are decoded over the
+ * stream's own buffer without any allocation. Others (i.e. ascii85) are decoded
+ * into a new buffer which then replaces the old one.
+ * Returns BS_OK if the stream is decoded correctly
+ * Returns BS_MEMORY if memory cannot be allocated
+ * Returns BS_INVALID if the contents cannot be decoded
+ * Returns BS_BAD_ENCODING if the specified encoding is not known
+ * Do not attempt to use the bytestream if the return value is other than BS_OK.
+ */
+BSresult bs_decode_in_place(BS *bs, const char *encoding);
+
+/**
+ * Validate an encoded string
+ * Checks that INPUT could be decoded with the specified ENCODING, and passes
+ * back the number of bytes that decoding would produce in SIZE.
+ * Nothing is allocated and nothing is written other than SIZE, so this is a
+ * cheap way to reject bad input before committing any memory to it.
+ * Returns BS_OK if the string is valid
+ * Returns BS_INVALID if the input cannot be decoded
+ * Returns BS_BAD_ENCODING if the specified encoding is not known
+ */
+BSresult bs_decode_validate(
+	const char *encoding,
+	const char *input,
+	size_t length,
+	size_t *size
+);
+
 /**
  * Size an encoded string
  * Passes the size of the buffer required to write the byte stream as a string
@@ -237,6 +326,38 @@ BSresult bs_encode_size(const BS *bs, const char *encoding, size_t *size);
  */
 BSresult bs_encode(const BS *bs, const char *encoding, char *output);
 
+/**
+ * A pool of threads
+ * Parallel operations share their work out between the threads of a pool.
+ * Work is split into ranges of a few tens of kilobytes, and each thread claims
+ * a new range whenever it finishes one, so the load stays balanced even if some
+ * threads are held up.
+ * A pool runs one operation at a time: if several threads use the same pool
+ * then their operations are queued.
+ */
+typedef struct BSpool BSpool;
+
+/**
+ * Create a thread pool
+ * Creates a pool which runs operations with THREADS threads in total, counting
+ * the thread which calls the operation; a THREADS of 0 means one per processor.
+ * Returns NULL if memory cannot be allocated or threads cannot be started.
+ */
+BSpool *bs_pool_create(size_t threads);
+
+/**
+ * Free a thread pool
+ * Stops the pool's threads and frees all memory used by the pool.
+ * Once a pool pointer has been freed then it should not be reused.
+ */
+void bs_pool_free(BSpool *pool);
+
+/**
+ * Count threads in a pool
+ * Returns the number of threads that operations run with, including the caller.
+ */
+size_t bs_pool_threads(const BSpool *pool);
+
 /**
  * Map a byte stream
  * Applies an OPERATION to each byte in a byte stream.
@@ -246,6 +367,105 @@ BSresult bs_encode(const BS *bs, const char *encoding, char *output);
  */
 BSresult bs_map(BS *bs, BSbyte (*operation) (BSbyte byte));
 
+/**
+ * Map a byte stream in parallel
+ * As bs_map, but shares the work between the threads of POOL.
+ * OPERATION is called from several threads at once, and so must be thread-safe.
+ * A NULL pool runs everything on the calling thread.
+ * Returns BS_OK if all bytes are processed successfully
+ */
+BSresult bs_map_parallel(
+	BS *bs,
+	BSbyte (*operation) (BSbyte byte),
+	BSpool *pool
+);
+
+/**
+ * Map a byte stream with context
+ * As bs_map, but OPERATION is also passed the INDEX of each byte within the
+ * stream and the DATA pointer, so it can keep state between calls.
+ * Returns BS_OK if all bytes are processed successfully
+ */
+BSresult bs_map_ctx(
+	BS *bs,
+	BSbyte (*operation) (BSbyte byte, size_t index, void *data),
+	void *data
+);
+
+/**
+ * Map a byte stream in blocks
+ * Passes the byte stream to OPERATION BLOCK_SIZE bytes at a time (the last
+ * block may be shorter), along with the OFFSET of the block within the stream
+ * and the DATA pointer. The operation should update the block in place.
+ * Handling many bytes per call lets the operation use its own fast loops.
+ * Returns BS_OK if all blocks are processed successfully
+ * Returns BS_INVALID if BLOCK_SIZE is zero
+ * Returns failure code from the operation if it doesn't return BS_OK, in which
+ * case later blocks are left untouched
+ */
+BSresult bs_map_blocks(
+	BS *bs,
+	size_t block_size,
+	BSresult (*operation) (
+		BSbyte *block,
+		size_t length,
+		size_t offset,
+		void *data
+	),
+	void *data
+);
+
+/**
+ * Map a byte stream into another
+ * As bs_map, but reads from SRC and writes the results to DST, which is resized
+ * to match. SRC is left untouched, and DST may be the same stream as SRC.
+ * Returns BS_OK if all bytes are processed successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_map_to(
+	BS *dst,
+	const BS *src,
+	BSbyte (*operation) (BSbyte byte)
+);
+
+/**
+ * Map a byte stream through a table
+ * Replaces each byte in a byte stream with the corresponding entry from TABLE,
+ * i.e. byte = table[byte].
+ * This avoids a function call per byte, and so is much quicker than bs_map.
+ * Returns BS_OK if all bytes are processed successfully
+ */
+BSresult bs_map_table(BS *bs, const BSbyte table[256]);
+
+/**
+ * Map a byte stream through a table in parallel
+ * As bs_map_table, but shares the work between the threads of POOL.
+ * A NULL pool runs everything on the calling thread.
+ * Returns BS_OK if all bytes are processed successfully
+ */
+BSresult bs_map_table_parallel(
+	BS *bs,
+	const BSbyte table[256],
+	BSpool *pool
+);
+
+/**
+ * Map a byte stream into another through a table
+ * As bs_map_table, but reads from SRC and writes the results to DST, which is
+ * resized to match. SRC is left untouched, and DST may be the same as SRC.
+ * Returns BS_OK if all bytes are processed successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_map_table_to(BS *dst, const BS *src, const BSbyte table[256]);
+
+/**
+ * Build a mapping table
+ * Fills TABLE with the result of applying OPERATION to every possible byte.
+ * The table can then be used with bs_map_table as many times as needed.
+ * Returns BS_OK if the table is built successfully
+ */
+BSresult bs_map_compile(BSbyte table[256], BSbyte (*operation) (BSbyte byte));
+
 /**
  * Make characters uppercase
  */
@@ -261,6 +481,67 @@ BSresult bs_map_lowercase(BS *bs);
  */
 BSresult bs_map_not(BS *bs);
 
+/**
+ * A chain of maps
+ * Several maps can be added to a chain, which composes them into a single
+ * table as they are added. Applying the chain then needs just one pass over the
+ * byte stream, however many maps it contains.
+ * A chain isn't changed by being applied, so can be reused for many streams.
+ */
+typedef struct BSmapchain BSmapchain;
+
+/**
+ * Create a map chain
+ * Creates an empty chain (which leaves every byte unchanged) and returns a
+ * pointer to it.
+ * Returns NULL if memory cannot be allocated.
+ */
+BSmapchain *bs_mapchain_create(void);
+
+/**
+ * Free a map chain
+ * Once a chain pointer has been freed then it should not be reused.
+ */
+void bs_mapchain_free(BSmapchain *chain);
+
+/**
+ * Add a map to a chain
+ * OPERATION will be applied after all maps already in the chain.
+ * It is called exactly 256 times, straight away, so needn't outlive this call.
+ * Returns BS_OK if the map is added successfully
+ */
+BSresult bs_mapchain_add(BSmapchain *chain, BSbyte (*operation) (BSbyte byte));
+
+/**
+ * Add a mapping table to a chain
+ * TABLE will be applied after all maps already in the chain, as for
+ * bs_map_table. It is not referenced again once this call returns.
+ * Returns BS_OK if the table is added successfully
+ */
+BSresult bs_mapchain_add_table(BSmapchain *chain, const BSbyte table[256]);
+
+/**
+ * Add uppercasing to a chain
+ */
+BSresult bs_mapchain_add_uppercase(BSmapchain *chain);
+
+/**
+ * Add lowercasing to a chain
+ */
+BSresult bs_mapchain_add_lowercase(BSmapchain *chain);
+
+/**
+ * Add NOT to a chain
+ */
+BSresult bs_mapchain_add_not(BSmapchain *chain);
+
+/**
+ * Map a byte stream through a chain
+ * Applies every map in CHAIN to each byte, in the order they were added.
+ * Returns BS_OK if all bytes are processed successfully
+ */
+BSresult bs_map_chain(BS *bs, const BSmapchain *chain);
+
 /**
  * Filter operation result ENUM
  * Filtering operations return values to indicate whether a byte should be
@@ -280,12 +561,165 @@ typedef enum BSfilter {
  */
 BSresult bs_filter(BS *bs, BSfilter (*operation) (BSbyte byte));
 
+/**
+ * Filter a byte stream with context
+ * As bs_filter, but OPERATION is also passed the INDEX of each byte within the
+ * original stream and the DATA pointer, so it can keep state between calls.
+ * Returns BS_OK if all bytes are read successfully
+ */
+BSresult bs_filter_ctx(
+	BS *bs,
+	BSfilter (*operation) (BSbyte byte, size_t index, void *data),
+	void *data
+);
+
+/**
+ * Filter a byte stream in blocks
+ * Passes the byte stream to OPERATION BLOCK_SIZE bytes at a time (the last
+ * block may be shorter), along with the OFFSET of the block within the original
+ * stream and the DATA pointer.
+ * The operation should move the bytes it wants to keep to the start of the
+ * block, in order, and set KEPT to their number. KEPT starts out as the length
+ * of the block, so an operation which keeps everything needn't touch it.
+ * Returns BS_OK if all blocks are processed successfully
+ * Returns BS_INVALID if BLOCK_SIZE is zero, or if KEPT is set too large
+ * Returns failure code from the operation if it doesn't return BS_OK
+ * On failure the stream holds the bytes kept from the blocks before the failing
+ * one.
+ */
+BSresult bs_filter_blocks(
+	BS *bs,
+	size_t block_size,
+	BSresult (*operation) (
+		BSbyte *block,
+		size_t length,
+		size_t offset,
+		size_t *kept,
+		void *data
+	),
+	void *data
+);
+
+/**
+ * Filter a byte stream into another
+ * As bs_filter, but reads from SRC and writes the bytes which are kept to DST.
+ * SRC is left untouched, and DST may be the same stream as SRC.
+ * Returns BS_OK if all bytes are read successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_filter_to(
+	BS *dst,
+	const BS *src,
+	BSfilter (*operation) (BSbyte byte)
+);
+
+/**
+ * Remove a set of bytes from a byte stream
+ * Removes every byte which appears among the LENGTH bytes at SET.
+ * Returns BS_OK if all bytes are read successfully
+ */
+BSresult bs_filter_set(BS *bs, const BSbyte *set, size_t length);
+
+/**
+ * Remove bytes matching a bitmap
+ * Treats BITMAP as a set of 256 bits, and removes each byte B for which bit
+ * (B % 8) of BITMAP[B / 8] is set.
+ * This is much quicker than bs_filter, as no function is called per byte.
+ * Returns BS_OK if all bytes are read successfully
+ */
+BSresult bs_filter_bitmap(BS *bs, const BSbyte bitmap[32]);
+
+/**
+ * Filter a byte stream in parallel
+ * As bs_filter, but shares the work between the threads of POOL. The bytes kept
+ * are left in their original order.
+ * OPERATION is called from several threads at once, and so must be thread-safe.
+ * A NULL pool runs everything on the calling thread.
+ * Returns BS_OK if all bytes are read successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_filter_parallel(
+	BS *bs,
+	BSfilter (*operation) (BSbyte byte),
+	BSpool *pool
+);
+
+/**
+ * Filter a byte stream into another in parallel
+ * As bs_filter_to, but shares the work between the threads of POOL.
+ * Returns BS_OK if all bytes are read successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_filter_to_parallel(
+	BS *dst,
+	const BS *src,
+	BSfilter (*operation) (BSbyte byte),
+	BSpool *pool
+);
+
+/**
+ * Remove bytes matching a bitmap in parallel
+ * As bs_filter_bitmap, but shares the work between the threads of POOL.
+ * Returns BS_OK if all bytes are read successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_filter_bitmap_parallel(
+	BS *bs,
+	const BSbyte bitmap[32],
+	BSpool *pool
+);
+
 /**
  * Remove whitespace from a bytes stream
  * Removes ' ', HT, CR and LF characters from the byte stream.
  */
 BSresult bs_filter_whitespace(BS *bs);
 
+/**
+ * Substitute sequences for bytes
+ * Replaces each byte B for which TABLE[B] isn't NULL with the string TABLE[B]
+ * (less its terminating NUL). An empty string removes the byte.
+ * The new length is found first, so the stream is resized at most once.
+ * Returns BS_OK if the stream is rewritten successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_substitute(BS *bs, const char *const table[256]);
+
+/**
+ * Escape a byte stream for a C string literal
+ * Escapes '"' and '\\' with a backslash, writes BEL through CR as \a, \b, \t,
+ * \n, \v, \f and \r, and writes other control bytes and bytes above '~' as
+ * three octal digits (e.g. \177).
+ * Returns BS_OK if the stream is rewritten successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_escape_c(BS *bs);
+
+/**
+ * Percent-encode a byte stream
+ * Writes all bytes other than letters, digits, '-', '.', '_' and '~' as '%'
+ * followed by two uppercase hex digits, as for URIs (RFC 3986).
+ * Returns BS_OK if the stream is rewritten successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_escape_percent(BS *bs);
+
+/**
+ * Replace a sequence of bytes
+ * Replaces each occurrence of the CBFIND bytes at FIND with the CBREPLACEMENT
+ * bytes at REPLACEMENT. Occurrences are found left to right and don't overlap.
+ * Returns BS_OK if the stream is rewritten successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ * Returns BS_INVALID if CBFIND is zero
+ */
+BSresult bs_replace(
+	BS *bs,
+	const BSbyte *find,
+	size_t cbFind,
+	const BSbyte *replacement,
+	size_t cbReplacement
+);
+
 /**
  * Collect a single value from a byte stream
  * Applies OPERATION to the byte stream, passing each byte in turn.
@@ -300,6 +734,57 @@ BSresult bs_fold(
 	void *data
 );
 
+/**
+ * Collect a single value from a byte stream in blocks
+ * Passes the byte stream to OPERATION BLOCK_SIZE bytes at a time (the last
+ * block may be shorter), along with the DATA pointer in which the operation
+ * should maintain its value.
+ * Handling many bytes per call lets the operation use its own fast loops.
+ * Returns BS_OK if all blocks are read successfully
+ * Returns BS_INVALID if BLOCK_SIZE is zero
+ * Returns failure code from the operation if it doesn't return BS_OK, in which
+ * case later blocks aren't read
+ */
+BSresult bs_fold_blocks(
+	const BS *bs,
+	size_t block_size,
+	BSresult (*operation) (const BSbyte *block, size_t length, void *data),
+	void *data
+);
+
+/**
+ * Collect a single value from a byte stream in parallel
+ * Splits the byte stream into ranges which are shared between the threads of
+ * POOL. Each range starts with a copy of the VALUE_SIZE bytes at IDENTITY, and
+ * is folded into it by REDUCE. The values of the ranges are then merged into
+ * VALUE by COMBINE, which is passed the value so far and the value for the
+ * next range along; the first range is combined with a copy of IDENTITY.
+ * COMBINE must be associative, but needn't be commutative: ranges are always
+ * combined in order on the calling thread, so the result doesn't depend on the
+ * number of threads. REDUCE is called from several threads at once, and so
+ * must be thread-safe. DATA is passed to both operations.
+ * A NULL pool runs everything on the calling thread.
+ * Returns BS_OK if the stream is folded successfully
+ * Returns BS_INVALID if VALUE_SIZE is zero
+ * Returns BS_MEMORY if memory cannot be allocated
+ * Returns failure code from an operation if it doesn't return BS_OK
+ */
+BSresult bs_fold_parallel(
+	const BS *bs,
+	void *value,
+	size_t value_size,
+	const void *identity,
+	BSresult (*reduce) (
+		const BSbyte *block,
+		size_t length,
+		void *value,
+		void *data
+	),
+	BSresult (*combine) (void *value, const void *other, void *data),
+	void *data,
+	BSpool *pool
+);
+
 /**
  * Add a byte stream
  * Adds all bytes together.
@@ -314,6 +799,382 @@ BSresult bs_fold_sum(const BS *bs, unsigned int *sum);
  */
 BSresult bs_fold_bitcount(const BS *bs, unsigned int *count);
 
+/**
+ * Count bits in a stream with a 64-bit result
+ * As bs_fold_bitcount, but counts into 64 bits so cannot overflow. Large
+ * streams are counted a vector at a time using the best instructions available.
+ * Returns BS_OK if the bits are counted successfully
+ */
+BSresult bs_popcount(const BS *bs, uint64_t *count);
+
+/**
+ * Count bits in a stream in parallel
+ * As bs_popcount, but shares the work between the threads of POOL.
+ * Returns BS_OK if the bits are counted successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_popcount_parallel(const BS *bs, uint64_t *count, BSpool *pool);
+
+/**
+ * Add a byte stream with a 64-bit result
+ * As bs_fold_sum, but adds into 64 bits so cannot overflow. Streams are summed
+ * a vector at a time where possible.
+ * Returns BS_OK if the bytes are added successfully
+ */
+BSresult bs_sum64(const BS *bs, uint64_t *sum);
+
+/**
+ * Add a byte stream in parallel
+ * As bs_sum64, but shares the work between the threads of POOL.
+ * Returns BS_OK if the bytes are added successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_sum64_parallel(const BS *bs, uint64_t *sum, BSpool *pool);
+
+/**
+ * Add a byte stream with positional weights
+ * Passes back the plain sum of the bytes in SUM, and in WEIGHTED the sum of
+ * each byte multiplied by its distance from the end of the stream (so the last
+ * byte is weighted one, and the first by the length of the stream). This is
+ * the same as the total of the running sums, which is the second half of
+ * Fletcher and Adler style checksums before any reduction.
+ * WEIGHTED is calculated modulo 2^64.
+ * Returns BS_OK if the bytes are added successfully
+ */
+BSresult bs_sum64_weighted(const BS *bs, uint64_t *sum, uint64_t *weighted);
+
+/**
+ * Count each byte value in a stream
+ * Sets COUNTS[b] to the number of times that the byte b appears in the stream.
+ * Returns BS_OK if the bytes are counted successfully
+ */
+BSresult bs_histogram(const BS *bs, uint64_t counts[256]);
+
+/**
+ * Count each byte value in a stream in parallel
+ * As bs_histogram, but shares the work between the threads of POOL.
+ * Returns BS_OK if the bytes are counted successfully
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_histogram_parallel(
+	const BS *bs,
+	uint64_t counts[256],
+	BSpool *pool
+);
+
+/**
+ * Calculate the entropy of a histogram
+ * Passes back the Shannon entropy of the byte values counted in COUNTS, in
+ * bits per byte. This ranges from zero (a single value, or no values at all)
+ * up to eight (every value equally likely).
+ * Returns BS_OK if the entropy is calculated successfully
+ */
+BSresult bs_histogram_entropy(const uint64_t counts[256], double *entropy);
+
+/**
+ * Test a histogram for uniformity
+ * Passes back the chi-squared statistic of the byte values counted in COUNTS
+ * against a uniform distribution, which has 255 degrees of freedom. Random
+ * data should score around 255; text scores in the thousands. An empty
+ * histogram scores zero.
+ * Returns BS_OK if the statistic is calculated successfully
+ */
+BSresult bs_histogram_chi_squared(
+	const uint64_t counts[256],
+	double *chi_squared
+);
+
+/**
+ * Statistics ENUM
+ * Statistics which can be collected by bs_stats(). Flags are combined with
+ * bitwise OR.
+ */
+typedef enum BSstat {
+	BS_STAT_SUM       = 0x0001,
+	BS_STAT_POPCOUNT  = 0x0002,
+	BS_STAT_MIN       = 0x0004,
+	BS_STAT_MAX       = 0x0008,
+	BS_STAT_HISTOGRAM = 0x0010,
+	BS_STAT_ALL       = 0x001F
+} BSstat;
+
+/**
+ * Statistics structure
+ * Holds the statistics collected by bs_stats(). Fields which weren't requested
+ * are left untouched.
+ */
+typedef struct BSstats {
+	uint64_t sum;          /* Sum of the bytes, as for bs_sum64() */
+	uint64_t popcount;     /* Count of bits set, as for bs_popcount() */
+	BSbyte min;            /* Smallest byte, or 255 if there are none */
+	BSbyte max;            /* Largest byte, or 0 if there are none */
+	uint64_t counts[256];  /* Count of each byte value, as for bs_histogram() */
+} BSstats;
+
+/**
+ * Collect several statistics from a stream at once
+ * Collects each of the BSstat flags given in STATS into RESULT. The stream is
+ * worked through a cache-sized block at a time, with each statistic collected
+ * from the block before moving on, so it's only read from memory once however
+ * many statistics are requested.
+ * Returns BS_OK if the statistics are collected successfully
+ * Returns BS_INVALID if STATS contains unknown flags
+ */
+BSresult bs_stats(const BS *bs, unsigned int stats, BSstats *result);
+
+/**
+ * Calculate a CRC-32
+ * Passes back the CRC-32 of the stream in CRC, as used by zlib, gzip, PNG and
+ * Ethernet. Large streams use carry-less multiplication where available.
+ * Returns BS_OK if the CRC is calculated successfully
+ */
+BSresult bs_crc32(const BS *bs, uint32_t *crc);
+
+/**
+ * Continue a CRC-32
+ * Updates the CRC-32 in CRC to take in the bytes of the stream, as though they
+ * followed the bytes already checksummed. Starting from zero and updating with
+ * each piece of a message in turn gives the CRC-32 of the whole message, so
+ * this can be called from a bs_stream() operation.
+ * Returns BS_OK if the CRC is calculated successfully
+ */
+BSresult bs_crc32_update(const BS *bs, uint32_t *crc);
+
+/**
+ * Calculate a CRC-32C
+ * Passes back the CRC-32C (Castagnoli) of the stream in CRC, as used by iSCSI,
+ * SCTP and ext4. Large streams use the SSE4.2 crc32 instruction where
+ * available.
+ * Returns BS_OK if the CRC is calculated successfully
+ */
+BSresult bs_crc32c(const BS *bs, uint32_t *crc);
+
+/**
+ * Continue a CRC-32C
+ * As bs_crc32_update, but for CRC-32C.
+ * Returns BS_OK if the CRC is calculated successfully
+ */
+BSresult bs_crc32c_update(const BS *bs, uint32_t *crc);
+
+/**
+ * Calculate an Adler-32 checksum
+ * Passes back the Adler-32 checksum of the stream in ADLER, as used by zlib.
+ * Returns BS_OK if the checksum is calculated successfully
+ */
+BSresult bs_adler32(const BS *bs, uint32_t *adler);
+
+/**
+ * Continue an Adler-32 checksum
+ * Updates the Adler-32 checksum in ADLER to take in the bytes of the stream, as
+ * though they followed the bytes already checksummed. Starting from one (the
+ * checksum of an empty stream) and updating with each piece of a message in
+ * turn gives the checksum of the whole message, so this can be called from a
+ * bs_stream() operation.
+ * Returns BS_OK if the checksum is calculated successfully
+ */
+BSresult bs_adler32_update(const BS *bs, uint32_t *adler);
+
+/**
+ * Calculate a Fletcher-16 checksum
+ * Passes back the Fletcher-16 checksum of the stream in FLETCHER, with both
+ * sums taken modulo 255.
+ * Returns BS_OK if the checksum is calculated successfully
+ */
+BSresult bs_fletcher16(const BS *bs, uint16_t *fletcher);
+
+/**
+ * Continue a Fletcher-16 checksum
+ * As bs_adler32_update, but for Fletcher-16, which starts from zero.
+ * Returns BS_OK if the checksum is calculated successfully
+ */
+BSresult bs_fletcher16_update(const BS *bs, uint16_t *fletcher);
+
+/**
+ * Calculate a Fletcher-32 checksum
+ * Passes back the Fletcher-32 checksum of the stream in FLETCHER. The stream
+ * is read as little-endian 16-bit words, with both sums taken modulo 65535. A
+ * stream of odd length is padded with a zero byte.
+ * Returns BS_OK if the checksum is calculated successfully
+ */
+BSresult bs_fletcher32(const BS *bs, uint32_t *fletcher);
+
+/**
+ * Continue a Fletcher-32 checksum
+ * As bs_adler32_update, but for Fletcher-32, which starts from zero. Every
+ * piece of a message but the last must have an even length, as an odd-length
+ * stream is padded as though it ended the message.
+ * Returns BS_OK if the checksum is calculated successfully
+ */
+BSresult bs_fletcher32_update(const BS *bs, uint32_t *fletcher);
+
+/**
+ * A 128-bit hash
+ */
+typedef struct BShash128 {
+	uint64_t low;   /* Low 64 bits */
+	uint64_t high;  /* High 64 bits */
+} BShash128;
+
+/**
+ * Hash a byte stream
+ * Passes back a fast 64-bit hash of the stream in HASH, suitable for hash
+ * tables and spotting duplicates but not for security. Hashes are XXH3, and
+ * match those from xxHash 0.8 and later.
+ * Long streams are hashed a vector at a time where possible.
+ * Returns BS_OK if the stream is hashed successfully
+ */
+BSresult bs_hash64(const BS *bs, uint64_t *hash);
+
+/**
+ * Hash a byte stream with a seed
+ * As bs_hash64, but hashes differently for each SEED. A seed of zero gives
+ * the same results as bs_hash64.
+ * Returns BS_OK if the stream is hashed successfully
+ */
+BSresult bs_hash64_seeded(const BS *bs, uint64_t seed, uint64_t *hash);
+
+/**
+ * Hash a byte stream to 128 bits
+ * As bs_hash64, but with a 128-bit result (XXH3-128) for when collisions
+ * between many streams must be avoided.
+ * Returns BS_OK if the stream is hashed successfully
+ */
+BSresult bs_hash128(const BS *bs, BShash128 *hash);
+
+/**
+ * Hash a byte stream to 128 bits with a seed
+ * As bs_hash128, but hashes differently for each SEED.
+ * Returns BS_OK if the stream is hashed successfully
+ */
+BSresult bs_hash128_seeded(const BS *bs, uint64_t seed, BShash128 *hash);
+
+/**
+ * Hash state
+ * Hashes a message which arrives in pieces, giving the same result as hashing
+ * the whole message at once. Either size of hash can be taken from a state.
+ */
+typedef struct BShashstate BShashstate;
+
+/**
+ * Create a hash state
+ * Creates a state for hashing a new message with SEED (zero to match
+ * bs_hash64 and bs_hash128) and returns a pointer to it.
+ * Returns NULL if memory cannot be allocated.
+ */
+BShashstate *bs_hashstate_create(uint64_t seed);
+
+/**
+ * Free a hash state
+ * Once a state pointer has been freed then it should not be reused.
+ */
+void bs_hashstate_free(BShashstate *state);
+
+/**
+ * Reset a hash state
+ * Forgets everything hashed so far, ready for a new message with SEED.
+ */
+void bs_hashstate_reset(BShashstate *state, uint64_t seed);
+
+/**
+ * Add to a hash
+ * Hashes the bytes of the stream as the next piece of the message. This can be
+ * called from a bs_stream() operation.
+ * Returns BS_OK if the stream is hashed successfully
+ */
+BSresult bs_hashstate_update(BShashstate *state, const BS *bs);
+
+/**
+ * Get a 64-bit hash
+ * Passes back the 64-bit hash of the message so far in HASH. The state isn't
+ * changed, so more can be added afterwards.
+ * Returns BS_OK if the hash is calculated successfully
+ */
+BSresult bs_hashstate_digest64(const BShashstate *state, uint64_t *hash);
+
+/**
+ * Get a 128-bit hash
+ * As bs_hashstate_digest64, but for the 128-bit hash.
+ * Returns BS_OK if the hash is calculated successfully
+ */
+BSresult bs_hashstate_digest128(const BShashstate *state, BShash128 *hash);
+
+/**
+ * Running fold state
+ * Carries one of the built-in reductions across the pieces of a message, so
+ * that a message which arrives through bs_stream() can be checksummed or
+ * summarised while each piece is still in cache, giving the same result as
+ * folding the whole message at once.
+ */
+typedef struct BSfoldstate BSfoldstate;
+
+/**
+ * Create a fold state
+ * Creates a state for the named REDUCTION, ready for a new message, and
+ * returns a pointer to it. Reductions and the values that they pass back are:
+ *  - sum        (uint64_t, as for bs_sum64)
+ *  - popcount   (uint64_t, as for bs_popcount)
+ *  - weighted   (uint64_t[2], the sum and weighted sum of bs_sum64_weighted)
+ *  - histogram  (uint64_t[256], as for bs_histogram)
+ *  - stats      (BSstats, with every statistic of bs_stats)
+ *  - crc32      (uint32_t, as for bs_crc32)
+ *  - crc32c     (uint32_t, as for bs_crc32c)
+ *  - adler32    (uint32_t, as for bs_adler32)
+ *  - fletcher16 (uint16_t, as for bs_fletcher16)
+ *  - fletcher32 (uint32_t, as for bs_fletcher32; pieces may have odd lengths)
+ *  - xxh3-64    (uint64_t, as for bs_hash64)
+ *  - xxh3-128   (BShash128, as for bs_hash128)
+ * Returns NULL if the reduction is not known or memory cannot be allocated.
+ */
+BSfoldstate *bs_foldstate_create(const char *reduction);
+
+/**
+ * Free a fold state
+ * Once a state pointer has been freed then it should not be reused.
+ */
+void bs_foldstate_free(BSfoldstate *state);
+
+/**
+ * Reset a fold state
+ * Forgets everything folded so far, ready for a new message.
+ */
+void bs_foldstate_reset(BSfoldstate *state);
+
+/**
+ * Add to a fold
+ * Folds the bytes of the stream in as the next piece of the message.
+ * Returns BS_OK if the stream is folded successfully
+ */
+BSresult bs_foldstate_update(BSfoldstate *state, const BS *bs);
+
+/**
+ * Fold from a stream operation
+ * As bs_foldstate_update, with the state passed as DATA, so that it can be
+ * passed straight to bs_stream() and bs_stream_flush() as the operation.
+ * Returns BS_OK if the stream is folded successfully
+ */
+BSresult bs_foldstate_operation(const BS *bs, void *data);
+
+/**
+ * Get the size of a fold's value
+ * Passes back the number of bytes that bs_foldstate_final() writes in SIZE.
+ * Returns BS_OK if the size is passed back successfully
+ */
+BSresult bs_foldstate_size(const BSfoldstate *state, size_t *size);
+
+/**
+ * Get the value of a fold
+ * Writes the value of the message so far to RESULT, which must point to SIZE
+ * bytes of the type listed for the reduction under bs_foldstate_create(). The
+ * state isn't changed, so more can be added afterwards.
+ * Returns BS_OK if the value is written successfully
+ * Returns BS_SHORT_BUFFER if SIZE is too small for the value
+ */
+BSresult bs_foldstate_final(
+	const BSfoldstate *state,
+	void *result,
+	size_t size
+);
+
 /**
  * Compare two byte streams
  * Applies OPERATION to two byte streams, passing in a byte from each.
@@ -344,8 +1205,6 @@ BSresult bs_compare_equal(const BS *bs1, const BS *bs2);
  */
 BSresult bs_compare_hamming(const BS *bs1, const BS *bs2, unsigned int *distance);
 
-#endif /* __BS_H */
-
 /**
  * Combine two byte streams
  * Applies an operand byte stream based on an operation. OPERAND is duplicated
@@ -360,6 +1219,29 @@ BSresult bs_compare_hamming(const BS *bs1, const BS *bs2, unsigned int *distance
 BSresult bs_combine(BS *bs, const BS *operand,
 	BSbyte (*operation) (BSbyte byte1, BSbyte byte2));
 
+/**
+ * Combine two byte streams in parallel
+ * As bs_combine, but shares the work between the threads of POOL.
+ * OPERATION is called from several threads at once, and so must be thread-safe.
+ * A NULL pool runs everything on the calling thread.
+ * Returns BS_OK if all bytes are combined successfully
+ * Returns BS_INVALID for zero-length operand
+ */
+BSresult bs_combine_parallel(BS *bs, const BS *operand,
+	BSbyte (*operation) (BSbyte byte1, BSbyte byte2), BSpool *pool);
+
+/**
+ * Combine two byte streams into a third
+ * As bs_combine, but reads from SRC and writes the results to DST, which is
+ * resized to match. SRC and OPERAND are left untouched.
+ * DST may be the same stream as SRC, but must not be OPERAND.
+ * Returns BS_OK if all bytes are combined successfully
+ * Returns BS_INVALID for zero-length operand
+ * Returns BS_MEMORY if memory cannot be allocated
+ */
+BSresult bs_combine_to(BS *dst, const BS *src, const BS *operand,
+	BSbyte (*operation) (BSbyte byte1, BSbyte byte2));
+
 /**
  * XOR two byte streams
  */
@@ -387,6 +1269,41 @@ BSresult bs_combine_add(BS *bs, const BS *operand);
  */
 BSresult bs_combine_sub(BS *bs, const BS *operand);
 
+/**
+ * Processor features ENUM
+ * Optional instruction set extensions which the library can use to speed up
+ * processing. Flags are combined with bitwise OR.
+ */
+typedef enum BScpu {
+	BS_CPU_SSE2            = 0x0001,
+	BS_CPU_AVX2            = 0x0002,
+	BS_CPU_AVX512VBMI      = 0x0004, /* Also implies AVX-512BW */
+	BS_CPU_AVX512VBMI2     = 0x0008, /* Also implies AVX-512BW */
+	BS_CPU_POPCNT          = 0x0010,
+	BS_CPU_AVX512VPOPCNTDQ = 0x0020, /* Also implies AVX-512F */
+	BS_CPU_SSE42           = 0x0040,
+	BS_CPU_PCLMUL          = 0x0080
+} BScpu;
+
+/**
+ * Get processor features
+ * Returns the set of BScpu flags which are supported by the running processor
+ * and which the library is allowed to use.
+ */
+unsigned int bs_cpu_features(void);
+
+/**
+ * Limit processor features
+ * Restricts the library to the BScpu flags given in FEATURES, which is useful
+ * for testing and benchmarking the portable code paths. Pass ~0u to allow
+ * everything again, or 0 to disable all vectorised code.
+ * This is a global setting and should not be changed while other threads are
+ * using the library.
+ */
+void bs_cpu_limit(unsigned int features);
+
 #ifdef __cplusplus
 }
 #endif
+
+#endif /* __BS_H */
@@ -69,4 +69,82 @@ struct BS {
  */
 BSresult bs_malloc(BS *bs, size_t cbSize);
 
+/**
+ * Filter bytes against a bitmap
+ * Copies the CBINPUT bytes at PBINPUT to PBOUTPUT, dropping any whose bit is
+ * set in BITMAP (as for bs_filter_bitmap()). The buffers may be the same.
+ * Returns the count of bytes kept
+ */
+size_t bs_filter_bitmap_bytes(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte bitmap[32]
+);
+
+/**
+ * Count bytes in a bitmap
+ * Returns the count of the CBINPUT bytes at PBINPUT whose bit is set in BITMAP.
+ */
+size_t bs_count_bitmap_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte bitmap[32]
+);
+
+/**
+ * Count bits in bytes
+ * Returns the count of bits set in the CBINPUT bytes at PBINPUT.
+ */
+uint64_t bs_popcount_bytes(const BSbyte *pbInput, size_t cbInput);
+
+/**
+ * Add bytes
+ * Returns the sum of the CBINPUT bytes at PBINPUT.
+ */
+uint64_t bs_sum_bytes(const BSbyte *pbInput, size_t cbInput);
+
+/**
+ * Blocks between widening weighted lanes
+ * The weighted sum kernels here and in checksum.c add each block's weighted
+ * values into 32-bit lanes. A lane gains less than 2^15 per block, so this
+ * many blocks can be added before widening without overflowing.
+ */
+#define CBLOCKS_WEIGHTED 65536
+
+/**
+ * Add bytes with positional weights
+ * Passes back the sum of the CBINPUT bytes at PBINPUT in PSUM, and the sum of
+ * each byte multiplied by its distance from the end in PWEIGHTED, both modulo
+ * 2^64.
+ */
+void bs_sum_weighted_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+);
+
+/**
+ * Count bytes
+ * Adds the number of times that each byte value appears in the CBINPUT bytes
+ * at PBINPUT to COUNTS.
+ */
+void bs_histogram_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t counts[256]
+);
+
+/**
+ * Continue a Fletcher-32 checksum over bytes
+ * Returns the Fletcher-32 checksum FLETCHER updated to take in the CBINPUT
+ * bytes at PBINPUT. An odd byte at the end is padded with a zero.
+ */
+uint32_t bs_fletcher32_bytes(
+	uint32_t fletcher,
+	const BSbyte *pbInput,
+	size_t cbInput
+);
+
 #endif /* __BS_INTERNAL_H */
@@ -0,0 +1,352 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include "cpu.h"
+
+/*
+ * Each checksum is a pair of sums: the first of the bytes (or words), and the
+ * second of the running values of the first. Both are reduced modulo a number
+ * just under a power of two.
+ */
+#define MOD_ADLER32    65521
+#define MOD_FLETCHER16 255
+#define MOD_FLETCHER32 65535
+
+/*
+ * Sums are taken a chunk at a time, and only reduced between chunks. Chunks
+ * are short enough that the weighted sums can't overflow 64 bits.
+ */
+#define CB_CHECKSUM_CHUNK (1 << 22)
+
+/*
+ * Word sum kernels
+ * Fletcher-32 works through little-endian 16-bit words. Each kernel works
+ * through whole vectors only, returning the number of bytes read. The sum of
+ * the words read is added to *PSUM, and the weighted sum (each word multiplied
+ * by its distance from the end) to *PWEIGHTED.
+ * Words are split into low and high bytes so that they can be multiplied by
+ * their weights with signed multiply-adds, and the high half is scaled up
+ * once the lanes are widened.
+ */
+
+#ifdef BS_SIMD_X86
+
+static BS_TARGET("sse2") size_t
+sum_words_sse2(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+)
+{
+	const __m128i vWeights = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i vMask = _mm_set1_epi16(0x00FF);
+	const __m128i vZero = _mm_setzero_si128();
+	__m128i v, vLow, vHigh, vSum = vZero, vRunning = vZero;
+	__m128i vBlocksLow, vBlocksHigh, vTotalLow = vZero, vTotalHigh = vZero;
+	uint64_t rgSum[2], rgRunning[2], rgLow[2], rgHigh[2];
+	size_t ibRead = 0, cBlocks;
+
+	while (cbInput - ibRead >= 16) {
+		vBlocksLow = vZero;
+		vBlocksHigh = vZero;
+		for (cBlocks = 0;
+		     (cBlocks < CBLOCKS_WEIGHTED) && (cbInput - ibRead >= 16);
+		     cBlocks++) {
+			v = _mm_loadu_si128((const __m128i *) (pbInput + ibRead));
+			vLow = _mm_and_si128(v, vMask);
+			vHigh = _mm_srli_epi16(v, 8);
+			vRunning = _mm_add_epi64(vRunning, vSum);
+			vSum = _mm_add_epi64(vSum, _mm_add_epi64(
+				_mm_sad_epu8(vLow, vZero),
+				_mm_slli_epi64(_mm_sad_epu8(vHigh, vZero), 8)
+			));
+			vBlocksLow = _mm_add_epi32(
+				vBlocksLow,
+				_mm_madd_epi16(vLow, vWeights)
+			);
+			vBlocksHigh = _mm_add_epi32(
+				vBlocksHigh,
+				_mm_madd_epi16(vHigh, vWeights)
+			);
+			ibRead += 16;
+		}
+
+		vTotalLow = _mm_add_epi64(vTotalLow, _mm_add_epi64(
+			_mm_unpacklo_epi32(vBlocksLow, vZero),
+			_mm_unpackhi_epi32(vBlocksLow, vZero)
+		));
+		vTotalHigh = _mm_add_epi64(vTotalHigh, _mm_add_epi64(
+			_mm_unpacklo_epi32(vBlocksHigh, vZero),
+			_mm_unpackhi_epi32(vBlocksHigh, vZero)
+		));
+	}
+
+	_mm_storeu_si128((__m128i *) rgSum, vSum);
+	_mm_storeu_si128((__m128i *) rgRunning, vRunning);
+	_mm_storeu_si128((__m128i *) rgLow, vTotalLow);
+	_mm_storeu_si128((__m128i *) rgHigh, vTotalHigh);
+
+	*pSum += rgSum[0] + rgSum[1];
+	*pWeighted += 8 * (rgRunning[0] + rgRunning[1])
+	            + rgLow[0] + rgLow[1]
+	            + ((rgHigh[0] + rgHigh[1]) << 8);
+	return ibRead;
+}
+
+static BS_TARGET("avx2") size_t
+sum_words_avx2(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+)
+{
+	const __m256i vWeights = _mm256_setr_epi16(
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+	);
+	const __m256i vMask = _mm256_set1_epi16(0x00FF);
+	const __m256i vZero = _mm256_setzero_si256();
+	__m256i v, vLow, vHigh, vSum = vZero, vRunning = vZero;
+	__m256i vBlocksLow, vBlocksHigh, vTotalLow = vZero, vTotalHigh = vZero;
+	uint64_t rgSum[4], rgRunning[4], rgLow[4], rgHigh[4];
+	size_t ibRead = 0, cBlocks;
+
+	while (cbInput - ibRead >= 32) {
+		vBlocksLow = vZero;
+		vBlocksHigh = vZero;
+		for (cBlocks = 0;
+		     (cBlocks < CBLOCKS_WEIGHTED) && (cbInput - ibRead >= 32);
+		     cBlocks++) {
+			v = _mm256_loadu_si256((const __m256i *) (pbInput + ibRead));
+			vLow = _mm256_and_si256(v, vMask);
+			vHigh = _mm256_srli_epi16(v, 8);
+			vRunning = _mm256_add_epi64(vRunning, vSum);
+			vSum = _mm256_add_epi64(vSum, _mm256_add_epi64(
+				_mm256_sad_epu8(vLow, vZero),
+				_mm256_slli_epi64(_mm256_sad_epu8(vHigh, vZero), 8)
+			));
+			vBlocksLow = _mm256_add_epi32(
+				vBlocksLow,
+				_mm256_madd_epi16(vLow, vWeights)
+			);
+			vBlocksHigh = _mm256_add_epi32(
+				vBlocksHigh,
+				_mm256_madd_epi16(vHigh, vWeights)
+			);
+			ibRead += 32;
+		}
+
+		vTotalLow = _mm256_add_epi64(vTotalLow, _mm256_add_epi64(
+			_mm256_unpacklo_epi32(vBlocksLow, vZero),
+			_mm256_unpackhi_epi32(vBlocksLow, vZero)
+		));
+		vTotalHigh = _mm256_add_epi64(vTotalHigh, _mm256_add_epi64(
+			_mm256_unpacklo_epi32(vBlocksHigh, vZero),
+			_mm256_unpackhi_epi32(vBlocksHigh, vZero)
+		));
+	}
+
+	_mm256_storeu_si256((__m256i *) rgSum, vSum);
+	_mm256_storeu_si256((__m256i *) rgRunning, vRunning);
+	_mm256_storeu_si256((__m256i *) rgLow, vTotalLow);
+	_mm256_storeu_si256((__m256i *) rgHigh, vTotalHigh);
+
+	*pSum += rgSum[0] + rgSum[1] + rgSum[2] + rgSum[3];
+	*pWeighted += 16 * (rgRunning[0] + rgRunning[1] + rgRunning[2]
+	                    + rgRunning[3])
+	            + rgLow[0] + rgLow[1] + rgLow[2] + rgLow[3]
+	            + ((rgHigh[0] + rgHigh[1] + rgHigh[2] + rgHigh[3]) << 8);
+	return ibRead;
+}
+
+#endif /* BS_SIMD_X86 */
+
+/*
+ * As bs_sum_weighted_bytes, but for little-endian words. An odd byte at the
+ * end is taken as a word of its own, as though padded with a zero.
+ */
+static void
+sum_weighted_words(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+)
+{
+	size_t ibRead = 0;
+	uint64_t cSum = 0, cWeighted = 0;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+
+	if (grfFeatures & BS_CPU_AVX2) {
+		ibRead = sum_words_avx2(pbInput, cbInput, &cSum, &cWeighted);
+	} else if (grfFeatures & BS_CPU_SSE2) {
+		ibRead = sum_words_sse2(pbInput, cbInput, &cSum, &cWeighted);
+	}
+#endif
+
+	while (cbInput - ibRead >= 2) {
+		cSum += pbInput[ibRead] | (pbInput[ibRead + 1] << 8);
+		cWeighted += cSum;
+		ibRead += 2;
+	}
+	if (ibRead < cbInput) {
+		cSum += pbInput[ibRead];
+		cWeighted += cSum;
+	}
+
+	*pSum = cSum;
+	*pWeighted = cWeighted;
+}
+
+/*
+ * Takes CBINPUT bytes at PBINPUT into the pair of sums at PSUM1 and PSUM2,
+ * reducing modulo MODULUS. Each chunk's weighted sum already counts the
+ * running sums within the chunk, and the second sum also picks up the first
+ * sum from before the chunk once for each value in it.
+ */
+static void
+checksum_bytes(
+	uint32_t *pSum1,
+	uint32_t *pSum2,
+	uint32_t modulus,
+	int fWords,
+	const BSbyte *pbInput,
+	size_t cbInput
+)
+{
+	uint64_t sum1 = *pSum1, sum2 = *pSum2, cSum, cWeighted, cValues;
+	size_t cbChunk;
+
+	while (cbInput > 0) {
+		cbChunk = cbInput < CB_CHECKSUM_CHUNK ? cbInput : CB_CHECKSUM_CHUNK;
+
+		if (fWords) {
+			sum_weighted_words(pbInput, cbChunk, &cSum, &cWeighted);
+			cValues = (cbChunk + 1) / 2;
+		} else {
+			bs_sum_weighted_bytes(pbInput, cbChunk, &cSum, &cWeighted);
+			cValues = cbChunk;
+		}
+
+		sum2 = (sum2 + cValues % modulus * sum1 + cWeighted % modulus)
+		     % modulus;
+		sum1 = (sum1 + cSum) % modulus;
+
+		pbInput += cbChunk;
+		cbInput -= cbChunk;
+	}
+
+	*pSum1 = (uint32_t) sum1;
+	*pSum2 = (uint32_t) sum2;
+}
+
+BSresult
+bs_adler32(const BS *bs, uint32_t *adler)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(adler)
+
+	*adler = 1;
+	return bs_adler32_update(bs, adler);
+}
+
+BSresult
+bs_adler32_update(const BS *bs, uint32_t *adler)
+{
+	uint32_t sum1, sum2;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(adler)
+	BS_ASSERT_VALID(bs)
+
+	sum1 = *adler & 0xFFFF;
+	sum2 = *adler >> 16;
+	checksum_bytes(&sum1, &sum2, MOD_ADLER32, 0, bs->pbBytes, bs->cbBytes);
+
+	*adler = (sum2 << 16) | sum1;
+	return BS_OK;
+}
+
+BSresult
+bs_fletcher16(const BS *bs, uint16_t *fletcher)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(fletcher)
+
+	*fletcher = 0;
+	return bs_fletcher16_update(bs, fletcher);
+}
+
+BSresult
+bs_fletcher16_update(const BS *bs, uint16_t *fletcher)
+{
+	uint32_t sum1, sum2;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(fletcher)
+	BS_ASSERT_VALID(bs)
+
+	sum1 = *fletcher & 0xFF;
+	sum2 = *fletcher >> 8;
+	checksum_bytes(&sum1, &sum2, MOD_FLETCHER16, 0, bs->pbBytes, bs->cbBytes);
+
+	*fletcher = (uint16_t) ((sum2 << 8) | sum1);
+	return BS_OK;
+}
+
+BSresult
+bs_fletcher32(const BS *bs, uint32_t *fletcher)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(fletcher)
+
+	*fletcher = 0;
+	return bs_fletcher32_update(bs, fletcher);
+}
+
+uint32_t
+bs_fletcher32_bytes(uint32_t fletcher, const BSbyte *pbInput, size_t cbInput)
+{
+	uint32_t sum1 = fletcher & 0xFFFF, sum2 = fletcher >> 16;
+
+	checksum_bytes(&sum1, &sum2, MOD_FLETCHER32, 1, pbInput, cbInput);
+	return (sum2 << 16) | sum1;
+}
+
+BSresult
+bs_fletcher32_update(const BS *bs, uint32_t *fletcher)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(fletcher)
+	BS_ASSERT_VALID(bs)
+
+	*fletcher = bs_fletcher32_bytes(*fletcher, bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
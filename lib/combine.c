@@ -26,6 +26,7 @@
 
 #include "libbs.h"
 #include "bs_internal.h"
+#include "pool.h"
 
 BSresult
 bs_combine(
@@ -34,34 +35,127 @@ bs_combine(
 	BSbyte (*operation) (BSbyte byte1, BSbyte byte2)
 )
 {
-	size_t ibByteStream = 0, ibOperand = 0;
-
-	BS_CHECK_POINTER(bs)
-	BS_CHECK_POINTER(operand)
-	BS_CHECK_POINTER(operation)
-	BS_ASSERT_VALID(bs)
-	BS_ASSERT_VALID(operand)
+	return bs_combine_to(bs, bs, operand, operation);
+}
 
-	if (bs_size(operand) == 0) {
-		return BS_INVALID;
-	}
+/*
+ * Combines CBINPUT bytes, starting IBOPERAND bytes into the operand.
+ */
+static void
+combine_bytes(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BS *operand,
+	size_t ibOperand,
+	BSbyte (*operation) (BSbyte byte1, BSbyte byte2)
+)
+{
+	size_t ibInput = 0;
 
-	while (ibByteStream < bs->cbBytes) {
-		bs->pbBytes[ibByteStream] = operation(
-			bs->pbBytes[ibByteStream],
+	while (ibInput < cbInput) {
+		pbOutput[ibInput] = operation(
+			pbInput[ibInput],
 			operand->pbBytes[ibOperand]
 		);
 
-		ibByteStream++;
+		ibInput++;
 		ibOperand++;
 		if (ibOperand == operand->cbBytes) {
 			ibOperand = 0;
 		}
 	}
+}
+
+BSresult
+bs_combine_to(
+	BS *dst,
+	const BS *src,
+	const BS *operand,
+	BSbyte (*operation) (BSbyte byte1, BSbyte byte2)
+)
+{
+	BSresult result;
+
+	BS_CHECK_POINTER(dst)
+	BS_CHECK_POINTER(src)
+	BS_CHECK_POINTER(operand)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(dst)
+	BS_ASSERT_VALID(src)
+	BS_ASSERT_VALID(operand)
+
+	if (bs_size(operand) == 0) {
+		return BS_INVALID;
+	}
+
+	result = bs_malloc(dst, src->cbBytes);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	combine_bytes(dst->pbBytes, src->pbBytes, src->cbBytes, operand, 0, operation);
+
+	return BS_OK;
+}
+
+struct BScombinejob {
+	BSbyte *pbBytes;  /* Start of the whole stream */
+	const BS *operand;
+	BSbyte (*fpOperation) (BSbyte byte1, BSbyte byte2);
+};
+
+static BSresult
+combine_range(size_t offset, size_t length, void *data)
+{
+	struct BScombinejob *job = data;
+
+	/* Each range picks up the operand wherever the previous one left it */
+	combine_bytes(
+		job->pbBytes + offset,
+		job->pbBytes + offset,
+		length,
+		job->operand,
+		offset % job->operand->cbBytes,
+		job->fpOperation
+	);
 
 	return BS_OK;
 }
 
+BSresult
+bs_combine_parallel(
+	BS *bs,
+	const BS *operand,
+	BSbyte (*operation) (BSbyte byte1, BSbyte byte2),
+	BSpool *pool
+)
+{
+	struct BScombinejob job;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(operand)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(bs)
+	BS_ASSERT_VALID(operand)
+
+	if (bs_size(operand) == 0) {
+		return BS_INVALID;
+	}
+
+	job.pbBytes = bs->pbBytes;
+	job.operand = operand;
+	job.fpOperation = operation;
+
+	return bs_pool_run(
+		pool,
+		bs->cbBytes,
+		BS_PARALLEL_RANGE,
+		combine_range,
+		&job
+	);
+}
+
 static BSbyte
 xor_byte(BSbyte byte1, BSbyte byte2)
 {
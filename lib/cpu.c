@@ -0,0 +1,82 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include "libbs.h"
+#include "cpu.h"
+
+static unsigned int grfCpuLimit = ~0u;
+
+static unsigned int
+detect_features(void)
+{
+	unsigned int grfFeatures = 0;
+
+#ifdef BS_SIMD_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2")) {
+		grfFeatures |= BS_CPU_SSE2;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		grfFeatures |= BS_CPU_AVX2;
+	}
+	if (__builtin_cpu_supports("avx512bw")
+	 && __builtin_cpu_supports("avx512vbmi")) {
+		grfFeatures |= BS_CPU_AVX512VBMI;
+	}
+	if (__builtin_cpu_supports("avx512bw")
+	 && __builtin_cpu_supports("avx512vbmi2")) {
+		grfFeatures |= BS_CPU_AVX512VBMI2;
+	}
+	if (__builtin_cpu_supports("popcnt")) {
+		grfFeatures |= BS_CPU_POPCNT;
+	}
+	if (__builtin_cpu_supports("avx512vpopcntdq")) {
+		grfFeatures |= BS_CPU_AVX512VPOPCNTDQ;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		grfFeatures |= BS_CPU_SSE42;
+	}
+	if (__builtin_cpu_supports("pclmul")) {
+		grfFeatures |= BS_CPU_PCLMUL;
+	}
+#endif
+
+	return grfFeatures;
+}
+
+unsigned int
+bs_cpu_features(void)
+{
+	return detect_features() & grfCpuLimit;
+}
+
+void
+bs_cpu_limit(unsigned int features)
+{
+	grfCpuLimit = features;
+}
@@ -0,0 +1,46 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef __CPU_H
+#define __CPU_H
+
+#include "libbs.h"
+
+/**
+ * SIMD kernels
+ * Vectorised kernels are built with GCC-style target attributes and selected at
+ * run time using bs_cpu_features(), so the library as a whole still runs on any
+ * x86 processor. Define BS_NO_SIMD to build without them.
+ */
+#if !defined(BS_NO_SIMD) && defined(__GNUC__) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define BS_SIMD_X86 1
+#include <immintrin.h>
+#define BS_TARGET(features) __attribute__((target(features)))
+#endif
+
+#endif /* __CPU_H */
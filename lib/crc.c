@@ -0,0 +1,424 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include "cpu.h"
+#include <pthread.h>
+#include <string.h>
+
+/*
+ * Both CRCs are bit-reflected, so the polynomials are written backwards and
+ * the register shifts right.
+ */
+#define POLY_CRC32  0xEDB88320
+#define POLY_CRC32C 0x82F63B78
+
+/* Lengths of the lanes which are checksummed side by side */
+#define CB_CRC_LONG  8192
+#define CB_CRC_SHORT 256
+
+/*
+ * Lookup tables are calculated the first time that they're needed.
+ * The slicing tables give the effect of each byte on the register when it's
+ * followed by up to seven more, so eight bytes can be taken at once. The shift
+ * tables give the effect of a lane of zeros, for joining up lanes.
+ */
+static pthread_once_t onceTables = PTHREAD_ONCE_INIT;
+static uint32_t rgrgSliceCrc32[8][256];
+static uint32_t rgrgSliceCrc32c[8][256];
+static uint32_t rgrgShiftLong[4][256];
+static uint32_t rgrgShiftShort[4][256];
+
+static void
+slice_tables(uint32_t rgrgTable[8][256], uint32_t poly)
+{
+	uint32_t crc;
+	unsigned int iByte, iBit, iSlice;
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		crc = iByte;
+		for (iBit = 0; iBit < 8; iBit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+		}
+		rgrgTable[0][iByte] = crc;
+	}
+
+	for (iSlice = 1; iSlice < 8; iSlice++) {
+		for (iByte = 0; iByte < 256; iByte++) {
+			crc = rgrgTable[iSlice - 1][iByte];
+			rgrgTable[iSlice][iByte] = (crc >> 8) ^ rgrgTable[0][crc & 0xFF];
+		}
+	}
+}
+
+/*
+ * Running a register over zeros is linear, so can be done with a 32x32 matrix
+ * over GF(2). Each matrix is stored as its columns: the effect on each bit.
+ */
+
+static uint32_t
+matrix_times(const uint32_t rgMatrix[32], uint32_t vector)
+{
+	uint32_t sum = 0;
+
+	while (vector != 0) {
+		if (vector & 1) {
+			sum ^= *rgMatrix;
+		}
+		vector >>= 1;
+		rgMatrix++;
+	}
+	return sum;
+}
+
+static void
+matrix_square(uint32_t rgSquare[32], const uint32_t rgMatrix[32])
+{
+	unsigned int iColumn;
+
+	for (iColumn = 0; iColumn < 32; iColumn++) {
+		rgSquare[iColumn] = matrix_times(rgMatrix, rgMatrix[iColumn]);
+	}
+}
+
+/* Builds tables to run a CRC-32C register over CBZEROS zeros, a power of 2 */
+static void
+shift_tables(uint32_t rgrgTable[4][256], size_t cbZeros)
+{
+	uint32_t rgOperator[32], rgSquare[32];
+	size_t cBits;
+	unsigned int iColumn, iByte;
+
+	/* Start from the effect of a single zero bit */
+	rgOperator[0] = POLY_CRC32C;
+	for (iColumn = 1; iColumn < 32; iColumn++) {
+		rgOperator[iColumn] = (uint32_t) 1 << (iColumn - 1);
+	}
+
+	for (cBits = 1; cBits < cbZeros * 8; cBits *= 2) {
+		matrix_square(rgSquare, rgOperator);
+		memcpy(rgOperator, rgSquare, sizeof(rgOperator));
+	}
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		rgrgTable[0][iByte] = matrix_times(rgOperator, iByte);
+		rgrgTable[1][iByte] = matrix_times(rgOperator, (uint32_t) iByte << 8);
+		rgrgTable[2][iByte] = matrix_times(rgOperator, (uint32_t) iByte << 16);
+		rgrgTable[3][iByte] = matrix_times(rgOperator, (uint32_t) iByte << 24);
+	}
+}
+
+static void
+init_tables(void)
+{
+	slice_tables(rgrgSliceCrc32, POLY_CRC32);
+	slice_tables(rgrgSliceCrc32c, POLY_CRC32C);
+	shift_tables(rgrgShiftLong, CB_CRC_LONG);
+	shift_tables(rgrgShiftShort, CB_CRC_SHORT);
+}
+
+static uint32_t
+crc_slice8(
+	uint32_t rgrgTable[8][256],
+	uint32_t crc,
+	const BSbyte *pbInput,
+	size_t cbInput
+)
+{
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 8) {
+		crc ^= (uint32_t) pbInput[ibRead]
+		     | (uint32_t) pbInput[ibRead + 1] << 8
+		     | (uint32_t) pbInput[ibRead + 2] << 16
+		     | (uint32_t) pbInput[ibRead + 3] << 24;
+		crc = rgrgTable[7][crc & 0xFF]
+		    ^ rgrgTable[6][(crc >> 8) & 0xFF]
+		    ^ rgrgTable[5][(crc >> 16) & 0xFF]
+		    ^ rgrgTable[4][crc >> 24]
+		    ^ rgrgTable[3][pbInput[ibRead + 4]]
+		    ^ rgrgTable[2][pbInput[ibRead + 5]]
+		    ^ rgrgTable[1][pbInput[ibRead + 6]]
+		    ^ rgrgTable[0][pbInput[ibRead + 7]];
+		ibRead += 8;
+	}
+	while (ibRead < cbInput) {
+		crc = (crc >> 8) ^ rgrgTable[0][(crc ^ pbInput[ibRead]) & 0xFF];
+		ibRead++;
+	}
+
+	return crc;
+}
+
+/*
+ * CRC kernels
+ * Each works through as much of the input as suits it, returning the number of
+ * bytes read and updating the register at *PCRC (which is held inverted, as
+ * during the calculation).
+ */
+
+#ifdef BS_SIMD_X86
+
+/* The crc32 instruction only takes 64-bit words in 64-bit mode */
+#ifdef __x86_64__
+
+static uint32_t
+shift_crc(uint32_t rgrgTable[4][256], uint32_t crc)
+{
+	return rgrgTable[0][crc & 0xFF]
+	     ^ rgrgTable[1][(crc >> 8) & 0xFF]
+	     ^ rgrgTable[2][(crc >> 16) & 0xFF]
+	     ^ rgrgTable[3][crc >> 24];
+}
+
+/*
+ * The crc32 instruction has a latency of three cycles but can start one every
+ * cycle, so three lanes are checksummed at once and then joined by shifting
+ * the earlier registers over the length of the lanes after them.
+ */
+static BS_TARGET("sse4.2") size_t
+crc32c_sse42(const BSbyte *pbInput, size_t cbInput, uint32_t *pCrc)
+{
+	uint32_t (*rgrgShift)[256];
+	const BSbyte *pbLane;
+	uint64_t crc0 = *pCrc, crc1, crc2, rgWords[3];
+	size_t ibRead = 0, cbLane, ibLane;
+
+	for (cbLane = CB_CRC_LONG; cbLane >= CB_CRC_SHORT; cbLane /= 32) {
+		rgrgShift = cbLane == CB_CRC_LONG ? rgrgShiftLong : rgrgShiftShort;
+		while (cbInput - ibRead >= 3 * cbLane) {
+			crc1 = 0;
+			crc2 = 0;
+			for (ibLane = 0; ibLane < cbLane; ibLane += 8) {
+				pbLane = pbInput + ibRead + ibLane;
+				memcpy(&rgWords[0], pbLane, 8);
+				memcpy(&rgWords[1], pbLane + cbLane, 8);
+				memcpy(&rgWords[2], pbLane + 2 * cbLane, 8);
+				crc0 = _mm_crc32_u64(crc0, rgWords[0]);
+				crc1 = _mm_crc32_u64(crc1, rgWords[1]);
+				crc2 = _mm_crc32_u64(crc2, rgWords[2]);
+			}
+			crc0 = shift_crc(rgrgShift, (uint32_t) crc0) ^ crc1;
+			crc0 = shift_crc(rgrgShift, (uint32_t) crc0) ^ crc2;
+			ibRead += 3 * cbLane;
+		}
+	}
+
+	while (cbInput - ibRead >= 8) {
+		memcpy(&rgWords[0], pbInput + ibRead, 8);
+		crc0 = _mm_crc32_u64(crc0, rgWords[0]);
+		ibRead += 8;
+	}
+
+	*pCrc = (uint32_t) crc0;
+	return ibRead;
+}
+
+#endif /* __x86_64__ */
+
+/*
+ * Folding constants for CRC-32, each a power of x modulo the polynomial
+ * (bit-reflected and split into 32-bit pieces). See Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ */
+#define K1K2 _mm_set_epi32(1, (int) 0xC6E41596, 1, 0x54442BD4)
+#define K3K4 _mm_set_epi32(0, (int) 0xCCAA009E, 1, 0x751997D0)
+#define K5K0 _mm_set_epi32(0, 0, 1, 0x63CD6124)
+#define POLY _mm_set_epi32(1, (int) 0xF7011641, 1, (int) 0xDB710641)
+
+#define FOLD_PCLMUL(vAccumulator, vConstants, vNext) \
+	_mm_xor_si128( \
+		_mm_xor_si128( \
+			_mm_clmulepi64_si128(vAccumulator, vConstants, 0x00), \
+			_mm_clmulepi64_si128(vAccumulator, vConstants, 0x11) \
+		), \
+		vNext \
+	)
+
+/*
+ * Carry-less multiplication folds four 128-bit accumulators forward over the
+ * input 64 bytes at a time, then folds them down into one and finishes with a
+ * Barrett reduction.
+ */
+static BS_TARGET("pclmul,sse2") size_t
+crc32_pclmul(const BSbyte *pbInput, size_t cbInput, uint32_t *pCrc)
+{
+	const __m128i vLow32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i vFold0, vFold1, vFold2, vFold3, vConstants, vTemp;
+	size_t ibRead = 64;
+
+	if (cbInput < 64) {
+		return 0;
+	}
+
+	vFold0 = _mm_loadu_si128((const __m128i *) pbInput);
+	vFold1 = _mm_loadu_si128((const __m128i *) (pbInput + 16));
+	vFold2 = _mm_loadu_si128((const __m128i *) (pbInput + 32));
+	vFold3 = _mm_loadu_si128((const __m128i *) (pbInput + 48));
+	vFold0 = _mm_xor_si128(vFold0, _mm_cvtsi32_si128((int) *pCrc));
+
+	vConstants = K1K2;
+	while (cbInput - ibRead >= 64) {
+		vFold0 = FOLD_PCLMUL(vFold0, vConstants,
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead)));
+		vFold1 = FOLD_PCLMUL(vFold1, vConstants,
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead + 16)));
+		vFold2 = FOLD_PCLMUL(vFold2, vConstants,
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead + 32)));
+		vFold3 = FOLD_PCLMUL(vFold3, vConstants,
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead + 48)));
+		ibRead += 64;
+	}
+
+	/* Fold the four accumulators into one, then take in any single blocks */
+	vConstants = K3K4;
+	vFold0 = FOLD_PCLMUL(vFold0, vConstants, vFold1);
+	vFold0 = FOLD_PCLMUL(vFold0, vConstants, vFold2);
+	vFold0 = FOLD_PCLMUL(vFold0, vConstants, vFold3);
+	while (cbInput - ibRead >= 16) {
+		vFold0 = FOLD_PCLMUL(vFold0, vConstants,
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead)));
+		ibRead += 16;
+	}
+
+	/* Fold 128 bits down to 64 */
+	vTemp = _mm_clmulepi64_si128(vFold0, vConstants, 0x10);
+	vFold0 = _mm_xor_si128(_mm_srli_si128(vFold0, 8), vTemp);
+
+	vConstants = K5K0;
+	vTemp = _mm_srli_si128(vFold0, 4);
+	vFold0 = _mm_and_si128(vFold0, vLow32);
+	vFold0 = _mm_clmulepi64_si128(vFold0, vConstants, 0x00);
+	vFold0 = _mm_xor_si128(vFold0, vTemp);
+
+	/* Barrett reduction to 32 bits */
+	vConstants = POLY;
+	vTemp = _mm_and_si128(vFold0, vLow32);
+	vTemp = _mm_clmulepi64_si128(vTemp, vConstants, 0x10);
+	vTemp = _mm_and_si128(vTemp, vLow32);
+	vTemp = _mm_clmulepi64_si128(vTemp, vConstants, 0x00);
+	vFold0 = _mm_xor_si128(vFold0, vTemp);
+
+	*pCrc = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(vFold0, 4));
+	return ibRead;
+}
+
+#undef FOLD_PCLMUL
+#undef POLY
+#undef K5K0
+#undef K3K4
+#undef K1K2
+
+#endif /* BS_SIMD_X86 */
+
+static uint32_t
+crc32_bytes(uint32_t crc, const BSbyte *pbInput, size_t cbInput)
+{
+	size_t ibRead = 0;
+
+	pthread_once(&onceTables, init_tables);
+	crc = ~crc;
+
+#ifdef BS_SIMD_X86
+	if (bs_cpu_features() & BS_CPU_PCLMUL) {
+		ibRead = crc32_pclmul(pbInput, cbInput, &crc);
+	}
+#endif
+
+	crc = crc_slice8(
+		rgrgSliceCrc32,
+		crc,
+		pbInput + ibRead,
+		cbInput - ibRead
+	);
+	return ~crc;
+}
+
+static uint32_t
+crc32c_bytes(uint32_t crc, const BSbyte *pbInput, size_t cbInput)
+{
+	size_t ibRead = 0;
+
+	pthread_once(&onceTables, init_tables);
+	crc = ~crc;
+
+#if defined(BS_SIMD_X86) && defined(__x86_64__)
+	if (bs_cpu_features() & BS_CPU_SSE42) {
+		ibRead = crc32c_sse42(pbInput, cbInput, &crc);
+	}
+#endif
+
+	crc = crc_slice8(
+		rgrgSliceCrc32c,
+		crc,
+		pbInput + ibRead,
+		cbInput - ibRead
+	);
+	return ~crc;
+}
+
+BSresult
+bs_crc32(const BS *bs, uint32_t *crc)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(crc)
+
+	*crc = 0;
+	return bs_crc32_update(bs, crc);
+}
+
+BSresult
+bs_crc32_update(const BS *bs, uint32_t *crc)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(crc)
+	BS_ASSERT_VALID(bs)
+
+	*crc = crc32_bytes(*crc, bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
+
+BSresult
+bs_crc32c(const BS *bs, uint32_t *crc)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(crc)
+
+	*crc = 0;
+	return bs_crc32c_update(bs, crc);
+}
+
+BSresult
+bs_crc32c_update(const BS *bs, uint32_t *crc)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(crc)
+	BS_ASSERT_VALID(bs)
+
+	*crc = crc32c_bytes(*crc, bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
@@ -27,72 +27,519 @@
 #include "libbs.h"
 #include "bs_internal.h"
 #include "encodings.h"
+#include <stdlib.h>
 #include <string.h>
 
+/* Characters skipped by the line-wrapped base64 decoders: HT, LF, CR, space */
+static const BSbyte rgbWhitespace[32] = {
+	0x00, 0x26, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* Characters skipped by the Crockford base32 decoder: '-' */
+static const BSbyte rgbHyphen[32] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
 static const struct BSencoding rgEncodings[] = {
-	{ "hex",       bs_decode_hex,       bs_encode_size_hex,    bs_encode_hex       },
-	{ "base64",    bs_decode_base64,    bs_encode_size_base64, bs_encode_base64    },
-	{ "base64url", bs_decode_base64url, bs_encode_size_base64, bs_encode_base64url },
-	{ NULL,        NULL,                NULL,                  NULL                }
+	{
+		"hex",
+		bs_decode_size_hex,
+		bs_decode_hex,
+		bs_encode_size_hex,
+		bs_encode_hex,
+		bs_validate_hex,
+		1,
+		2,
+		1,
+		NULL
+	},
+	{
+		"base64",
+		bs_decode_size_base64,
+		bs_decode_base64,
+		bs_encode_size_base64,
+		bs_encode_base64,
+		bs_validate_base64,
+		1,
+		4,
+		3,
+		NULL
+	},
+	{
+		"base64url",
+		bs_decode_size_base64,
+		bs_decode_base64url,
+		bs_encode_size_base64,
+		bs_encode_base64url,
+		bs_validate_base64url,
+		1,
+		4,
+		3,
+		NULL
+	},
+	{
+		"base64mime",
+		bs_decode_size_base64_wrapped,
+		bs_decode_base64_wrapped,
+		bs_encode_size_base64mime,
+		bs_encode_base64mime,
+		bs_validate_base64_wrapped,
+		1,
+		4,
+		3,
+		rgbWhitespace
+	},
+	{
+		"base64pem",
+		bs_decode_size_base64_wrapped,
+		bs_decode_base64_wrapped,
+		bs_encode_size_base64pem,
+		bs_encode_base64pem,
+		bs_validate_base64_wrapped,
+		1,
+		4,
+		3,
+		rgbWhitespace
+	},
+	{
+		"base32",
+		bs_decode_size_base32,
+		bs_decode_base32,
+		bs_encode_size_base32,
+		bs_encode_base32,
+		bs_validate_base32,
+		1,
+		8,
+		5,
+		NULL
+	},
+	{
+		"base32hex",
+		bs_decode_size_base32,
+		bs_decode_base32hex,
+		bs_encode_size_base32,
+		bs_encode_base32hex,
+		bs_validate_base32hex,
+		1,
+		8,
+		5,
+		NULL
+	},
+	{
+		"base32crockford",
+		bs_decode_size_base32crockford,
+		bs_decode_base32crockford,
+		bs_encode_size_base32crockford,
+		bs_encode_base32crockford,
+		bs_validate_base32crockford,
+		1,
+		8,
+		5,
+		rgbHyphen
+	},
+	{
+		"ascii85",
+		bs_decode_size_ascii85,
+		bs_decode_ascii85,
+		bs_encode_size_ascii85,
+		bs_encode_ascii85,
+		bs_validate_ascii85,
+		0,  /* 'z' expands to four bytes */
+		0,  /* Groups may be abbreviated */
+		4,
+		NULL
+	},
+	{
+		"z85",
+		bs_decode_size_z85,
+		bs_decode_z85,
+		bs_encode_size_z85,
+		bs_encode_z85,
+		bs_validate_z85,
+		1,
+		5,
+		4,
+		NULL
+	},
+	{ NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, 0, NULL }
 };
 
+static const struct BSencoding *
+find_encoding(const char *encoding)
+{
+	size_t iEncoding = 0;
+
+	while (rgEncodings[iEncoding].szName != NULL) {
+		if (strcmp(encoding, rgEncodings[iEncoding].szName) == 0) {
+			return &rgEncodings[iEncoding];
+		}
+		iEncoding++;
+	}
+
+	return NULL;
+}
+
 BSresult
 bs_decode(BS *bs, const char *encoding, const char *input, size_t length)
 {
-	size_t iEncoding = 0;
+	const struct BSencoding *pEncoding;
+	size_t cbWritten;
+	BSresult result;
 
 	BS_CHECK_POINTER(bs)
 	BS_CHECK_POINTER(encoding)
 	BS_CHECK_POINTER(input)
 
-	while (rgEncodings[iEncoding].szName != NULL) {
-		if (strcmp(encoding, rgEncodings[iEncoding].szName) == 0) {
-			return rgEncodings[iEncoding].fpDecode(bs, input, length);
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
+	}
+
+	result = bs_malloc(bs, pEncoding->fpDecodeSize(input, length));
+	if (result != BS_OK) {
+		return result;
+	}
+
+	result = pEncoding->fpDecode(input, length, bs->pbBytes, &cbWritten);
+	if (result != BS_OK) {
+		bs_malloc(bs, 0);
+		return result;
+	}
+
+	/* Trim the stream down to the bytes actually decoded */
+	return bs_malloc(bs, cbWritten);
+}
+
+/**
+ * Characters filtered and decoded at a time by bs_decode_skip()
+ * Small enough to stay in L1 between the filter and the decoder.
+ */
+#define BS_DECODE_CHUNK 4096
+
+/**
+ * Filter more input into a chunk
+ * Appends filtered input to the CCHCHUNK characters already in RGCHCHUNK until
+ * either the chunk is full or the input runs out.
+ * Returns the new count of characters in the chunk
+ */
+static size_t
+fill_chunk(
+	char *rgchChunk,
+	size_t cchChunk,
+	const char *input,
+	size_t length,
+	size_t *pibInput,
+	const BSbyte *rgbSkip
+)
+{
+	size_t cchRead;
+
+	while ((cchChunk < BS_DECODE_CHUNK) && (*pibInput < length)) {
+		/* Filtering never grows the input, so read at most the free space */
+		cchRead = BS_DECODE_CHUNK - cchChunk;
+		if (cchRead > length - *pibInput) {
+			cchRead = length - *pibInput;
 		}
-		iEncoding++;
+
+		cchChunk += bs_filter_bitmap_bytes(
+			(BSbyte *) rgchChunk + cchChunk,
+			(const BSbyte *) input + *pibInput,
+			cchRead,
+			rgbSkip
+		);
+		*pibInput += cchRead;
+	}
+
+	return cchChunk;
+}
+
+BSresult
+bs_decode_skip(
+	BS *bs,
+	const char *encoding,
+	const char *input,
+	size_t length,
+	const BSbyte skip[32]
+)
+{
+	const struct BSencoding *pEncoding;
+	char rgchChunk[BS_DECODE_CHUNK];
+	BSbyte rgbSkip[32];
+	char *pchFiltered;
+	size_t ibInput = 0, cchChunk = 0, cchDecode, cbWritten, cbTotal = 0;
+	size_t iSkip;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(encoding)
+	BS_CHECK_POINTER(input)
+	BS_CHECK_POINTER(skip)
+
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
+	}
+
+	memcpy(rgbSkip, skip, sizeof(rgbSkip));
+	if (pEncoding->rgbSkipped != NULL) {
+		/* The decoder would skip these anyway, so save it the trouble */
+		for (iSkip = 0; iSkip < sizeof(rgbSkip); iSkip++) {
+			rgbSkip[iSkip] |= pEncoding->rgbSkipped[iSkip];
+		}
+	}
+
+	if (pEncoding->cchBlock == 0) {
+		/* Block boundaries can't be found without decoding, so filter first */
+		pchFiltered = malloc(length > 0 ? length : 1);
+		if (pchFiltered == NULL) {
+			return BS_MEMORY;
+		}
+
+		cchChunk = bs_filter_bitmap_bytes(
+			(BSbyte *) pchFiltered,
+			(const BSbyte *) input,
+			length,
+			rgbSkip
+		);
+		result = bs_decode(bs, encoding, pchFiltered, cchChunk);
+
+		free(pchFiltered);
+		return result;
+	}
+
+	/* Separators only shrink the output, so size it for the whole input */
+	result = bs_malloc(
+		bs,
+		(length / pEncoding->cchBlock + 1) * pEncoding->cbBlock
+	);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	for (;;) {
+		cchChunk = fill_chunk(
+			rgchChunk,
+			cchChunk,
+			input,
+			length,
+			&ibInput,
+			rgbSkip
+		);
+
+		if (ibInput == length) {
+			break;
+		}
+
+		/*
+		 * More input follows, so hold back at least one character: the blocks
+		 * decoded here then can't be the last, and mustn't be padded.
+		 */
+		cchDecode = (cchChunk - 1) / pEncoding->cchBlock * pEncoding->cchBlock;
+
+		result = pEncoding->fpDecode(
+			rgchChunk,
+			cchDecode,
+			bs->pbBytes + cbTotal,
+			&cbWritten
+		);
+		if ((result == BS_OK)
+		    && (cbWritten != cchDecode / pEncoding->cchBlock
+		                     * pEncoding->cbBlock)) {
+			result = BS_INVALID;
+		}
+		if (result != BS_OK) {
+			bs_malloc(bs, 0);
+			return result;
+		}
+
+		cbTotal += cbWritten;
+		cchChunk -= cchDecode;
+		memmove(rgchChunk, rgchChunk + cchDecode, cchChunk);
+	}
+
+	result = pEncoding->fpDecode(
+		rgchChunk,
+		cchChunk,
+		bs->pbBytes + cbTotal,
+		&cbWritten
+	);
+	if (result != BS_OK) {
+		bs_malloc(bs, 0);
+		return result;
 	}
 
-	return BS_BAD_ENCODING;
+	/* Trim the stream down to the bytes actually decoded */
+	return bs_malloc(bs, cbTotal + cbWritten);
+}
+
+BSresult
+bs_decode_into(
+	const char *encoding,
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t capacity,
+	size_t *written
+)
+{
+	const struct BSencoding *pEncoding;
+	size_t cbSize;
+	BSresult result;
+
+	BS_CHECK_POINTER(encoding)
+	BS_CHECK_POINTER(input)
+	BS_CHECK_POINTER(written)
+
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
+	}
+
+	cbSize = pEncoding->fpDecodeSize(input, length);
+	if (cbSize > capacity) {
+		/* The estimate may be generous, so find the exact size */
+		result = pEncoding->fpValidate(input, length, &cbSize);
+		if (result != BS_OK) {
+			return result;
+		}
+
+		if (cbSize > capacity) {
+			return BS_SHORT_BUFFER;
+		}
+	}
+
+	if ((cbSize > 0) && (output == NULL)) {
+		return BS_NULL;
+	}
+
+	return pEncoding->fpDecode(input, length, output, written);
+}
+
+BSresult
+bs_decode_in_place(BS *bs, const char *encoding)
+{
+	const struct BSencoding *pEncoding;
+	struct BS bsSwap;
+	BS *bsOutput;
+	size_t cbWritten;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+	BS_CHECK_POINTER(encoding)
+
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
+	}
+
+	if (bs->cbBytes == 0) { /* Nothing to decode */
+		return BS_OK;
+	}
+
+	if (!pEncoding->fInPlace) {
+		/* Output may overtake input, so decode elsewhere and swap buffers */
+		bsOutput = bs_create();
+		if (bsOutput == NULL) {
+			return BS_MEMORY;
+		}
+
+		result = bs_decode(
+			bsOutput,
+			encoding,
+			(const char *) bs->pbBytes,
+			bs->cbBytes
+		);
+
+		if (result == BS_OK) {
+			bsSwap = *bs;
+			*bs = *bsOutput;
+			*bsOutput = bsSwap;
+		}
+
+		bs_free(bsOutput);
+		return result;
+	}
+
+	result = pEncoding->fpDecode(
+		(const char *) bs->pbBytes,
+		bs->cbBytes,
+		bs->pbBytes,
+		&cbWritten
+	);
+
+	if (result != BS_OK) {
+		bs_malloc(bs, 0);
+		return result;
+	}
+
+	return bs_malloc(bs, cbWritten);
+}
+
+BSresult
+bs_decode_validate(
+	const char *encoding,
+	const char *input,
+	size_t length,
+	size_t *size
+)
+{
+	const struct BSencoding *pEncoding;
+
+	BS_CHECK_POINTER(encoding)
+	BS_CHECK_POINTER(input)
+	BS_CHECK_POINTER(size)
+
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
+	}
+
+	return pEncoding->fpValidate(input, length, size);
 }
 
 BSresult
 bs_encode_size(const BS *bs, const char *encoding, size_t *size)
 {
-	size_t iEncoding = 0;
+	const struct BSencoding *pEncoding;
 
 	BS_CHECK_POINTER(bs)
 	BS_ASSERT_VALID(bs)
 	BS_CHECK_POINTER(encoding)
 	BS_CHECK_POINTER(size)
 
-	while (rgEncodings[iEncoding].szName != NULL) {
-		if (strcmp(encoding, rgEncodings[iEncoding].szName) == 0) {
-			*size = rgEncodings[iEncoding].fpSize(bs);
-			return BS_OK;
-		}
-		iEncoding++;
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
 	}
 
-	return BS_BAD_ENCODING;
+	*size = pEncoding->fpSize(bs);
+
+	return BS_OK;
 }
 
 BSresult
 bs_encode(const BS *bs, const char *encoding, char *output)
 {
-	size_t iEncoding = 0;
+	const struct BSencoding *pEncoding;
 
 	BS_CHECK_POINTER(bs)
 	BS_ASSERT_VALID(bs)
 	BS_CHECK_POINTER(encoding)
 	BS_CHECK_POINTER(output)
 
-	while (rgEncodings[iEncoding].szName != NULL) {
-		if (strcmp(encoding, rgEncodings[iEncoding].szName) == 0) {
-			rgEncodings[iEncoding].fpEncode(bs, output);
-			return BS_OK;
-		}
-		iEncoding++;
+	pEncoding = find_encoding(encoding);
+	if (pEncoding == NULL) {
+		return BS_BAD_ENCODING;
 	}
 
-	return BS_BAD_ENCODING;
+	pEncoding->fpEncode(bs, output);
+
+	return BS_OK;
 }
@@ -31,20 +31,95 @@
 
 struct BSencoding {
 	char *szName;
-	BSresult (*fpDecode) (BS *bs, const char *input, size_t length);
+	size_t (*fpDecodeSize) (const char *input, size_t length);
+	BSresult (*fpDecode) (
+		const char *input,
+		size_t length,
+		BSbyte *output,
+		size_t *written
+	);
 	size_t (*fpSize) (const BS *bs);
 	void (*fpEncode) (const BS *bs, char *output);
+	BSresult (*fpValidate) (const char *input, size_t length, size_t *size);
+	int fInPlace;
+	size_t cchBlock;  /* Characters per block, or 0 if blocks vary in length */
+	size_t cbBlock;   /* Bytes per block */
+	const BSbyte *rgbSkipped; /* Characters the decoder skips, or NULL */
 };
 
-BSresult bs_decode_hex       (BS *bs, const char *input, size_t length);
-BSresult bs_decode_base64    (BS *bs, const char *input, size_t length);
-BSresult bs_decode_base64url (BS *bs, const char *input, size_t length);
+/**
+ * Decoding
+ * fpDecodeSize returns the most bytes that decoding INPUT could produce; this
+ * is exact unless the encoding allows characters to be skipped, in which case
+ * rgbSkipped marks them (laid out as for bs_filter_bitmap()).
+ * fpDecode then decodes INPUT into OUTPUT, which must be at least that long,
+ * and passes back the number of bytes written. If it fails then the contents of
+ * OUTPUT are undefined.
+ * Decoders never write more than the exact decoded size, and if fInPlace is set
+ * they never write ahead of the character being read: INPUT and OUTPUT may then
+ * be the same buffer.
+ */
+
+/**
+ * Blocks
+ * Any whole number of complete blocks can be decoded on its own, and gives
+ * exactly cbBlock bytes per block unless padding cuts it short.
+ */
+
+/**
+ * Validation block size
+ * Validators classify characters in blocks of this many, checking for errors
+ * only at the end of each block. This keeps the inner loop free of branches so
+ * that it can be vectorised, while still stopping promptly on bad input.
+ */
+#define BS_VALIDATE_BLOCK 256
+
+size_t bs_decode_size_hex       (const char *input, size_t length);
+size_t bs_decode_size_base64    (const char *input, size_t length);
+size_t bs_decode_size_base64_wrapped (const char *input, size_t length);
+size_t bs_decode_size_base32    (const char *input, size_t length);
+size_t bs_decode_size_base32crockford (const char *input, size_t length);
+size_t bs_decode_size_ascii85   (const char *input, size_t length);
+size_t bs_decode_size_z85       (const char *input, size_t length);
+
+BSresult bs_decode_hex       (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_base64    (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_base64url (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_base64_wrapped (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_base32    (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_base32hex (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_base32crockford (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_ascii85   (const char *input, size_t length, BSbyte *output, size_t *written);
+BSresult bs_decode_z85       (const char *input, size_t length, BSbyte *output, size_t *written);
 
 size_t bs_encode_size_hex    (const BS *bs);
 size_t bs_encode_size_base64 (const BS *bs);
+size_t bs_encode_size_base64mime (const BS *bs);
+size_t bs_encode_size_base64pem  (const BS *bs);
+size_t bs_encode_size_base32    (const BS *bs);
+size_t bs_encode_size_base32crockford (const BS *bs);
+size_t bs_encode_size_ascii85 (const BS *bs);
+size_t bs_encode_size_z85     (const BS *bs);
 
 void bs_encode_hex       (const BS *bs, char *hex);
 void bs_encode_base64    (const BS *bs, char *hex);
 void bs_encode_base64url (const BS *bs, char *hex);
+void bs_encode_base64mime (const BS *bs, char *hex);
+void bs_encode_base64pem  (const BS *bs, char *hex);
+void bs_encode_base32    (const BS *bs, char *hex);
+void bs_encode_base32hex (const BS *bs, char *hex);
+void bs_encode_base32crockford (const BS *bs, char *hex);
+void bs_encode_ascii85   (const BS *bs, char *hex);
+void bs_encode_z85       (const BS *bs, char *hex);
+
+BSresult bs_validate_hex       (const char *input, size_t length, size_t *size);
+BSresult bs_validate_base64    (const char *input, size_t length, size_t *size);
+BSresult bs_validate_base64url (const char *input, size_t length, size_t *size);
+BSresult bs_validate_base64_wrapped (const char *input, size_t length, size_t *size);
+BSresult bs_validate_base32    (const char *input, size_t length, size_t *size);
+BSresult bs_validate_base32hex (const char *input, size_t length, size_t *size);
+BSresult bs_validate_base32crockford (const char *input, size_t length, size_t *size);
+BSresult bs_validate_ascii85   (const char *input, size_t length, size_t *size);
+BSresult bs_validate_z85       (const char *input, size_t length, size_t *size);
 
 #endif /* __ENCODINGS_H */
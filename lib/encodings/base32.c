@@ -0,0 +1,637 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "../bs_internal.h"
+#include "../encodings.h"
+#include <stdint.h>
+
+
+/* ====== */
+/* Decode */
+/* ====== */
+
+/**
+ * These tables are used to convert an ASCII character to its base32 value
+ *  99 = invalid character
+ *  77 = padding ('=')
+ * Crockford's alphabet is case-insensitive and also reads I and L as 1 and O
+ * as 0; it has no padding character. Hyphens may be placed anywhere in it for
+ * readability, and are skipped by the decoder rather than looked up here.
+ */
+static const BSbyte
+rgBase32Decoding[] = {
+/*       0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 1 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 2 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 3 */  99, 99, 26, 27, 28, 29, 30, 31, 99, 99, 99, 99, 99, 77, 99, 99,
+/* 4 */  99,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+/* 5 */  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 99, 99, 99, 99, 99,
+/* 6 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 7 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 8 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 9 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* A */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* B */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* C */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* D */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* E */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* F */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const BSbyte
+rgBase32HexDecoding[] = {
+/*       0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 1 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 2 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 3 */   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 99, 99, 99, 77, 99, 99,
+/* 4 */  99, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+/* 5 */  25, 26, 27, 28, 29, 30, 31, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 6 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 7 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 8 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 9 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* A */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* B */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* C */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* D */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* E */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* F */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const BSbyte
+rgBase32CrockfordDecoding[] = {
+/*       0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 1 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 2 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 3 */   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 99, 99, 99, 99, 99, 99,
+/* 4 */  99, 10, 11, 12, 13, 14, 15, 16, 17,  1, 18, 19,  1, 20, 21,  0,
+/* 5 */  22, 23, 24, 25, 26, 99, 27, 28, 29, 30, 31, 99, 99, 99, 99, 99,
+/* 6 */  99, 10, 11, 12, 13, 14, 15, 16, 17,  1, 18, 19,  1, 20, 21,  0,
+/* 7 */  22, 23, 24, 25, 26, 99, 27, 28, 29, 30, 31, 99, 99, 99, 99, 99,
+/* 8 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 9 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* A */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* B */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* C */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* D */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* E */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* F */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+
+/**
+ * Decode a block of eight characters into five bytes
+ * All eight digits are looked up before they are checked, and are then
+ * assembled into a single 40-bit value so that bytes can be extracted with
+ * shifts rather than bit-by-bit.
+ */
+static BSresult
+read_base32_block(const char *in, BSbyte *out, const BSbyte rgDecoding[])
+{
+	BSbyte in0, in1, in2, in3, in4, in5, in6, in7;
+	uint64_t block;
+
+	in0 = rgDecoding[(BSbyte) in[0]];
+	in1 = rgDecoding[(BSbyte) in[1]];
+	in2 = rgDecoding[(BSbyte) in[2]];
+	in3 = rgDecoding[(BSbyte) in[3]];
+	in4 = rgDecoding[(BSbyte) in[4]];
+	in5 = rgDecoding[(BSbyte) in[5]];
+	in6 = rgDecoding[(BSbyte) in[6]];
+	in7 = rgDecoding[(BSbyte) in[7]];
+
+	/* Valid digits fit within five bits: 77 and 99 don't */
+	if ((in0 | in1 | in2 | in3 | in4 | in5 | in6 | in7) & 0xE0) {
+		return BS_INVALID;
+	}
+
+	block = (uint64_t) in0 << 35 | (uint64_t) in1 << 30
+	      | (uint64_t) in2 << 25 | (uint64_t) in3 << 20
+	      | (uint64_t) in4 << 15 | (uint64_t) in5 << 10
+	      | (uint64_t) in6 <<  5 | (uint64_t) in7;
+
+	out[0] = (BSbyte) (block >> 32);
+	out[1] = (BSbyte) (block >> 24);
+	out[2] = (BSbyte) (block >> 16);
+	out[3] = (BSbyte) (block >>  8);
+	out[4] = (BSbyte) block;
+
+	return BS_OK;
+}
+
+/**
+ * Decode a final partial block of CCHTAIL characters
+ * Only 2, 4, 5 and 7 characters make sense: they hold 1, 2, 3 and 4 bytes.
+ */
+static BSresult
+read_base32_tail(
+	const char *in,
+	size_t cchTail,
+	BSbyte *out,
+	const BSbyte rgDecoding[]
+)
+{
+	size_t ichTail, cbTail;
+	BSbyte digit;
+	uint64_t block = 0;
+
+	switch (cchTail) {
+	case 2: cbTail = 1; break;
+	case 4: cbTail = 2; break;
+	case 5: cbTail = 3; break;
+	case 7: cbTail = 4; break;
+	default: return BS_INVALID;
+	}
+
+	for (ichTail = 0; ichTail < 8; ichTail++) {
+		digit = 0;
+		if (ichTail < cchTail) {
+			digit = rgDecoding[(BSbyte) in[ichTail]];
+			if (digit & 0xE0) {
+				return BS_INVALID;
+			}
+		}
+		block = block << 5 | digit;
+	}
+
+	for (ichTail = 0; ichTail < cbTail; ichTail++) {
+		out[ichTail] = (BSbyte) (block >> (32 - 8 * ichTail));
+	}
+
+	return BS_OK;
+}
+
+/**
+ * Count the data characters in a base32 string
+ * Strips any padding from the end of INPUT, returning the number of characters
+ * left. Returns BS_INVALID if the length of the input is impossible.
+ */
+static BSresult
+count_base32_data(
+	const char *input,
+	size_t length,
+	int fPadded,
+	size_t *cchData
+)
+{
+	*cchData = length;
+
+	if (fPadded) {
+		if (length & 7) {
+			return BS_INVALID;
+		}
+
+		while ((*cchData > 0) && (length - *cchData < 6)
+		    && (input[*cchData - 1] == '=')) {
+			(*cchData)--;
+		}
+	}
+
+	switch (*cchData & 7) {
+	case 0: case 2: case 4: case 5: case 7:
+		return BS_OK;
+	default:
+		return BS_INVALID;
+	}
+}
+
+static size_t
+size_base32_data(size_t cchData)
+{
+	return (cchData >> 3) * 5 + (cchData & 7) * 5 / 8;
+}
+
+static BSresult
+read_base32_string(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written,
+	const BSbyte rgDecoding[],
+	int fPadded
+)
+{
+	size_t cchData, ibInput = 0, ibByteStream = 0;
+	BSresult result;
+
+	result = count_base32_data(input, length, fPadded, &cchData);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	while (cchData - ibInput >= 8) {
+		result = read_base32_block(
+			input + ibInput,
+			output + ibByteStream,
+			rgDecoding
+		);
+
+		if (result != BS_OK) {
+			return result;
+		}
+
+		ibByteStream += 5;
+		ibInput += 8;
+	}
+
+	if (ibInput < cchData) {
+		result = read_base32_tail(
+			input + ibInput,
+			cchData - ibInput,
+			output + ibByteStream,
+			rgDecoding
+		);
+
+		if (result != BS_OK) {
+			return result;
+		}
+	}
+
+	*written = size_base32_data(cchData);
+
+	return BS_OK;
+}
+
+size_t
+bs_decode_size_base32(const char *input, size_t length)
+{
+	size_t cchData;
+
+	count_base32_data(input, length, 1, &cchData);
+
+	return size_base32_data(cchData);
+}
+
+/**
+ * Decode Crockford's base32, which may contain hyphens
+ * Blocks are decoded straight from the input until one fails to read, at which
+ * point the next eight characters other than hyphens are gathered and retried.
+ * Fewer than eight characters left over make up the final partial block.
+ */
+static BSresult
+read_base32crockford_string(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	size_t ibInput = 0, ibByteStream = 0, cchBlock;
+	char rgchBlock[8];
+	BSresult result;
+
+	while (ibInput < length) {
+		result = BS_INVALID;
+
+		if (length - ibInput >= 8) {
+			result = read_base32_block(
+				input + ibInput,
+				output + ibByteStream,
+				rgBase32CrockfordDecoding
+			);
+		}
+
+		if (result == BS_OK) {
+			ibInput += 8;
+			ibByteStream += 5;
+			continue;
+		}
+
+		for (cchBlock = 0; (cchBlock < 8) && (ibInput < length); ibInput++) {
+			if (input[ibInput] != '-') {
+				rgchBlock[cchBlock++] = input[ibInput];
+			}
+		}
+
+		if (cchBlock == 8) {
+			result = read_base32_block(
+				rgchBlock,
+				output + ibByteStream,
+				rgBase32CrockfordDecoding
+			);
+			ibByteStream += 5;
+		} else if (cchBlock > 0) {
+			result = read_base32_tail(
+				rgchBlock,
+				cchBlock,
+				output + ibByteStream,
+				rgBase32CrockfordDecoding
+			);
+			ibByteStream += size_base32_data(cchBlock);
+		} else { /* Only trailing hyphens */
+			result = BS_OK;
+		}
+
+		if (result != BS_OK) {
+			return result;
+		}
+	}
+
+	*written = ibByteStream;
+
+	return BS_OK;
+}
+
+size_t
+bs_decode_size_base32crockford(const char *input, size_t length)
+{
+	UNUSED(input);
+
+	/* Hyphens aren't known about until decoding, so this is a maximum */
+	return size_base32_data(length);
+}
+
+BSresult
+bs_decode_base32(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base32_string(
+		input,
+		length,
+		output,
+		written,
+		rgBase32Decoding,
+		1
+	);
+}
+
+BSresult
+bs_decode_base32hex(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base32_string(
+		input,
+		length,
+		output,
+		written,
+		rgBase32HexDecoding,
+		1
+	);
+}
+
+BSresult
+bs_decode_base32crockford(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base32crockford_string(input, length, output, written);
+}
+
+/* ======== */
+/* Validate */
+/* ======== */
+
+/**
+ * Check a base32 string without decoding it
+ * Digits are looked up and the results ORed together, so the inner loop has no
+ * branches. Sizes and padding are checked exactly as for decoding.
+ */
+static BSresult
+validate_base32_string(
+	const char *input,
+	size_t length,
+	size_t *size,
+	const BSbyte rgDecoding[],
+	int fPadded
+)
+{
+	size_t cchData, ibInput = 0, ibBlock, cchBlock;
+	BSbyte bInvalid = 0;
+	BSresult result;
+
+	result = count_base32_data(input, length, fPadded, &cchData);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	while ((ibInput < cchData) && !(bInvalid & 0xE0)) {
+		cchBlock = cchData - ibInput;
+		if (cchBlock > BS_VALIDATE_BLOCK) {
+			cchBlock = BS_VALIDATE_BLOCK;
+		}
+
+		for (ibBlock = 0; ibBlock < cchBlock; ibBlock++) {
+			bInvalid |= rgDecoding[(BSbyte) input[ibInput + ibBlock]];
+		}
+
+		ibInput += cchBlock;
+	}
+
+	if (bInvalid & 0xE0) {
+		return BS_INVALID;
+	}
+
+	*size = size_base32_data(cchData);
+
+	return BS_OK;
+}
+
+BSresult
+bs_validate_base32(const char *input, size_t length, size_t *size)
+{
+	return validate_base32_string(input, length, size, rgBase32Decoding, 1);
+}
+
+BSresult
+bs_validate_base32hex(const char *input, size_t length, size_t *size)
+{
+	return validate_base32_string(input, length, size, rgBase32HexDecoding, 1);
+}
+
+/**
+ * Check Crockford's base32 without decoding it
+ * Hyphens are masked out of the lookups and left out of the count of digits,
+ * which is then checked as for decoding.
+ */
+BSresult
+bs_validate_base32crockford(const char *input, size_t length, size_t *size)
+{
+	size_t cchData = 0, ibInput = 0, ibBlock, cchBlock;
+	BSbyte bInvalid = 0, ch, fHyphen;
+
+	while ((ibInput < length) && !(bInvalid & 0xE0)) {
+		cchBlock = length - ibInput;
+		if (cchBlock > BS_VALIDATE_BLOCK) {
+			cchBlock = BS_VALIDATE_BLOCK;
+		}
+
+		for (ibBlock = 0; ibBlock < cchBlock; ibBlock++) {
+			ch = (BSbyte) input[ibInput + ibBlock];
+			fHyphen = (ch == '-');
+
+			bInvalid |= rgBase32CrockfordDecoding[ch] & (BSbyte) (fHyphen - 1);
+			cchData += fHyphen ^ 1;
+		}
+
+		ibInput += cchBlock;
+	}
+
+	if (bInvalid & 0xE0) {
+		return BS_INVALID;
+	}
+
+	switch (cchData & 7) {
+	case 0: case 2: case 4: case 5: case 7:
+		break;
+	default:
+		return BS_INVALID;
+	}
+
+	*size = size_base32_data(cchData);
+
+	return BS_OK;
+}
+
+
+/* ==== */
+/* Size */
+/* ==== */
+
+size_t
+bs_encode_size_base32(const BS *bs)
+{
+	return ((bs->cbBytes + 4) / 5 * 8) + 1;
+}
+
+size_t
+bs_encode_size_base32crockford(const BS *bs)
+{
+	return (bs->cbBytes / 5 * 8) + ((bs->cbBytes % 5) * 8 + 4) / 5 + 1;
+}
+
+
+/* ====== */
+/* Encode */
+/* ====== */
+
+static const char
+rgBase32Encoding[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+static const char
+rgBase32HexEncoding[] = "0123456789ABCDEFGHIJKLMNOPQRSTUV";
+
+static const char
+rgBase32CrockfordEncoding[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+
+static void
+write_base32_block(
+	uint64_t block,
+	size_t cchBlock,
+	char *out,
+	const char rgEncoding[]
+)
+{
+	size_t ichBlock;
+
+	for (ichBlock = 0; ichBlock < cchBlock; ichBlock++) {
+		out[ichBlock] = rgEncoding[(block >> (35 - 5 * ichBlock)) & 0x1F];
+	}
+}
+
+static void
+write_base32_string(
+	const BS *bs,
+	char *output,
+	const char rgEncoding[],
+	int fPadded
+)
+{
+	size_t cbTail, cchTail, ibOutput = 0, ibByteStream = 0;
+	const BSbyte *in;
+	uint64_t block;
+
+	while (bs->cbBytes - ibByteStream >= 5) {
+		in = bs->pbBytes + ibByteStream;
+		block = (uint64_t) in[0] << 32 | (uint64_t) in[1] << 24
+		      | (uint64_t) in[2] << 16 | (uint64_t) in[3] <<  8
+		      | (uint64_t) in[4];
+
+		output[ibOutput    ] = rgEncoding[(block >> 35) & 0x1F];
+		output[ibOutput + 1] = rgEncoding[(block >> 30) & 0x1F];
+		output[ibOutput + 2] = rgEncoding[(block >> 25) & 0x1F];
+		output[ibOutput + 3] = rgEncoding[(block >> 20) & 0x1F];
+		output[ibOutput + 4] = rgEncoding[(block >> 15) & 0x1F];
+		output[ibOutput + 5] = rgEncoding[(block >> 10) & 0x1F];
+		output[ibOutput + 6] = rgEncoding[(block >>  5) & 0x1F];
+		output[ibOutput + 7] = rgEncoding[block & 0x1F];
+
+		ibByteStream += 5;
+		ibOutput += 8;
+	}
+
+	cbTail = bs->cbBytes - ibByteStream;
+	if (cbTail > 0) {
+		block = 0;
+		while (ibByteStream < bs->cbBytes) {
+			block = block << 8 | bs->pbBytes[ibByteStream++];
+		}
+		block <<= 8 * (5 - cbTail);
+
+		cchTail = (cbTail * 8 + 4) / 5;
+		write_base32_block(block, cchTail, output + ibOutput, rgEncoding);
+		ibOutput += cchTail;
+
+		while (fPadded && (cchTail < 8)) {
+			output[ibOutput++] = '=';
+			cchTail++;
+		}
+	}
+
+	output[ibOutput] = '\0';
+}
+
+void
+bs_encode_base32(const BS *bs, char *output)
+{
+	write_base32_string(bs, output, rgBase32Encoding, 1);
+}
+
+void
+bs_encode_base32hex(const BS *bs, char *output)
+{
+	write_base32_string(bs, output, rgBase32HexEncoding, 1);
+}
+
+void
+bs_encode_base32crockford(const BS *bs, char *output)
+{
+	write_base32_string(bs, output, rgBase32CrockfordEncoding, 0);
+}
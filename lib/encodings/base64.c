@@ -85,6 +85,11 @@ read_base64_block(const char *in, BSbyte *out, const unsigned int rgDecoding[])
 		return BS_INVALID;
 	}
 
+	/* Padding may only appear in the last two places */
+	if ((in0 == 77) || (in1 == 77) || ((in2 == 77) && (in3 != 77))) {
+		return BS_INVALID;
+	}
+
 	out[0] = in0 << 2 | in1 >> 4;
 	if (in[2] != '=') {
 		out[1] = (in1 & 0xF) << 4 | in2 >> 2;
@@ -95,43 +100,52 @@ read_base64_block(const char *in, BSbyte *out, const unsigned int rgDecoding[])
 	return BS_OK;
 }
 
+static size_t
+size_base64_string(const char *input, size_t length)
+{
+	size_t cbByteStream;
+
+	cbByteStream = (length >> 2) * 3;
+	if ((length > 0) && !(length & 3) && (input[length - 1] == '=')) {
+		cbByteStream--;
+		if (input[length - 2] == '=') {
+			cbByteStream--;
+		}
+	}
+
+	return cbByteStream;
+}
+
 static BSresult
 read_base64_string(
-	BS *bs,
 	const char *input,
 	size_t length,
+	BSbyte *output,
+	size_t *written,
 	const unsigned int rgDecoding[]
 )
 {
-	size_t cbByteStream, ibInput = 0, ibByteStream = 0;
+	size_t ibInput = 0, ibByteStream = 0;
 	BSresult result;
 
 	if (length & 3) {
 		return BS_INVALID;
 	}
 
-	cbByteStream = (length >> 2) * 3;
-	if (input[length - 1] == '=') {
-		cbByteStream--;
-		if (input[length - 2] == '=') {
-			cbByteStream--;
-		}
-	}
-
-	result = bs_malloc(bs, cbByteStream);
-	if (result != BS_OK) {
-		return result;
-	}
-
 	while (ibInput < length) {
 		result = read_base64_block(
 			input + ibInput,
-			bs->pbBytes + ibByteStream,
+			output + ibByteStream,
 			rgDecoding
 		);
 
+		if ((result == BS_OK) && (ibInput + 4 < length)) {
+			if (input[ibInput + 3] == '=') { /* Padding before the end */
+				result = BS_INVALID;
+			}
+		}
+
 		if (result != BS_OK) {
-			bs_malloc(bs, 0);
 			return result;
 		}
 
@@ -139,19 +153,289 @@ read_base64_string(
 		ibInput += 4;
 	}
 
+	*written = size_base64_string(input, length);
+
+	return BS_OK;
+}
+
+static int
+is_base64_whitespace(char ch)
+{
+	return (ch == ' ') || (ch == 0x09) || (ch == 0x0A) || (ch == 0x0D);
+}
+
+/**
+ * Decode base64 which may contain whitespace (e.g. MIME or PEM line breaks)
+ * Blocks are decoded straight from the input until one fails to read, at which
+ * point the next four non-whitespace characters are gathered and retried.
+ * Line breaks are therefore handled inline without filtering the input first.
+ */
+static BSresult
+read_base64_wrapped_string(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written,
+	const unsigned int rgDecoding[]
+)
+{
+	size_t ibInput = 0, ibByteStream = 0, cchBlock;
+	const char *pchBlock;
+	char rgchBlock[4];
+	int fPadded = 0;
+	BSresult result;
+
+	while (ibInput < length) {
+		pchBlock = input + ibInput;
+		result = BS_INVALID;
+
+		if (length - ibInput >= 4) {
+			result = read_base64_block(
+				pchBlock,
+				output + ibByteStream,
+				rgDecoding
+			);
+		}
+
+		if (result == BS_OK) {
+			ibInput += 4;
+		} else {
+			for (cchBlock = 0; (cchBlock < 4) && (ibInput < length); ibInput++) {
+				if (!is_base64_whitespace(input[ibInput])) {
+					rgchBlock[cchBlock++] = input[ibInput];
+				}
+			}
+
+			if (cchBlock == 0) { /* Only trailing whitespace */
+				break;
+			}
+
+			if (cchBlock < 4) {
+				return BS_INVALID;
+			}
+
+			pchBlock = rgchBlock;
+			result = read_base64_block(
+				pchBlock,
+				output + ibByteStream,
+				rgDecoding
+			);
+		}
+
+		if ((result != BS_OK) || fPadded) {
+			return BS_INVALID;
+		}
+
+		ibByteStream += 3;
+		if (pchBlock[3] == '=') {
+			fPadded = 1;
+			ibByteStream -= (pchBlock[2] == '=') ? 2 : 1;
+		}
+	}
+
+	*written = ibByteStream;
+
+	return BS_OK;
+}
+
+size_t
+bs_decode_size_base64(const char *input, size_t length)
+{
+	return size_base64_string(input, length);
+}
+
+size_t
+bs_decode_size_base64_wrapped(const char *input, size_t length)
+{
+	UNUSED(input);
+
+	/* Whitespace isn't known about until decoding, so this is a maximum */
+	return (length >> 2) * 3;
+}
+
+BSresult
+bs_decode_base64(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base64_string(
+		input,
+		length,
+		output,
+		written,
+		rgBase64Decoding
+	);
+}
+
+BSresult
+bs_decode_base64url(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base64_string(
+		input,
+		length,
+		output,
+		written,
+		rgBase64UrlDecoding
+	);
+}
+
+BSresult
+bs_decode_base64_wrapped(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base64_wrapped_string(
+		input,
+		length,
+		output,
+		written,
+		rgBase64Decoding
+	);
+}
+
+/* ======== */
+/* Validate */
+/* ======== */
+
+/**
+ * Classify a base64 digit
+ * Returns non-zero if CH isn't a letter, a number, CH62 or CH63.
+ * Range comparisons are used rather than the decoding tables so that loops
+ * over this function have no branches and can be vectorised.
+ */
+static BSbyte
+is_base64_invalid(BSbyte ch, BSbyte ch62, BSbyte ch63)
+{
+	return ((BSbyte) ((ch | 0x20) - 'a') > 25)
+	     & ((BSbyte) (ch - '0') > 9)
+	     & (ch != ch62)
+	     & (ch != ch63);
+}
+
+static BSresult
+validate_base64_string(
+	const char *input,
+	size_t length,
+	size_t *size,
+	BSbyte ch62,
+	BSbyte ch63
+)
+{
+	size_t cchData = length, cchPadding, ibInput = 0, ibBlock, cchBlock;
+	BSbyte bInvalid = 0;
+
+	if (length & 3) {
+		return BS_INVALID;
+	}
+
+	if ((cchData > 0) && (input[cchData - 1] == '=')) {
+		cchData--;
+		if (input[cchData - 1] == '=') {
+			cchData--;
+		}
+	}
+	cchPadding = length - cchData;
+
+	while ((ibInput < cchData) && !bInvalid) {
+		cchBlock = cchData - ibInput;
+		if (cchBlock > BS_VALIDATE_BLOCK) {
+			cchBlock = BS_VALIDATE_BLOCK;
+		}
+
+		for (ibBlock = 0; ibBlock < cchBlock; ibBlock++) {
+			bInvalid |= is_base64_invalid(
+				(BSbyte) input[ibInput + ibBlock],
+				ch62,
+				ch63
+			);
+		}
+
+		ibInput += cchBlock;
+	}
+
+	if (bInvalid) {
+		return BS_INVALID;
+	}
+
+	*size = (length >> 2) * 3 - cchPadding;
+
 	return BS_OK;
 }
 
 BSresult
-bs_decode_base64(BS *bs, const char *input, size_t length)
+bs_validate_base64(const char *input, size_t length, size_t *size)
 {
-	return read_base64_string(bs, input, length, rgBase64Decoding);
+	return validate_base64_string(input, length, size, '+', '/');
 }
 
 BSresult
-bs_decode_base64url(BS *bs, const char *input, size_t length)
+bs_validate_base64url(const char *input, size_t length, size_t *size)
+{
+	return validate_base64_string(input, length, size, '-', '_');
+}
+
+/**
+ * Check base64 which may contain whitespace
+ * Whitespace and padding are counted alongside digits; afterwards padding is
+ * checked to make sure it all comes at the end of the data.
+ */
+BSresult
+bs_validate_base64_wrapped(const char *input, size_t length, size_t *size)
 {
-	return read_base64_string(bs, input, length, rgBase64UrlDecoding);
+	size_t cchData = 0, cchPadding = 0, ibInput = 0, ibBlock, cchBlock;
+	size_t cchTrailing = 0;
+	BSbyte bInvalid = 0, ch, fWhitespace, fPadding;
+
+	while ((ibInput < length) && !bInvalid) {
+		cchBlock = length - ibInput;
+		if (cchBlock > BS_VALIDATE_BLOCK) {
+			cchBlock = BS_VALIDATE_BLOCK;
+		}
+
+		for (ibBlock = 0; ibBlock < cchBlock; ibBlock++) {
+			ch = (BSbyte) input[ibInput + ibBlock];
+			fWhitespace = (ch == ' ') | (ch == 0x09)
+			            | (ch == 0x0A) | (ch == 0x0D);
+			fPadding = (ch == '=');
+
+			bInvalid |= is_base64_invalid(ch, '+', '/')
+			          & (fWhitespace ^ 1) & (fPadding ^ 1);
+			cchData += fWhitespace ^ 1;
+			cchPadding += fPadding;
+		}
+
+		ibInput += cchBlock;
+	}
+
+	if (bInvalid || (cchData & 3) || (cchPadding > 2)) {
+		return BS_INVALID;
+	}
+
+	/* All padding must come at the very end */
+	ibInput = length;
+	while (cchTrailing < cchPadding) {
+		ibInput--;
+		if (input[ibInput] == '=') {
+			cchTrailing++;
+		} else if (!is_base64_whitespace(input[ibInput])) {
+			return BS_INVALID;
+		}
+	}
+
+	*size = (cchData >> 2) * 3 - cchPadding;
+
+	return BS_OK;
 }
 
 
@@ -165,6 +449,33 @@ bs_encode_size_base64(const BS *bs)
 	return ((bs->cbBytes + 2) / 3 * 4) + 1;
 }
 
+static size_t
+size_base64_wrapped(const BS *bs, size_t cchLine, size_t cchNewline)
+{
+	size_t cchEncoded, cLines;
+
+	cchEncoded = (bs->cbBytes + 2) / 3 * 4;
+	if (cchEncoded == 0) {
+		return 1;
+	}
+
+	cLines = (cchEncoded + cchLine - 1) / cchLine;
+
+	return cchEncoded + (cLines - 1) * cchNewline + 1;
+}
+
+size_t
+bs_encode_size_base64mime(const BS *bs)
+{
+	return size_base64_wrapped(bs, 76, 2);
+}
+
+size_t
+bs_encode_size_base64pem(const BS *bs)
+{
+	return size_base64_wrapped(bs, 64, 1);
+}
+
 
 /* ====== */
 /* Encode */
@@ -212,23 +523,86 @@ write_base64_bytes(
 	}
 }
 
+static size_t
+write_base64_bytes_run(
+	const BSbyte *in,
+	size_t length,
+	char *out,
+	const char rgEncoding[]
+)
+{
+	size_t ibInput = 0, ibOutput = 0;
+
+	while (ibInput < length) {
+		write_base64_bytes(
+			in + ibInput,
+			length - ibInput,
+			out + ibOutput,
+			rgEncoding
+		);
+
+		ibInput += 3;
+		ibOutput += 4;
+	}
+
+	return ibOutput;
+}
+
 static void
 write_base64_string(const BS *bs, char *output, const char rgEncoding[])
 {
-	size_t cbByteStream, ibOutput = 0, ibByteStream = 0;
+	size_t ibOutput;
 
-	cbByteStream = bs->cbBytes;
+	ibOutput = write_base64_bytes_run(
+		bs->pbBytes,
+		bs->cbBytes,
+		output,
+		rgEncoding
+	);
 
-	while (ibByteStream < cbByteStream) {
-		write_base64_bytes(
+	output[ibOutput] = '\0';
+}
+
+/**
+ * Encode base64 broken into lines of CCHLINE characters
+ * CCHLINE must be a multiple of four so that each line holds whole blocks.
+ * Lines are separated by SZNEWLINE; no separator follows the final line.
+ */
+static void
+write_base64_wrapped_string(
+	const BS *bs,
+	char *output,
+	size_t cchLine,
+	const char *szNewline
+)
+{
+	size_t cbLine, cbRun, ibOutput = 0, ibByteStream = 0;
+	const char *pchNewline;
+
+	assert((cchLine & 3) == 0);
+
+	cbLine = cchLine / 4 * 3;
+
+	while (ibByteStream < bs->cbBytes) {
+		if (ibByteStream > 0) {
+			for (pchNewline = szNewline; *pchNewline != '\0'; pchNewline++) {
+				output[ibOutput++] = *pchNewline;
+			}
+		}
+
+		cbRun = bs->cbBytes - ibByteStream;
+		if (cbRun > cbLine) {
+			cbRun = cbLine;
+		}
+
+		ibOutput += write_base64_bytes_run(
 			bs->pbBytes + ibByteStream,
-			cbByteStream - ibByteStream,
+			cbRun,
 			output + ibOutput,
-			rgEncoding
+			rgBase64Encoding
 		);
 
-		ibByteStream += 3;
-		ibOutput += 4;
+		ibByteStream += cbRun;
 	}
 
 	output[ibOutput] = '\0';
@@ -245,3 +619,15 @@ bs_encode_base64url(const BS *bs, char *output)
 {
 	write_base64_string(bs, output, rgBase64UrlEncoding);
 }
+
+void
+bs_encode_base64mime(const BS *bs, char *output)
+{
+	write_base64_wrapped_string(bs, output, 76, "\r\n");
+}
+
+void
+bs_encode_base64pem(const BS *bs, char *output)
+{
+	write_base64_wrapped_string(bs, output, 64, "\n");
+}
@@ -0,0 +1,454 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "../bs_internal.h"
+#include "../encodings.h"
+#include <stdint.h>
+
+
+/* ====== */
+/* Decode */
+/* ====== */
+
+/**
+ * These tables are used to convert an ASCII character to its base85 value
+ *  99 = invalid character
+ * Ascii85's 'z' shorthand for four zero bytes is handled separately.
+ */
+static const BSbyte
+rgAscii85Decoding[] = {
+/*       0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 1 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 2 */  99,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+/* 3 */  15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
+/* 4 */  31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+/* 5 */  47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62,
+/* 6 */  63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78,
+/* 7 */  79, 80, 81, 82, 83, 84, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 8 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 9 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* A */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* B */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* C */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* D */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* E */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* F */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const BSbyte
+rgZ85Decoding[] = {
+/*       0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 1 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 2 */  99, 68, 99, 84, 83, 82, 72, 99, 75, 76, 70, 65, 99, 63, 62, 69,
+/* 3 */   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 64, 99, 73, 66, 74, 71,
+/* 4 */  81, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50,
+/* 5 */  51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 77, 99, 78, 67, 99,
+/* 6 */  99, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+/* 7 */  25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 79, 99, 80, 99, 99,
+/* 8 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* 9 */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* A */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* B */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* C */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* D */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* E */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+/* F */  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/**
+ * Decode CCHBLOCK characters into CCHBLOCK - 1 bytes
+ * Full blocks have five characters. A shorter final block is treated as though
+ * it were padded with the highest digit, and its extra bytes are discarded.
+ * The value is accumulated in 64 bits so that overflow can be detected.
+ */
+static BSresult
+read_base85_block(
+	const char *in,
+	size_t cchBlock,
+	BSbyte *out,
+	const BSbyte rgDecoding[]
+)
+{
+	size_t ichBlock;
+	BSbyte digit;
+	uint64_t block = 0;
+
+	for (ichBlock = 0; ichBlock < 5; ichBlock++) {
+		digit = 84;
+		if (ichBlock < cchBlock) {
+			digit = rgDecoding[(BSbyte) in[ichBlock]];
+			if (digit > 84) {
+				return BS_INVALID;
+			}
+		}
+		block = block * 85 + digit;
+	}
+
+	if (block > 0xFFFFFFFFUL) {
+		return BS_INVALID;
+	}
+
+	out[0] = (BSbyte) (block >> 24);
+	if (cchBlock > 2) {
+		out[1] = (BSbyte) (block >> 16);
+	}
+	if (cchBlock > 3) {
+		out[2] = (BSbyte) (block >> 8);
+	}
+	if (cchBlock > 4) {
+		out[3] = (BSbyte) block;
+	}
+
+	return BS_OK;
+}
+
+/**
+ * Size a decoded base85 string
+ * If FZEROES is set then each 'z' stands for four bytes; these are counted up
+ * front so that the output can be sized exactly.
+ */
+static size_t
+size_base85_string(const char *input, size_t length, int fZeroes)
+{
+	size_t cchZeroes = 0, cchDigits, cbByteStream, ibInput;
+
+	if (fZeroes) {
+		for (ibInput = 0; ibInput < length; ibInput++) {
+			cchZeroes += (input[ibInput] == 'z');
+		}
+	}
+
+	cchDigits = length - cchZeroes;
+
+	cbByteStream = cchZeroes * 4 + cchDigits / 5 * 4;
+	if (cchDigits % 5 > 1) {
+		cbByteStream += cchDigits % 5 - 1;
+	}
+
+	return cbByteStream;
+}
+
+/**
+ * Decode a base85 string
+ * If FZEROES is set then 'z' may appear between blocks to stand for four zero
+ * bytes.
+ */
+static BSresult
+read_base85_string(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written,
+	const BSbyte rgDecoding[],
+	int fZeroes
+)
+{
+	size_t cchBlock, ibInput = 0, ibByteStream = 0;
+	BSresult result;
+
+	while (ibInput < length) {
+		if (fZeroes && (input[ibInput] == 'z')) {
+			output[ibByteStream    ] = 0;
+			output[ibByteStream + 1] = 0;
+			output[ibByteStream + 2] = 0;
+			output[ibByteStream + 3] = 0;
+			ibByteStream += 4;
+			ibInput++;
+			continue;
+		}
+
+		cchBlock = length - ibInput;
+		if (cchBlock > 5) {
+			cchBlock = 5;
+		}
+
+		result = BS_INVALID;
+		if (cchBlock > 1) {
+			result = read_base85_block(
+				input + ibInput,
+				cchBlock,
+				output + ibByteStream,
+				rgDecoding
+			);
+		}
+
+		if (result != BS_OK) {
+			return result;
+		}
+
+		ibByteStream += cchBlock - 1;
+		ibInput += cchBlock;
+	}
+
+	*written = ibByteStream;
+
+	return BS_OK;
+}
+
+size_t
+bs_decode_size_ascii85(const char *input, size_t length)
+{
+	return size_base85_string(input, length, 1);
+}
+
+size_t
+bs_decode_size_z85(const char *input, size_t length)
+{
+	return size_base85_string(input, length, 0);
+}
+
+BSresult
+bs_decode_ascii85(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base85_string(
+		input,
+		length,
+		output,
+		written,
+		rgAscii85Decoding,
+		1
+	);
+}
+
+BSresult
+bs_decode_z85(
+	const char *input,
+	size_t length,
+	BSbyte *output,
+	size_t *written
+)
+{
+	return read_base85_string(
+		input,
+		length,
+		output,
+		written,
+		rgZ85Decoding,
+		0
+	);
+}
+
+/* ======== */
+/* Validate */
+/* ======== */
+
+/**
+ * Check a base85 string without decoding it
+ * Each block is decoded into a scratch word so that overflow is detected
+ * exactly as it would be by decoding.
+ */
+static BSresult
+validate_base85_string(
+	const char *input,
+	size_t length,
+	size_t *size,
+	const BSbyte rgDecoding[],
+	int fZeroes
+)
+{
+	size_t cchBlock, cbOutput = 0, ibInput = 0;
+	BSbyte rgbScratch[4];
+	BSresult result;
+
+	while (ibInput < length) {
+		if (fZeroes && (input[ibInput] == 'z')) {
+			cbOutput += 4;
+			ibInput++;
+			continue;
+		}
+
+		cchBlock = length - ibInput;
+		if (cchBlock > 5) {
+			cchBlock = 5;
+		}
+
+		if (cchBlock < 2) {
+			return BS_INVALID;
+		}
+
+		result = read_base85_block(
+			input + ibInput,
+			cchBlock,
+			rgbScratch,
+			rgDecoding
+		);
+
+		if (result != BS_OK) {
+			return result;
+		}
+
+		cbOutput += cchBlock - 1;
+		ibInput += cchBlock;
+	}
+
+	*size = cbOutput;
+
+	return BS_OK;
+}
+
+BSresult
+bs_validate_ascii85(const char *input, size_t length, size_t *size)
+{
+	return validate_base85_string(input, length, size, rgAscii85Decoding, 1);
+}
+
+BSresult
+bs_validate_z85(const char *input, size_t length, size_t *size)
+{
+	return validate_base85_string(input, length, size, rgZ85Decoding, 0);
+}
+
+
+/* ==== */
+/* Size */
+/* ==== */
+
+static uint32_t
+read_word(const BSbyte *in)
+{
+	return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16
+	     | (uint32_t) in[2] <<  8 | (uint32_t) in[3];
+}
+
+size_t
+bs_encode_size_ascii85(const BS *bs)
+{
+	size_t cchOutput, ibByteStream;
+
+	cchOutput = bs_encode_size_z85(bs);
+
+	/* Each zero word shrinks from five characters to one */
+	for (ibByteStream = 0; bs->cbBytes - ibByteStream >= 4; ibByteStream += 4) {
+		if (read_word(bs->pbBytes + ibByteStream) == 0) {
+			cchOutput -= 4;
+		}
+	}
+
+	return cchOutput;
+}
+
+size_t
+bs_encode_size_z85(const BS *bs)
+{
+	size_t cchOutput;
+
+	cchOutput = bs->cbBytes / 4 * 5 + 1;
+	if (bs->cbBytes % 4 > 0) {
+		cchOutput += bs->cbBytes % 4 + 1;
+	}
+
+	return cchOutput;
+}
+
+
+/* ====== */
+/* Encode */
+/* ====== */
+
+static const char
+rgAscii85Encoding[] =
+	"!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTU"
+	"VWXYZ[\\]^_`abcdefghijklmnopqrstu";
+
+static const char
+rgZ85Encoding[] =
+	"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	".-:+=^!/*?&<>()[]{}@%$#";
+
+static void
+write_base85_word(uint32_t word, char *out, const char rgEncoding[])
+{
+	out[4] = rgEncoding[word % 85]; word /= 85;
+	out[3] = rgEncoding[word % 85]; word /= 85;
+	out[2] = rgEncoding[word % 85]; word /= 85;
+	out[1] = rgEncoding[word % 85]; word /= 85;
+	out[0] = rgEncoding[word];
+}
+
+/**
+ * Encode a string as base85
+ * Four bytes are read as a big-endian word and written as five digits. A final
+ * partial word of N bytes is zero-padded and written as N + 1 digits.
+ * If FZEROES is set then zero words are abbreviated to 'z'.
+ */
+static void
+write_base85_string(
+	const BS *bs,
+	char *output,
+	const char rgEncoding[],
+	int fZeroes
+)
+{
+	size_t cbTail, ibTail, ibOutput = 0, ibByteStream = 0;
+	BSbyte rgbTail[4] = { 0, 0, 0, 0 };
+	char rgchTail[5];
+	uint32_t word;
+
+	for (; bs->cbBytes - ibByteStream >= 4; ibByteStream += 4) {
+		word = read_word(bs->pbBytes + ibByteStream);
+
+		if (fZeroes && (word == 0)) {
+			output[ibOutput++] = 'z';
+		} else {
+			write_base85_word(word, output + ibOutput, rgEncoding);
+			ibOutput += 5;
+		}
+	}
+
+	cbTail = bs->cbBytes - ibByteStream;
+	if (cbTail > 0) {
+		for (ibTail = 0; ibTail < cbTail; ibTail++) {
+			rgbTail[ibTail] = bs->pbBytes[ibByteStream + ibTail];
+		}
+
+		write_base85_word(read_word(rgbTail), rgchTail, rgEncoding);
+		for (ibTail = 0; ibTail <= cbTail; ibTail++) {
+			output[ibOutput++] = rgchTail[ibTail];
+		}
+	}
+
+	output[ibOutput] = '\0';
+}
+
+void
+bs_encode_ascii85(const BS *bs, char *output)
+{
+	write_base85_string(bs, output, rgAscii85Encoding, 1);
+}
+
+void
+bs_encode_z85(const BS *bs, char *output)
+{
+	write_base85_string(bs, output, rgZ85Encoding, 0);
+}
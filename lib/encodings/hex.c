@@ -46,11 +46,18 @@ read_hex_digit(char digit)
 	return 16;
 }
 
+size_t
+bs_decode_size_hex(const char *input, size_t length)
+{
+	UNUSED(input);
+
+	return length >> 1;
+}
+
 BSresult
-bs_decode_hex(BS *bs, const char *input, size_t length)
+bs_decode_hex(const char *input, size_t length, BSbyte *output, size_t *written)
 {
 	size_t ibInput;
-	BSresult result;
 	BSbyte hi;
 	BSbyte lo;
 
@@ -58,23 +65,58 @@ bs_decode_hex(BS *bs, const char *input, size_t length)
 		return BS_INVALID;
 	}
 
-	result = bs_malloc(bs, length >> 1);
-	if (result != BS_OK) {
-		return result;
-	}
-
 	for (ibInput = 0; ibInput < length; ibInput += 2) {
 		hi = (BSbyte)read_hex_digit(input[ibInput]);
 		lo = (BSbyte)read_hex_digit(input[ibInput + 1]);
 
 		if (hi > 15 || lo > 15) {
-			bs_malloc(bs, 0);
 			return BS_INVALID;
 		}
 
-		bs->pbBytes[ibInput >> 1] = (hi << 4) | lo;
+		output[ibInput >> 1] = (hi << 4) | lo;
+	}
+
+	*written = length >> 1;
+
+	return BS_OK;
+}
+
+/**
+ * Check a hex string without decoding it
+ * Digits are classified with range comparisons rather than table lookups so
+ * that the inner loop has no branches and can be vectorised.
+ */
+BSresult
+bs_validate_hex(const char *input, size_t length, size_t *size)
+{
+	size_t ibInput = 0, ibBlock, cchBlock;
+	BSbyte bInvalid = 0, ch;
+
+	if (length & 1) {
+		return BS_INVALID;
+	}
+
+	while ((ibInput < length) && !bInvalid) {
+		cchBlock = length - ibInput;
+		if (cchBlock > BS_VALIDATE_BLOCK) {
+			cchBlock = BS_VALIDATE_BLOCK;
+		}
+
+		for (ibBlock = 0; ibBlock < cchBlock; ibBlock++) {
+			ch = (BSbyte) input[ibInput + ibBlock];
+			bInvalid |= ((BSbyte) (ch - '0') > 9)
+			          & ((BSbyte) ((ch | 0x20) - 'a') > 5);
+		}
+
+		ibInput += cchBlock;
 	}
 
+	if (bInvalid) {
+		return BS_INVALID;
+	}
+
+	*size = length >> 1;
+
 	return BS_OK;
 }
 
@@ -26,49 +26,918 @@
 
 #include "libbs.h"
 #include "bs_internal.h"
+#include "cpu.h"
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
 
 BSresult
 bs_filter(BS *bs, BSfilter (*operation) (BSbyte byte))
+{
+	return bs_filter_to(bs, bs, operation);
+}
+
+static size_t
+filter_bytes(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	BSfilter (*operation) (BSbyte byte)
+)
 {
 	size_t ibRead = 0, ibWrite = 0;
 	BSbyte bCurrent;
 
+	while (ibRead < cbInput) {
+		bCurrent = pbInput[ibRead];
+		if (operation(bCurrent) == BS_INCLUDE) {
+			pbOutput[ibWrite] = bCurrent;
+			ibWrite++;
+		}
+		ibRead++;
+	}
+
+	return ibWrite;
+}
+
+BSresult
+bs_filter_to(BS *dst, const BS *src, BSfilter (*operation) (BSbyte byte))
+{
+	BSresult result;
+
+	BS_CHECK_POINTER(dst)
+	BS_CHECK_POINTER(src)
+	BS_ASSERT_VALID(dst)
+	BS_ASSERT_VALID(src)
+	BS_CHECK_POINTER(operation)
+
+	/* Reserve for the worst case, where every byte is kept */
+	result = bs_malloc(dst, src->cbBytes);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	dst->cbBytes = filter_bytes(
+		dst->pbBytes,
+		src->pbBytes,
+		src->cbBytes,
+		operation
+	);
+
+	return BS_OK;
+}
+
+BSresult
+bs_filter_ctx(
+	BS *bs,
+	BSfilter (*operation) (BSbyte byte, size_t index, void *data),
+	void *data
+)
+{
+	size_t ibRead = 0, ibWrite = 0, cbRead;
+	BSbyte bCurrent;
+
 	BS_CHECK_POINTER(bs)
 	BS_ASSERT_VALID(bs)
 	BS_CHECK_POINTER(operation)
 
-	while (ibRead < bs_size(bs)) {
+	cbRead = bs->cbBytes;
+	while (ibRead < cbRead) {
 		bCurrent = bs->pbBytes[ibRead];
-		if (operation(bCurrent) == BS_INCLUDE) {
+		if (operation(bCurrent, ibRead, data) == BS_INCLUDE) {
 			bs->pbBytes[ibWrite] = bCurrent;
 			ibWrite++;
 		}
 		ibRead++;
 	}
 
-	/* ibWrite now refers to last byte written */
 	bs->cbBytes = ibWrite;
 
 	return BS_OK;
 }
 
-BSfilter
-filter_whitespace(BSbyte byte)
+BSresult
+bs_filter_blocks(
+	BS *bs,
+	size_t block_size,
+	BSresult (*operation) (
+		BSbyte *block,
+		size_t length,
+		size_t offset,
+		size_t *kept,
+		void *data
+	),
+	void *data
+)
 {
-	switch (byte) {
-		case 0x09: /* HT */
-		case 0x0A: /* LF */
-		case 0x0D: /* CR */
-		case ' ':
-			return BS_EXCLUDE;
+	size_t ibRead = 0, ibWrite = 0, cbRead, cbBlock, cbKept;
+	BSresult result = BS_OK;
+
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+	BS_CHECK_POINTER(operation)
+
+	if (block_size == 0) {
+		return BS_INVALID;
+	}
+
+	cbRead = bs->cbBytes;
+	while (ibRead < cbRead) {
+		cbBlock = cbRead - ibRead;
+		if (cbBlock > block_size) {
+			cbBlock = block_size;
+		}
 
-		default:
-			return BS_INCLUDE;
+		cbKept = cbBlock;
+		result = operation(
+			bs->pbBytes + ibRead,
+			cbBlock,
+			ibRead,
+			&cbKept,
+			data
+		);
+		if (result != BS_OK) {
+			break;
+		}
+		if (cbKept > cbBlock) {
+			result = BS_INVALID;
+			break;
+		}
+
+		/* Close up the gap left by earlier blocks */
+		if (ibWrite != ibRead) {
+			memmove(bs->pbBytes + ibWrite, bs->pbBytes + ibRead, cbKept);
+		}
+
+		ibWrite += cbKept;
+		ibRead += cbBlock;
 	}
+
+	/* On failure the stream is cut short after the last complete block */
+	bs->cbBytes = ibWrite;
+
+	return result;
 }
 
+#ifdef BS_SIMD_X86
+
+/*
+ * Row M lists the positions of the bits set in M, in order. Shuffling a group
+ * of eight bytes with row M moves the bytes picked out by M to the front.
+ */
+static const BSbyte
+rgCompact[256][8] = {
+	/* 0x00 */ { 0, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x01 */ { 0, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x02 */ { 1, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x03 */ { 0, 1, 0, 0, 0, 0, 0, 0 },
+	/* 0x04 */ { 2, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x05 */ { 0, 2, 0, 0, 0, 0, 0, 0 },
+	/* 0x06 */ { 1, 2, 0, 0, 0, 0, 0, 0 },
+	/* 0x07 */ { 0, 1, 2, 0, 0, 0, 0, 0 },
+	/* 0x08 */ { 3, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x09 */ { 0, 3, 0, 0, 0, 0, 0, 0 },
+	/* 0x0A */ { 1, 3, 0, 0, 0, 0, 0, 0 },
+	/* 0x0B */ { 0, 1, 3, 0, 0, 0, 0, 0 },
+	/* 0x0C */ { 2, 3, 0, 0, 0, 0, 0, 0 },
+	/* 0x0D */ { 0, 2, 3, 0, 0, 0, 0, 0 },
+	/* 0x0E */ { 1, 2, 3, 0, 0, 0, 0, 0 },
+	/* 0x0F */ { 0, 1, 2, 3, 0, 0, 0, 0 },
+	/* 0x10 */ { 4, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x11 */ { 0, 4, 0, 0, 0, 0, 0, 0 },
+	/* 0x12 */ { 1, 4, 0, 0, 0, 0, 0, 0 },
+	/* 0x13 */ { 0, 1, 4, 0, 0, 0, 0, 0 },
+	/* 0x14 */ { 2, 4, 0, 0, 0, 0, 0, 0 },
+	/* 0x15 */ { 0, 2, 4, 0, 0, 0, 0, 0 },
+	/* 0x16 */ { 1, 2, 4, 0, 0, 0, 0, 0 },
+	/* 0x17 */ { 0, 1, 2, 4, 0, 0, 0, 0 },
+	/* 0x18 */ { 3, 4, 0, 0, 0, 0, 0, 0 },
+	/* 0x19 */ { 0, 3, 4, 0, 0, 0, 0, 0 },
+	/* 0x1A */ { 1, 3, 4, 0, 0, 0, 0, 0 },
+	/* 0x1B */ { 0, 1, 3, 4, 0, 0, 0, 0 },
+	/* 0x1C */ { 2, 3, 4, 0, 0, 0, 0, 0 },
+	/* 0x1D */ { 0, 2, 3, 4, 0, 0, 0, 0 },
+	/* 0x1E */ { 1, 2, 3, 4, 0, 0, 0, 0 },
+	/* 0x1F */ { 0, 1, 2, 3, 4, 0, 0, 0 },
+	/* 0x20 */ { 5, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x21 */ { 0, 5, 0, 0, 0, 0, 0, 0 },
+	/* 0x22 */ { 1, 5, 0, 0, 0, 0, 0, 0 },
+	/* 0x23 */ { 0, 1, 5, 0, 0, 0, 0, 0 },
+	/* 0x24 */ { 2, 5, 0, 0, 0, 0, 0, 0 },
+	/* 0x25 */ { 0, 2, 5, 0, 0, 0, 0, 0 },
+	/* 0x26 */ { 1, 2, 5, 0, 0, 0, 0, 0 },
+	/* 0x27 */ { 0, 1, 2, 5, 0, 0, 0, 0 },
+	/* 0x28 */ { 3, 5, 0, 0, 0, 0, 0, 0 },
+	/* 0x29 */ { 0, 3, 5, 0, 0, 0, 0, 0 },
+	/* 0x2A */ { 1, 3, 5, 0, 0, 0, 0, 0 },
+	/* 0x2B */ { 0, 1, 3, 5, 0, 0, 0, 0 },
+	/* 0x2C */ { 2, 3, 5, 0, 0, 0, 0, 0 },
+	/* 0x2D */ { 0, 2, 3, 5, 0, 0, 0, 0 },
+	/* 0x2E */ { 1, 2, 3, 5, 0, 0, 0, 0 },
+	/* 0x2F */ { 0, 1, 2, 3, 5, 0, 0, 0 },
+	/* 0x30 */ { 4, 5, 0, 0, 0, 0, 0, 0 },
+	/* 0x31 */ { 0, 4, 5, 0, 0, 0, 0, 0 },
+	/* 0x32 */ { 1, 4, 5, 0, 0, 0, 0, 0 },
+	/* 0x33 */ { 0, 1, 4, 5, 0, 0, 0, 0 },
+	/* 0x34 */ { 2, 4, 5, 0, 0, 0, 0, 0 },
+	/* 0x35 */ { 0, 2, 4, 5, 0, 0, 0, 0 },
+	/* 0x36 */ { 1, 2, 4, 5, 0, 0, 0, 0 },
+	/* 0x37 */ { 0, 1, 2, 4, 5, 0, 0, 0 },
+	/* 0x38 */ { 3, 4, 5, 0, 0, 0, 0, 0 },
+	/* 0x39 */ { 0, 3, 4, 5, 0, 0, 0, 0 },
+	/* 0x3A */ { 1, 3, 4, 5, 0, 0, 0, 0 },
+	/* 0x3B */ { 0, 1, 3, 4, 5, 0, 0, 0 },
+	/* 0x3C */ { 2, 3, 4, 5, 0, 0, 0, 0 },
+	/* 0x3D */ { 0, 2, 3, 4, 5, 0, 0, 0 },
+	/* 0x3E */ { 1, 2, 3, 4, 5, 0, 0, 0 },
+	/* 0x3F */ { 0, 1, 2, 3, 4, 5, 0, 0 },
+	/* 0x40 */ { 6, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x41 */ { 0, 6, 0, 0, 0, 0, 0, 0 },
+	/* 0x42 */ { 1, 6, 0, 0, 0, 0, 0, 0 },
+	/* 0x43 */ { 0, 1, 6, 0, 0, 0, 0, 0 },
+	/* 0x44 */ { 2, 6, 0, 0, 0, 0, 0, 0 },
+	/* 0x45 */ { 0, 2, 6, 0, 0, 0, 0, 0 },
+	/* 0x46 */ { 1, 2, 6, 0, 0, 0, 0, 0 },
+	/* 0x47 */ { 0, 1, 2, 6, 0, 0, 0, 0 },
+	/* 0x48 */ { 3, 6, 0, 0, 0, 0, 0, 0 },
+	/* 0x49 */ { 0, 3, 6, 0, 0, 0, 0, 0 },
+	/* 0x4A */ { 1, 3, 6, 0, 0, 0, 0, 0 },
+	/* 0x4B */ { 0, 1, 3, 6, 0, 0, 0, 0 },
+	/* 0x4C */ { 2, 3, 6, 0, 0, 0, 0, 0 },
+	/* 0x4D */ { 0, 2, 3, 6, 0, 0, 0, 0 },
+	/* 0x4E */ { 1, 2, 3, 6, 0, 0, 0, 0 },
+	/* 0x4F */ { 0, 1, 2, 3, 6, 0, 0, 0 },
+	/* 0x50 */ { 4, 6, 0, 0, 0, 0, 0, 0 },
+	/* 0x51 */ { 0, 4, 6, 0, 0, 0, 0, 0 },
+	/* 0x52 */ { 1, 4, 6, 0, 0, 0, 0, 0 },
+	/* 0x53 */ { 0, 1, 4, 6, 0, 0, 0, 0 },
+	/* 0x54 */ { 2, 4, 6, 0, 0, 0, 0, 0 },
+	/* 0x55 */ { 0, 2, 4, 6, 0, 0, 0, 0 },
+	/* 0x56 */ { 1, 2, 4, 6, 0, 0, 0, 0 },
+	/* 0x57 */ { 0, 1, 2, 4, 6, 0, 0, 0 },
+	/* 0x58 */ { 3, 4, 6, 0, 0, 0, 0, 0 },
+	/* 0x59 */ { 0, 3, 4, 6, 0, 0, 0, 0 },
+	/* 0x5A */ { 1, 3, 4, 6, 0, 0, 0, 0 },
+	/* 0x5B */ { 0, 1, 3, 4, 6, 0, 0, 0 },
+	/* 0x5C */ { 2, 3, 4, 6, 0, 0, 0, 0 },
+	/* 0x5D */ { 0, 2, 3, 4, 6, 0, 0, 0 },
+	/* 0x5E */ { 1, 2, 3, 4, 6, 0, 0, 0 },
+	/* 0x5F */ { 0, 1, 2, 3, 4, 6, 0, 0 },
+	/* 0x60 */ { 5, 6, 0, 0, 0, 0, 0, 0 },
+	/* 0x61 */ { 0, 5, 6, 0, 0, 0, 0, 0 },
+	/* 0x62 */ { 1, 5, 6, 0, 0, 0, 0, 0 },
+	/* 0x63 */ { 0, 1, 5, 6, 0, 0, 0, 0 },
+	/* 0x64 */ { 2, 5, 6, 0, 0, 0, 0, 0 },
+	/* 0x65 */ { 0, 2, 5, 6, 0, 0, 0, 0 },
+	/* 0x66 */ { 1, 2, 5, 6, 0, 0, 0, 0 },
+	/* 0x67 */ { 0, 1, 2, 5, 6, 0, 0, 0 },
+	/* 0x68 */ { 3, 5, 6, 0, 0, 0, 0, 0 },
+	/* 0x69 */ { 0, 3, 5, 6, 0, 0, 0, 0 },
+	/* 0x6A */ { 1, 3, 5, 6, 0, 0, 0, 0 },
+	/* 0x6B */ { 0, 1, 3, 5, 6, 0, 0, 0 },
+	/* 0x6C */ { 2, 3, 5, 6, 0, 0, 0, 0 },
+	/* 0x6D */ { 0, 2, 3, 5, 6, 0, 0, 0 },
+	/* 0x6E */ { 1, 2, 3, 5, 6, 0, 0, 0 },
+	/* 0x6F */ { 0, 1, 2, 3, 5, 6, 0, 0 },
+	/* 0x70 */ { 4, 5, 6, 0, 0, 0, 0, 0 },
+	/* 0x71 */ { 0, 4, 5, 6, 0, 0, 0, 0 },
+	/* 0x72 */ { 1, 4, 5, 6, 0, 0, 0, 0 },
+	/* 0x73 */ { 0, 1, 4, 5, 6, 0, 0, 0 },
+	/* 0x74 */ { 2, 4, 5, 6, 0, 0, 0, 0 },
+	/* 0x75 */ { 0, 2, 4, 5, 6, 0, 0, 0 },
+	/* 0x76 */ { 1, 2, 4, 5, 6, 0, 0, 0 },
+	/* 0x77 */ { 0, 1, 2, 4, 5, 6, 0, 0 },
+	/* 0x78 */ { 3, 4, 5, 6, 0, 0, 0, 0 },
+	/* 0x79 */ { 0, 3, 4, 5, 6, 0, 0, 0 },
+	/* 0x7A */ { 1, 3, 4, 5, 6, 0, 0, 0 },
+	/* 0x7B */ { 0, 1, 3, 4, 5, 6, 0, 0 },
+	/* 0x7C */ { 2, 3, 4, 5, 6, 0, 0, 0 },
+	/* 0x7D */ { 0, 2, 3, 4, 5, 6, 0, 0 },
+	/* 0x7E */ { 1, 2, 3, 4, 5, 6, 0, 0 },
+	/* 0x7F */ { 0, 1, 2, 3, 4, 5, 6, 0 },
+	/* 0x80 */ { 7, 0, 0, 0, 0, 0, 0, 0 },
+	/* 0x81 */ { 0, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0x82 */ { 1, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0x83 */ { 0, 1, 7, 0, 0, 0, 0, 0 },
+	/* 0x84 */ { 2, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0x85 */ { 0, 2, 7, 0, 0, 0, 0, 0 },
+	/* 0x86 */ { 1, 2, 7, 0, 0, 0, 0, 0 },
+	/* 0x87 */ { 0, 1, 2, 7, 0, 0, 0, 0 },
+	/* 0x88 */ { 3, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0x89 */ { 0, 3, 7, 0, 0, 0, 0, 0 },
+	/* 0x8A */ { 1, 3, 7, 0, 0, 0, 0, 0 },
+	/* 0x8B */ { 0, 1, 3, 7, 0, 0, 0, 0 },
+	/* 0x8C */ { 2, 3, 7, 0, 0, 0, 0, 0 },
+	/* 0x8D */ { 0, 2, 3, 7, 0, 0, 0, 0 },
+	/* 0x8E */ { 1, 2, 3, 7, 0, 0, 0, 0 },
+	/* 0x8F */ { 0, 1, 2, 3, 7, 0, 0, 0 },
+	/* 0x90 */ { 4, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0x91 */ { 0, 4, 7, 0, 0, 0, 0, 0 },
+	/* 0x92 */ { 1, 4, 7, 0, 0, 0, 0, 0 },
+	/* 0x93 */ { 0, 1, 4, 7, 0, 0, 0, 0 },
+	/* 0x94 */ { 2, 4, 7, 0, 0, 0, 0, 0 },
+	/* 0x95 */ { 0, 2, 4, 7, 0, 0, 0, 0 },
+	/* 0x96 */ { 1, 2, 4, 7, 0, 0, 0, 0 },
+	/* 0x97 */ { 0, 1, 2, 4, 7, 0, 0, 0 },
+	/* 0x98 */ { 3, 4, 7, 0, 0, 0, 0, 0 },
+	/* 0x99 */ { 0, 3, 4, 7, 0, 0, 0, 0 },
+	/* 0x9A */ { 1, 3, 4, 7, 0, 0, 0, 0 },
+	/* 0x9B */ { 0, 1, 3, 4, 7, 0, 0, 0 },
+	/* 0x9C */ { 2, 3, 4, 7, 0, 0, 0, 0 },
+	/* 0x9D */ { 0, 2, 3, 4, 7, 0, 0, 0 },
+	/* 0x9E */ { 1, 2, 3, 4, 7, 0, 0, 0 },
+	/* 0x9F */ { 0, 1, 2, 3, 4, 7, 0, 0 },
+	/* 0xA0 */ { 5, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0xA1 */ { 0, 5, 7, 0, 0, 0, 0, 0 },
+	/* 0xA2 */ { 1, 5, 7, 0, 0, 0, 0, 0 },
+	/* 0xA3 */ { 0, 1, 5, 7, 0, 0, 0, 0 },
+	/* 0xA4 */ { 2, 5, 7, 0, 0, 0, 0, 0 },
+	/* 0xA5 */ { 0, 2, 5, 7, 0, 0, 0, 0 },
+	/* 0xA6 */ { 1, 2, 5, 7, 0, 0, 0, 0 },
+	/* 0xA7 */ { 0, 1, 2, 5, 7, 0, 0, 0 },
+	/* 0xA8 */ { 3, 5, 7, 0, 0, 0, 0, 0 },
+	/* 0xA9 */ { 0, 3, 5, 7, 0, 0, 0, 0 },
+	/* 0xAA */ { 1, 3, 5, 7, 0, 0, 0, 0 },
+	/* 0xAB */ { 0, 1, 3, 5, 7, 0, 0, 0 },
+	/* 0xAC */ { 2, 3, 5, 7, 0, 0, 0, 0 },
+	/* 0xAD */ { 0, 2, 3, 5, 7, 0, 0, 0 },
+	/* 0xAE */ { 1, 2, 3, 5, 7, 0, 0, 0 },
+	/* 0xAF */ { 0, 1, 2, 3, 5, 7, 0, 0 },
+	/* 0xB0 */ { 4, 5, 7, 0, 0, 0, 0, 0 },
+	/* 0xB1 */ { 0, 4, 5, 7, 0, 0, 0, 0 },
+	/* 0xB2 */ { 1, 4, 5, 7, 0, 0, 0, 0 },
+	/* 0xB3 */ { 0, 1, 4, 5, 7, 0, 0, 0 },
+	/* 0xB4 */ { 2, 4, 5, 7, 0, 0, 0, 0 },
+	/* 0xB5 */ { 0, 2, 4, 5, 7, 0, 0, 0 },
+	/* 0xB6 */ { 1, 2, 4, 5, 7, 0, 0, 0 },
+	/* 0xB7 */ { 0, 1, 2, 4, 5, 7, 0, 0 },
+	/* 0xB8 */ { 3, 4, 5, 7, 0, 0, 0, 0 },
+	/* 0xB9 */ { 0, 3, 4, 5, 7, 0, 0, 0 },
+	/* 0xBA */ { 1, 3, 4, 5, 7, 0, 0, 0 },
+	/* 0xBB */ { 0, 1, 3, 4, 5, 7, 0, 0 },
+	/* 0xBC */ { 2, 3, 4, 5, 7, 0, 0, 0 },
+	/* 0xBD */ { 0, 2, 3, 4, 5, 7, 0, 0 },
+	/* 0xBE */ { 1, 2, 3, 4, 5, 7, 0, 0 },
+	/* 0xBF */ { 0, 1, 2, 3, 4, 5, 7, 0 },
+	/* 0xC0 */ { 6, 7, 0, 0, 0, 0, 0, 0 },
+	/* 0xC1 */ { 0, 6, 7, 0, 0, 0, 0, 0 },
+	/* 0xC2 */ { 1, 6, 7, 0, 0, 0, 0, 0 },
+	/* 0xC3 */ { 0, 1, 6, 7, 0, 0, 0, 0 },
+	/* 0xC4 */ { 2, 6, 7, 0, 0, 0, 0, 0 },
+	/* 0xC5 */ { 0, 2, 6, 7, 0, 0, 0, 0 },
+	/* 0xC6 */ { 1, 2, 6, 7, 0, 0, 0, 0 },
+	/* 0xC7 */ { 0, 1, 2, 6, 7, 0, 0, 0 },
+	/* 0xC8 */ { 3, 6, 7, 0, 0, 0, 0, 0 },
+	/* 0xC9 */ { 0, 3, 6, 7, 0, 0, 0, 0 },
+	/* 0xCA */ { 1, 3, 6, 7, 0, 0, 0, 0 },
+	/* 0xCB */ { 0, 1, 3, 6, 7, 0, 0, 0 },
+	/* 0xCC */ { 2, 3, 6, 7, 0, 0, 0, 0 },
+	/* 0xCD */ { 0, 2, 3, 6, 7, 0, 0, 0 },
+	/* 0xCE */ { 1, 2, 3, 6, 7, 0, 0, 0 },
+	/* 0xCF */ { 0, 1, 2, 3, 6, 7, 0, 0 },
+	/* 0xD0 */ { 4, 6, 7, 0, 0, 0, 0, 0 },
+	/* 0xD1 */ { 0, 4, 6, 7, 0, 0, 0, 0 },
+	/* 0xD2 */ { 1, 4, 6, 7, 0, 0, 0, 0 },
+	/* 0xD3 */ { 0, 1, 4, 6, 7, 0, 0, 0 },
+	/* 0xD4 */ { 2, 4, 6, 7, 0, 0, 0, 0 },
+	/* 0xD5 */ { 0, 2, 4, 6, 7, 0, 0, 0 },
+	/* 0xD6 */ { 1, 2, 4, 6, 7, 0, 0, 0 },
+	/* 0xD7 */ { 0, 1, 2, 4, 6, 7, 0, 0 },
+	/* 0xD8 */ { 3, 4, 6, 7, 0, 0, 0, 0 },
+	/* 0xD9 */ { 0, 3, 4, 6, 7, 0, 0, 0 },
+	/* 0xDA */ { 1, 3, 4, 6, 7, 0, 0, 0 },
+	/* 0xDB */ { 0, 1, 3, 4, 6, 7, 0, 0 },
+	/* 0xDC */ { 2, 3, 4, 6, 7, 0, 0, 0 },
+	/* 0xDD */ { 0, 2, 3, 4, 6, 7, 0, 0 },
+	/* 0xDE */ { 1, 2, 3, 4, 6, 7, 0, 0 },
+	/* 0xDF */ { 0, 1, 2, 3, 4, 6, 7, 0 },
+	/* 0xE0 */ { 5, 6, 7, 0, 0, 0, 0, 0 },
+	/* 0xE1 */ { 0, 5, 6, 7, 0, 0, 0, 0 },
+	/* 0xE2 */ { 1, 5, 6, 7, 0, 0, 0, 0 },
+	/* 0xE3 */ { 0, 1, 5, 6, 7, 0, 0, 0 },
+	/* 0xE4 */ { 2, 5, 6, 7, 0, 0, 0, 0 },
+	/* 0xE5 */ { 0, 2, 5, 6, 7, 0, 0, 0 },
+	/* 0xE6 */ { 1, 2, 5, 6, 7, 0, 0, 0 },
+	/* 0xE7 */ { 0, 1, 2, 5, 6, 7, 0, 0 },
+	/* 0xE8 */ { 3, 5, 6, 7, 0, 0, 0, 0 },
+	/* 0xE9 */ { 0, 3, 5, 6, 7, 0, 0, 0 },
+	/* 0xEA */ { 1, 3, 5, 6, 7, 0, 0, 0 },
+	/* 0xEB */ { 0, 1, 3, 5, 6, 7, 0, 0 },
+	/* 0xEC */ { 2, 3, 5, 6, 7, 0, 0, 0 },
+	/* 0xED */ { 0, 2, 3, 5, 6, 7, 0, 0 },
+	/* 0xEE */ { 1, 2, 3, 5, 6, 7, 0, 0 },
+	/* 0xEF */ { 0, 1, 2, 3, 5, 6, 7, 0 },
+	/* 0xF0 */ { 4, 5, 6, 7, 0, 0, 0, 0 },
+	/* 0xF1 */ { 0, 4, 5, 6, 7, 0, 0, 0 },
+	/* 0xF2 */ { 1, 4, 5, 6, 7, 0, 0, 0 },
+	/* 0xF3 */ { 0, 1, 4, 5, 6, 7, 0, 0 },
+	/* 0xF4 */ { 2, 4, 5, 6, 7, 0, 0, 0 },
+	/* 0xF5 */ { 0, 2, 4, 5, 6, 7, 0, 0 },
+	/* 0xF6 */ { 1, 2, 4, 5, 6, 7, 0, 0 },
+	/* 0xF7 */ { 0, 1, 2, 4, 5, 6, 7, 0 },
+	/* 0xF8 */ { 3, 4, 5, 6, 7, 0, 0, 0 },
+	/* 0xF9 */ { 0, 3, 4, 5, 6, 7, 0, 0 },
+	/* 0xFA */ { 1, 3, 4, 5, 6, 7, 0, 0 },
+	/* 0xFB */ { 0, 1, 3, 4, 5, 6, 7, 0 },
+	/* 0xFC */ { 2, 3, 4, 5, 6, 7, 0, 0 },
+	/* 0xFD */ { 0, 2, 3, 4, 5, 6, 7, 0 },
+	/* 0xFE */ { 1, 2, 3, 4, 5, 6, 7, 0 },
+	/* 0xFF */ { 0, 1, 2, 3, 4, 5, 6, 7 }
+};
+
+/*
+ * The kernels below classify bytes against a set using nibble lookups. Row
+ * table entry LO (for bytes below 0x80) or 16 + LO (for the rest) has bit H set
+ * if byte ((H << 4) | LO) is in the set, with H taken modulo 8.
+ * Shuffles return zero for indices with the top bit set, which is used to pick
+ * between the two halves of the row table without a blend.
+ * The rows_match kernels return a mask of the bytes in the set; the others work
+ * through whole vectors only, returning the number of bytes read. Filters pass
+ * back the number kept in *PIBWRITE, and PBOUTPUT may be the same as PBINPUT.
+ */
+
+static BS_TARGET("avx2") unsigned int
+rows_match_avx2(__m256i v, __m256i vRowsLow, __m256i vRowsHigh)
+{
+	const __m256i vBits = _mm256_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128
+	);
+	__m256i vRow, vBit;
+
+	vRow = _mm256_or_si256(
+		_mm256_shuffle_epi8(vRowsLow, v),
+		_mm256_shuffle_epi8(
+			vRowsHigh,
+			_mm256_xor_si256(v, _mm256_set1_epi8(-128))
+		)
+	);
+	vBit = _mm256_shuffle_epi8(
+		vBits,
+		_mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F))
+	);
+
+	return (unsigned int) _mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(_mm256_and_si256(vRow, vBit), vBit)
+	);
+}
+
+static BS_TARGET("avx512bw") __mmask64
+rows_match_avx512(__m512i v, __m512i vRowsLow, __m512i vRowsHigh)
+{
+	const __m512i vBits = _mm512_broadcast_i32x4(_mm_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128
+	));
+	__m512i vRow, vBit;
+
+	vRow = _mm512_or_si512(
+		_mm512_shuffle_epi8(vRowsLow, v),
+		_mm512_shuffle_epi8(
+			vRowsHigh,
+			_mm512_xor_si512(v, _mm512_set1_epi8(-128))
+		)
+	);
+	vBit = _mm512_shuffle_epi8(
+		vBits,
+		_mm512_and_si512(_mm512_srli_epi16(v, 4), _mm512_set1_epi8(0x0F))
+	);
+
+	return _mm512_test_epi8_mask(vRow, vBit);
+}
+
+static BS_TARGET("avx2,popcnt") size_t
+filter_rows_avx2(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte rgbRows[32],
+	size_t *pibWrite
+)
+{
+	const __m256i vRowsLow = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *) rgbRows)
+	);
+	const __m256i vRowsHigh = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *) (rgbRows + 16))
+	);
+	const __m128i vEight = _mm_set1_epi8(8);
+	__m256i v;
+	__m128i vHalf, vShuffle;
+	size_t ibRead = 0, ibWrite = 0;
+	unsigned int grfKeep, grfHalf;
+	int iHalf;
+
+	while (cbInput - ibRead >= 32) {
+		v = _mm256_loadu_si256((const __m256i *) (pbInput + ibRead));
+		grfKeep = ~rows_match_avx2(v, vRowsLow, vRowsHigh);
+
+		/*
+		 * Compact eight bytes at a time. Each store may run past the bytes
+		 * kept, but never past the vector just read.
+		 */
+		for (iHalf = 0; iHalf < 2; iHalf++) {
+			vHalf = iHalf ? _mm256_extracti128_si256(v, 1)
+			              : _mm256_castsi256_si128(v);
+			grfHalf = (grfKeep >> (16 * iHalf)) & 0xFFFF;
+			vShuffle = _mm_unpacklo_epi64(
+				_mm_loadl_epi64((const __m128i *) rgCompact[grfHalf & 0xFF]),
+				_mm_add_epi8(
+					_mm_loadl_epi64((const __m128i *) rgCompact[grfHalf >> 8]),
+					vEight
+				)
+			);
+			vHalf = _mm_shuffle_epi8(vHalf, vShuffle);
+
+			_mm_storel_epi64((__m128i *) (pbOutput + ibWrite), vHalf);
+			ibWrite += __builtin_popcount(grfHalf & 0xFF);
+			_mm_storel_epi64(
+				(__m128i *) (pbOutput + ibWrite),
+				_mm_srli_si128(vHalf, 8)
+			);
+			ibWrite += __builtin_popcount(grfHalf >> 8);
+		}
+
+		ibRead += 32;
+	}
+
+	*pibWrite = ibWrite;
+	return ibRead;
+}
+
+static BS_TARGET("avx512bw,avx512vbmi2,popcnt") size_t
+filter_rows_avx512vbmi2(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte rgbRows[32],
+	size_t *pibWrite
+)
+{
+	const __m512i vRowsLow = _mm512_broadcast_i32x4(
+		_mm_loadu_si128((const __m128i *) rgbRows)
+	);
+	const __m512i vRowsHigh = _mm512_broadcast_i32x4(
+		_mm_loadu_si128((const __m128i *) (rgbRows + 16))
+	);
+	__m512i v;
+	__mmask64 grfKeep;
+	size_t ibRead = 0, ibWrite = 0;
+
+	while (cbInput - ibRead >= 64) {
+		v = _mm512_loadu_si512(pbInput + ibRead);
+		grfKeep = ~rows_match_avx512(v, vRowsLow, vRowsHigh);
+
+		/* As above, the store never runs past the vector just read */
+		_mm512_storeu_si512(
+			pbOutput + ibWrite,
+			_mm512_maskz_compress_epi8(grfKeep, v)
+		);
+		ibWrite += __builtin_popcountll(grfKeep);
+		ibRead += 64;
+	}
+
+	*pibWrite = ibWrite;
+	return ibRead;
+}
+
+static BS_TARGET("avx2,popcnt") size_t
+count_rows_avx2(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte rgbRows[32],
+	size_t *pcMatched
+)
+{
+	const __m256i vRowsLow = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *) rgbRows)
+	);
+	const __m256i vRowsHigh = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *) (rgbRows + 16))
+	);
+	size_t ibRead = 0, cMatched = 0;
+
+	while (cbInput - ibRead >= 32) {
+		cMatched += __builtin_popcount(rows_match_avx2(
+			_mm256_loadu_si256((const __m256i *) (pbInput + ibRead)),
+			vRowsLow,
+			vRowsHigh
+		));
+		ibRead += 32;
+	}
+
+	*pcMatched = cMatched;
+	return ibRead;
+}
+
+static BS_TARGET("avx512bw,popcnt") size_t
+count_rows_avx512(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte rgbRows[32],
+	size_t *pcMatched
+)
+{
+	const __m512i vRowsLow = _mm512_broadcast_i32x4(
+		_mm_loadu_si128((const __m128i *) rgbRows)
+	);
+	const __m512i vRowsHigh = _mm512_broadcast_i32x4(
+		_mm_loadu_si128((const __m128i *) (rgbRows + 16))
+	);
+	size_t ibRead = 0, cMatched = 0;
+
+	while (cbInput - ibRead >= 64) {
+		cMatched += __builtin_popcountll(rows_match_avx512(
+			_mm512_loadu_si512(pbInput + ibRead),
+			vRowsLow,
+			vRowsHigh
+		));
+		ibRead += 64;
+	}
+
+	*pcMatched = cMatched;
+	return ibRead;
+}
+
+/**
+ * Build the nibble row table used by the kernels above from a bitmap
+ */
+static void
+bitmap_rows(const BSbyte bitmap[32], BSbyte rgbRows[32])
+{
+	size_t iByte;
+
+	for (iByte = 0; iByte < 32; iByte++) {
+		rgbRows[iByte] = 0;
+	}
+	for (iByte = 0; iByte < 256; iByte++) {
+		if (bitmap[iByte >> 3] & (1 << (iByte & 7))) {
+			rgbRows[((iByte >> 3) & 0x10) | (iByte & 0x0F)] |=
+				1 << ((iByte >> 4) & 7);
+		}
+	}
+}
+
+#endif /* BS_SIMD_X86 */
+
+size_t
+bs_filter_bitmap_bytes(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte bitmap[32]
+)
+{
+	size_t ibRead = 0, ibWrite = 0;
+	BSbyte bCurrent;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+	BSbyte rgbRows[32];
+
+	if (grfFeatures & (BS_CPU_AVX512VBMI2 | BS_CPU_AVX2)) {
+		bitmap_rows(bitmap, rgbRows);
+
+		if (grfFeatures & BS_CPU_AVX512VBMI2) {
+			ibRead = filter_rows_avx512vbmi2(
+				pbOutput, pbInput, cbInput, rgbRows, &ibWrite
+			);
+		} else {
+			ibRead = filter_rows_avx2(
+				pbOutput, pbInput, cbInput, rgbRows, &ibWrite
+			);
+		}
+	}
+#endif
+
+	/* Always write, but only move on past bytes which are kept */
+	while (ibRead < cbInput) {
+		bCurrent = pbInput[ibRead];
+		pbOutput[ibWrite] = bCurrent;
+		ibWrite += !(bitmap[bCurrent >> 3] & (1 << (bCurrent & 7)));
+		ibRead++;
+	}
+
+	return ibWrite;
+}
+
+size_t
+bs_count_bitmap_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte bitmap[32]
+)
+{
+	size_t ibRead = 0, cMatched = 0;
+	BSbyte bCurrent;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+	BSbyte rgbRows[32];
+
+	if (grfFeatures & (BS_CPU_AVX512VBMI | BS_CPU_AVX2)) {
+		bitmap_rows(bitmap, rgbRows);
+
+		if (grfFeatures & BS_CPU_AVX512VBMI) {
+			ibRead = count_rows_avx512(pbInput, cbInput, rgbRows, &cMatched);
+		} else {
+			ibRead = count_rows_avx2(pbInput, cbInput, rgbRows, &cMatched);
+		}
+	}
+#endif
+
+	while (ibRead < cbInput) {
+		bCurrent = pbInput[ibRead];
+		cMatched += (bitmap[bCurrent >> 3] >> (bCurrent & 7)) & 1;
+		ibRead++;
+	}
+
+	return cMatched;
+}
+
+BSresult
+bs_filter_bitmap(BS *bs, const BSbyte bitmap[32])
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(bitmap)
+	BS_ASSERT_VALID(bs)
+
+	bs->cbBytes = bs_filter_bitmap_bytes(
+		bs->pbBytes,
+		bs->pbBytes,
+		bs->cbBytes,
+		bitmap
+	);
+
+	return BS_OK;
+}
+
+BSresult
+bs_filter_set(BS *bs, const BSbyte *set, size_t length)
+{
+	BSbyte rgbBitmap[32];
+	size_t ibSet;
+
+	BS_CHECK_POINTER(set)
+
+	for (ibSet = 0; ibSet < 32; ibSet++) {
+		rgbBitmap[ibSet] = 0;
+	}
+	for (ibSet = 0; ibSet < length; ibSet++) {
+		rgbBitmap[set[ibSet] >> 3] |= 1 << (set[ibSet] & 7);
+	}
+
+	return bs_filter_bitmap(bs, rgbBitmap);
+}
+
+struct BSfilterjob {
+	BSbyte *pbOutput;                       /* Start of the whole output */
+	const BSbyte *pbInput;                  /* Start of the whole input */
+	BSfilter (*fpOperation) (BSbyte byte);  /* Operation, if not a bitmap */
+	const BSbyte *pbBitmap;                 /* Bitmap, if not an operation */
+	size_t *rgcbKept;                       /* Count kept from each range */
+};
+
+static BSresult
+filter_range(size_t offset, size_t length, void *data)
+{
+	struct BSfilterjob *job = data;
+	size_t cbKept;
+
+	if (job->pbBitmap != NULL) {
+		cbKept = bs_filter_bitmap_bytes(
+			job->pbOutput + offset,
+			job->pbInput + offset,
+			length,
+			job->pbBitmap
+		);
+	} else {
+		cbKept = filter_bytes(
+			job->pbOutput + offset,
+			job->pbInput + offset,
+			length,
+			job->fpOperation
+		);
+	}
+
+	job->rgcbKept[offset / BS_PARALLEL_RANGE] = cbKept;
+
+	return BS_OK;
+}
+
+/*
+ * Each range is filtered in parallel to the start of its own place in DST.
+ * The ranges are then closed up from left to right: every range moves towards
+ * the front of the stream, possibly over ranges which haven't moved yet, so
+ * this part has to be done in order.
+ */
+static BSresult
+filter_parallel(
+	BS *dst,
+	const BS *src,
+	BSfilter (*operation) (BSbyte byte),
+	const BSbyte *bitmap,
+	BSpool *pool
+)
+{
+	struct BSfilterjob job;
+	size_t cRanges, iRange, ibWrite = 0, ibRange;
+	BSresult result;
+
+	cRanges = (src->cbBytes + BS_PARALLEL_RANGE - 1) / BS_PARALLEL_RANGE;
+	if (cRanges == 0) {
+		return bs_malloc(dst, 0);
+	}
+
+	job.rgcbKept = malloc(cRanges * sizeof(size_t));
+	if (job.rgcbKept == NULL) {
+		return BS_MEMORY;
+	}
+
+	result = bs_malloc(dst, src->cbBytes);
+	if (result != BS_OK) {
+		free(job.rgcbKept);
+		return result;
+	}
+
+	job.pbOutput = dst->pbBytes;
+	job.pbInput = src->pbBytes;
+	job.fpOperation = operation;
+	job.pbBitmap = bitmap;
+
+	result = bs_pool_run(
+		pool,
+		src->cbBytes,
+		BS_PARALLEL_RANGE,
+		filter_range,
+		&job
+	);
+
+	if (result == BS_OK) {
+		for (iRange = 0; iRange < cRanges; iRange++) {
+			ibRange = iRange * BS_PARALLEL_RANGE;
+			if (ibWrite != ibRange) {
+				memmove(
+					dst->pbBytes + ibWrite,
+					dst->pbBytes + ibRange,
+					job.rgcbKept[iRange]
+				);
+			}
+			ibWrite += job.rgcbKept[iRange];
+		}
+		dst->cbBytes = ibWrite;
+	}
+
+	free(job.rgcbKept);
+
+	return result;
+}
+
+BSresult
+bs_filter_parallel(BS *bs, BSfilter (*operation) (BSbyte byte), BSpool *pool)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(bs)
+
+	return filter_parallel(bs, bs, operation, NULL, pool);
+}
+
+BSresult
+bs_filter_to_parallel(
+	BS *dst,
+	const BS *src,
+	BSfilter (*operation) (BSbyte byte),
+	BSpool *pool
+)
+{
+	BS_CHECK_POINTER(dst)
+	BS_CHECK_POINTER(src)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(dst)
+	BS_ASSERT_VALID(src)
+
+	return filter_parallel(dst, src, operation, NULL, pool);
+}
+
+BSresult
+bs_filter_bitmap_parallel(BS *bs, const BSbyte bitmap[32], BSpool *pool)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(bitmap)
+	BS_ASSERT_VALID(bs)
+
+	return filter_parallel(bs, bs, NULL, bitmap, pool);
+}
+
+/* HT, LF, CR and ' ' */
+static const BSbyte
+rgWhitespace[32] = {
+	0x00, 0x26, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
 BSresult
 bs_filter_whitespace(BS *bs)
 {
-	return bs_filter(bs, filter_whitespace);
+	return bs_filter_bitmap(bs, rgWhitespace);
 }
@@ -26,7 +26,11 @@
 
 #include "libbs.h"
 #include "bs_internal.h"
+#include "cpu.h"
+#include "pool.h"
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 BSresult
 bs_fold(
@@ -52,70 +56,745 @@ bs_fold(
 	return BS_OK;
 }
 
-static BSresult
-sum_byte(BSbyte byte, void *data)
+BSresult
+bs_fold_blocks(
+	const BS *bs,
+	size_t block_size,
+	BSresult (*operation) (const BSbyte *block, size_t length, void *data),
+	void *data
+)
 {
-	unsigned int *piSum = (unsigned int *) data;
-	unsigned int iOriginalSum;
+	size_t ibByteStream = 0, cbBlock;
+	BSresult result;
 
-	assert(piSum != NULL);
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(bs)
 
-	iOriginalSum = *piSum;
+	if (block_size == 0) {
+		return BS_INVALID;
+	}
 
-	*piSum += byte;
+	while (ibByteStream < bs->cbBytes) {
+		cbBlock = bs->cbBytes - ibByteStream;
+		if (cbBlock > block_size) {
+			cbBlock = block_size;
+		}
 
-	if (*piSum < iOriginalSum) {
-		return BS_OVERFLOW;
+		result = operation(bs->pbBytes + ibByteStream, cbBlock, data);
+		if (result != BS_OK) {
+			return result;
+		}
+
+		ibByteStream += cbBlock;
 	}
 
 	return BS_OK;
 }
 
+struct BSfoldjob {
+	const BSbyte *pbBytes;  /* Start of the whole stream */
+	BSbyte *pbValues;       /* One value per range */
+	size_t cbValue;
+	const void *pIdentity;
+	BSresult (*fpReduce) (
+		const BSbyte *block,
+		size_t length,
+		void *value,
+		void *data
+	);
+	void *pData;
+};
+
 static BSresult
-bitcount_byte(BSbyte byte, void *data)
+fold_range(size_t offset, size_t length, void *data)
 {
-	unsigned int *piCount = (unsigned int *) data;
-	unsigned int iOriginalCount;
+	struct BSfoldjob *job = data;
+	void *pValue = job->pbValues + offset / BS_PARALLEL_RANGE * job->cbValue;
 
-	assert(piCount != NULL);
+	memcpy(pValue, job->pIdentity, job->cbValue);
+
+	return job->fpReduce(job->pbBytes + offset, length, pValue, job->pData);
+}
 
-	iOriginalCount = *piCount;
+/*
+ * Each range is reduced in parallel into its own value. The values are then
+ * combined from left to right on the calling thread, so the result doesn't
+ * depend on how the ranges were shared out.
+ */
+BSresult
+bs_fold_parallel(
+	const BS *bs,
+	void *value,
+	size_t value_size,
+	const void *identity,
+	BSresult (*reduce) (
+		const BSbyte *block,
+		size_t length,
+		void *value,
+		void *data
+	),
+	BSresult (*combine) (void *value, const void *other, void *data),
+	void *data,
+	BSpool *pool
+)
+{
+	struct BSfoldjob job;
+	size_t cRanges, iRange;
+	BSresult result;
 
-	*piCount = *piCount
-	         + (byte & 128) / 128
-	         + (byte &  64) /  64
-	         + (byte &  32) /  32
-	         + (byte &  16) /  16
-	         + (byte &   8) /   8
-	         + (byte &   4) /   4
-	         + (byte &   2) /   2
-	         + (byte &   1) /   1;
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(value)
+	BS_CHECK_POINTER(identity)
+	BS_CHECK_POINTER(reduce)
+	BS_CHECK_POINTER(combine)
+	BS_ASSERT_VALID(bs)
 
-	if (*piCount < iOriginalCount) {
-		return BS_OVERFLOW;
+	if (value_size == 0) {
+		return BS_INVALID;
 	}
 
-	return BS_OK;
+	cRanges = (bs->cbBytes + BS_PARALLEL_RANGE - 1) / BS_PARALLEL_RANGE;
+	if (cRanges <= 1) {
+		/* Combining with the identity changes nothing, so fold directly */
+		memmove(value, identity, value_size);
+		if (cRanges == 0) {
+			return BS_OK;
+		}
+		return reduce(bs->pbBytes, bs->cbBytes, value, data);
+	}
+
+	job.pbValues = malloc(cRanges * value_size);
+	if (job.pbValues == NULL) {
+		return BS_MEMORY;
+	}
+
+	job.pbBytes = bs->pbBytes;
+	job.cbValue = value_size;
+	job.pIdentity = identity;
+	job.fpReduce = reduce;
+	job.pData = data;
+
+	result = bs_pool_run(
+		pool,
+		bs->cbBytes,
+		BS_PARALLEL_RANGE,
+		fold_range,
+		&job
+	);
+
+	if (result == BS_OK) {
+		memmove(value, identity, value_size);
+		for (iRange = 0; (iRange < cRanges) && (result == BS_OK); iRange++) {
+			result = combine(value, job.pbValues + iRange * value_size, data);
+		}
+	}
+
+	free(job.pbValues);
+	return result;
 }
 
 BSresult
 bs_fold_sum(const BS *bs, unsigned int *sum)
 {
+	uint64_t cSum;
+	BSresult result;
+
 	BS_CHECK_POINTER(bs)
 	BS_CHECK_POINTER(sum)
 
 	*sum = 0;
 
-	return bs_fold(bs, sum_byte, sum);
+	result = bs_sum64(bs, &cSum);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	if (cSum > UINT_MAX) {
+		return BS_OVERFLOW;
+	}
+
+	*sum = (unsigned int) cSum;
+	return BS_OK;
 }
 
 BSresult
 bs_fold_bitcount(const BS *bs, unsigned int *count)
 {
+	uint64_t cBits;
+	BSresult result;
+
 	BS_CHECK_POINTER(bs)
 	BS_CHECK_POINTER(count)
 
 	*count = 0;
 
-	return bs_fold(bs, bitcount_byte, count);
+	result = bs_popcount(bs, &cBits);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	if (cBits > UINT_MAX) {
+		return BS_OVERFLOW;
+	}
+
+	*count = (unsigned int) cBits;
+	return BS_OK;
+}
+
+/*
+ * Population count kernels
+ * Each works through as much of the input as suits it, returning the number of
+ * bytes read and adding the bits found to *PCBITS.
+ */
+
+/* Masks of repeating 01, 0011, 00001111 and 00000001 bit patterns */
+#define MASK_1 (~(uint64_t) 0 / 3)
+#define MASK_2 (~(uint64_t) 0 / 5)
+#define MASK_4 (~(uint64_t) 0 / 17)
+#define MASK_8 (~(uint64_t) 0 / 255)
+
+static unsigned int
+popcount_word(uint64_t word)
+{
+	word = word - ((word >> 1) & MASK_1);
+	word = (word & MASK_2) + ((word >> 2) & MASK_2);
+	word = (word + (word >> 4)) & MASK_4;
+
+	return (unsigned int) ((word * MASK_8) >> 56);
+}
+
+static size_t
+popcount_words(const BSbyte *pbInput, size_t cbInput, uint64_t *pcBits)
+{
+	uint64_t word, cBits = 0;
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 8) {
+		memcpy(&word, pbInput + ibRead, 8);
+		cBits += popcount_word(word);
+		ibRead += 8;
+	}
+
+	*pcBits += cBits;
+	return ibRead;
+}
+
+#ifdef BS_SIMD_X86
+
+static BS_TARGET("popcnt") size_t
+popcount_words_popcnt(const BSbyte *pbInput, size_t cbInput, uint64_t *pcBits)
+{
+	uint64_t rgWords[4], cBits = 0;
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 32) {
+		memcpy(rgWords, pbInput + ibRead, 32);
+		cBits += __builtin_popcountll(rgWords[0])
+		       + __builtin_popcountll(rgWords[1])
+		       + __builtin_popcountll(rgWords[2])
+		       + __builtin_popcountll(rgWords[3]);
+		ibRead += 32;
+	}
+	while (cbInput - ibRead >= 8) {
+		memcpy(rgWords, pbInput + ibRead, 8);
+		cBits += __builtin_popcountll(rgWords[0]);
+		ibRead += 8;
+	}
+
+	*pcBits += cBits;
+	return ibRead;
+}
+
+/* Counts bits in each 64-bit lane using nibble lookups */
+static BS_TARGET("avx2") __m256i
+popcount_avx2_lanes(__m256i v)
+{
+	const __m256i vLookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+	);
+	const __m256i vNibble = _mm256_set1_epi8(0x0F);
+	__m256i vCounts;
+
+	vCounts = _mm256_add_epi8(
+		_mm256_shuffle_epi8(vLookup, _mm256_and_si256(v, vNibble)),
+		_mm256_shuffle_epi8(
+			vLookup,
+			_mm256_and_si256(_mm256_srli_epi16(v, 4), vNibble)
+		)
+	);
+
+	return _mm256_sad_epu8(vCounts, _mm256_setzero_si256());
+}
+
+/* Carry-save adder: adds three bit vectors into HIGH and LOW bits */
+#define CSA_AVX2(high, low, a, b, c) { \
+	__m256i vXor = _mm256_xor_si256((a), (b)); \
+	(high) = _mm256_or_si256( \
+		_mm256_and_si256((a), (b)), \
+		_mm256_and_si256(vXor, (c)) \
+	); \
+	(low) = _mm256_xor_si256(vXor, (c)); \
+}
+
+#define LOAD_AVX2(iVector) \
+	_mm256_loadu_si256((const __m256i *) (pbInput + ibRead) + (iVector))
+
+/*
+ * Harley-Seal: sixteen vectors at a time are summed through a tree of
+ * carry-save adders, so that only one vector in sixteen needs counting.
+ */
+static BS_TARGET("avx2") size_t
+popcount_avx2(const BSbyte *pbInput, size_t cbInput, uint64_t *pcBits)
+{
+	__m256i vTotal = _mm256_setzero_si256();
+	__m256i vOnes = _mm256_setzero_si256();
+	__m256i vTwos = _mm256_setzero_si256();
+	__m256i vFours = _mm256_setzero_si256();
+	__m256i vEights = _mm256_setzero_si256();
+	__m256i vSixteens, vTwosA, vTwosB, vFoursA, vFoursB, vEightsA, vEightsB;
+	uint64_t rgLanes[4];
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 16 * 32) {
+		CSA_AVX2(vTwosA, vOnes, vOnes, LOAD_AVX2(0), LOAD_AVX2(1))
+		CSA_AVX2(vTwosB, vOnes, vOnes, LOAD_AVX2(2), LOAD_AVX2(3))
+		CSA_AVX2(vFoursA, vTwos, vTwos, vTwosA, vTwosB)
+		CSA_AVX2(vTwosA, vOnes, vOnes, LOAD_AVX2(4), LOAD_AVX2(5))
+		CSA_AVX2(vTwosB, vOnes, vOnes, LOAD_AVX2(6), LOAD_AVX2(7))
+		CSA_AVX2(vFoursB, vTwos, vTwos, vTwosA, vTwosB)
+		CSA_AVX2(vEightsA, vFours, vFours, vFoursA, vFoursB)
+		CSA_AVX2(vTwosA, vOnes, vOnes, LOAD_AVX2(8), LOAD_AVX2(9))
+		CSA_AVX2(vTwosB, vOnes, vOnes, LOAD_AVX2(10), LOAD_AVX2(11))
+		CSA_AVX2(vFoursA, vTwos, vTwos, vTwosA, vTwosB)
+		CSA_AVX2(vTwosA, vOnes, vOnes, LOAD_AVX2(12), LOAD_AVX2(13))
+		CSA_AVX2(vTwosB, vOnes, vOnes, LOAD_AVX2(14), LOAD_AVX2(15))
+		CSA_AVX2(vFoursB, vTwos, vTwos, vTwosA, vTwosB)
+		CSA_AVX2(vEightsB, vFours, vFours, vFoursA, vFoursB)
+		CSA_AVX2(vSixteens, vEights, vEights, vEightsA, vEightsB)
+
+		vTotal = _mm256_add_epi64(vTotal, popcount_avx2_lanes(vSixteens));
+		ibRead += 16 * 32;
+	}
+
+	/* Weight the leftover partial sums by their place values */
+	vTotal = _mm256_slli_epi64(vTotal, 4);
+	vTotal = _mm256_add_epi64(
+		vTotal,
+		_mm256_slli_epi64(popcount_avx2_lanes(vEights), 3)
+	);
+	vTotal = _mm256_add_epi64(
+		vTotal,
+		_mm256_slli_epi64(popcount_avx2_lanes(vFours), 2)
+	);
+	vTotal = _mm256_add_epi64(
+		vTotal,
+		_mm256_slli_epi64(popcount_avx2_lanes(vTwos), 1)
+	);
+	vTotal = _mm256_add_epi64(vTotal, popcount_avx2_lanes(vOnes));
+
+	_mm256_storeu_si256((__m256i *) rgLanes, vTotal);
+	*pcBits += rgLanes[0] + rgLanes[1] + rgLanes[2] + rgLanes[3];
+	return ibRead;
+}
+
+#undef LOAD_AVX2
+#undef CSA_AVX2
+
+static BS_TARGET("avx512f,avx512vpopcntdq") size_t
+popcount_avx512(const BSbyte *pbInput, size_t cbInput, uint64_t *pcBits)
+{
+	__m512i vTotalA = _mm512_setzero_si512();
+	__m512i vTotalB = _mm512_setzero_si512();
+	size_t ibRead = 0;
+
+	/* Two accumulators keep the adds from serialising */
+	while (cbInput - ibRead >= 4 * 64) {
+		vTotalA = _mm512_add_epi64(vTotalA, _mm512_popcnt_epi64(
+			_mm512_loadu_si512(pbInput + ibRead)
+		));
+		vTotalB = _mm512_add_epi64(vTotalB, _mm512_popcnt_epi64(
+			_mm512_loadu_si512(pbInput + ibRead + 64)
+		));
+		vTotalA = _mm512_add_epi64(vTotalA, _mm512_popcnt_epi64(
+			_mm512_loadu_si512(pbInput + ibRead + 128)
+		));
+		vTotalB = _mm512_add_epi64(vTotalB, _mm512_popcnt_epi64(
+			_mm512_loadu_si512(pbInput + ibRead + 192)
+		));
+		ibRead += 4 * 64;
+	}
+	while (cbInput - ibRead >= 64) {
+		vTotalA = _mm512_add_epi64(vTotalA, _mm512_popcnt_epi64(
+			_mm512_loadu_si512(pbInput + ibRead)
+		));
+		ibRead += 64;
+	}
+
+	*pcBits += (uint64_t) _mm512_reduce_add_epi64(
+		_mm512_add_epi64(vTotalA, vTotalB)
+	);
+	return ibRead;
+}
+
+#endif /* BS_SIMD_X86 */
+
+uint64_t
+bs_popcount_bytes(const BSbyte *pbInput, size_t cbInput)
+{
+	size_t ibRead = 0;
+	uint64_t cBits = 0;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+
+	if (grfFeatures & BS_CPU_AVX512VPOPCNTDQ) {
+		ibRead = popcount_avx512(pbInput, cbInput, &cBits);
+	} else if (grfFeatures & BS_CPU_AVX2) {
+		ibRead = popcount_avx2(pbInput, cbInput, &cBits);
+	}
+	if (grfFeatures & BS_CPU_POPCNT) {
+		ibRead += popcount_words_popcnt(
+			pbInput + ibRead,
+			cbInput - ibRead,
+			&cBits
+		);
+	}
+#endif
+
+	ibRead += popcount_words(pbInput + ibRead, cbInput - ibRead, &cBits);
+
+	while (ibRead < cbInput) {
+		cBits += popcount_word(pbInput[ibRead]);
+		ibRead++;
+	}
+
+	return cBits;
+}
+
+/*
+ * Byte sum kernels
+ * Each works through whole vectors only, returning the number of bytes read
+ * and adding the sum of those bytes to *PSUM. The weighted kernels also add
+ * the weighted sum of the bytes read, taken as a stream on its own, to
+ * *PWEIGHTED.
+ */
+
+#ifdef BS_SIMD_X86
+
+static BS_TARGET("sse2") size_t
+sum_sse2(const BSbyte *pbInput, size_t cbInput, uint64_t *pSum)
+{
+	const __m128i vZero = _mm_setzero_si128();
+	__m128i vSumA = _mm_setzero_si128(), vSumB = _mm_setzero_si128();
+	uint64_t rgLanes[2];
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 32) {
+		vSumA = _mm_add_epi64(vSumA, _mm_sad_epu8(
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead)),
+			vZero
+		));
+		vSumB = _mm_add_epi64(vSumB, _mm_sad_epu8(
+			_mm_loadu_si128((const __m128i *) (pbInput + ibRead + 16)),
+			vZero
+		));
+		ibRead += 32;
+	}
+
+	_mm_storeu_si128((__m128i *) rgLanes, _mm_add_epi64(vSumA, vSumB));
+	*pSum += rgLanes[0] + rgLanes[1];
+	return ibRead;
+}
+
+static BS_TARGET("avx2") size_t
+sum_avx2(const BSbyte *pbInput, size_t cbInput, uint64_t *pSum)
+{
+	const __m256i vZero = _mm256_setzero_si256();
+	__m256i vSumA = _mm256_setzero_si256(), vSumB = _mm256_setzero_si256();
+	uint64_t rgLanes[4];
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 64) {
+		vSumA = _mm256_add_epi64(vSumA, _mm256_sad_epu8(
+			_mm256_loadu_si256((const __m256i *) (pbInput + ibRead)),
+			vZero
+		));
+		vSumB = _mm256_add_epi64(vSumB, _mm256_sad_epu8(
+			_mm256_loadu_si256((const __m256i *) (pbInput + ibRead + 32)),
+			vZero
+		));
+		ibRead += 64;
+	}
+
+	_mm256_storeu_si256((__m256i *) rgLanes, _mm256_add_epi64(vSumA, vSumB));
+	*pSum += rgLanes[0] + rgLanes[1] + rgLanes[2] + rgLanes[3];
+	return ibRead;
+}
+
+/*
+ * Within each 16-byte block, byte J is weighted 16 - J, with the bytes widened
+ * to 16 bits for multiply-adds. The sum of the blocks before each block is
+ * added to a running total, which gives the weight contributed by the blocks
+ * which follow.
+ */
+static BS_TARGET("sse2") size_t
+sum_weighted_sse2(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+)
+{
+	const __m128i vWeightsLow = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+	const __m128i vWeightsHigh = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i vZero = _mm_setzero_si128();
+	__m128i v, vSum = vZero, vRunning = vZero, vBlocks, vBlocksTotal = vZero;
+	uint64_t rgSum[2], rgRunning[2], rgBlocks[2];
+	size_t ibRead = 0, cBlocks;
+
+	while (cbInput - ibRead >= 16) {
+		vBlocks = vZero;
+		for (cBlocks = 0;
+		     (cBlocks < CBLOCKS_WEIGHTED) && (cbInput - ibRead >= 16);
+		     cBlocks++) {
+			v = _mm_loadu_si128((const __m128i *) (pbInput + ibRead));
+			vRunning = _mm_add_epi64(vRunning, vSum);
+			vSum = _mm_add_epi64(vSum, _mm_sad_epu8(v, vZero));
+			vBlocks = _mm_add_epi32(vBlocks, _mm_add_epi32(
+				_mm_madd_epi16(_mm_unpacklo_epi8(v, vZero), vWeightsLow),
+				_mm_madd_epi16(_mm_unpackhi_epi8(v, vZero), vWeightsHigh)
+			));
+			ibRead += 16;
+		}
+
+		vBlocksTotal = _mm_add_epi64(vBlocksTotal, _mm_add_epi64(
+			_mm_unpacklo_epi32(vBlocks, vZero),
+			_mm_unpackhi_epi32(vBlocks, vZero)
+		));
+	}
+
+	_mm_storeu_si128((__m128i *) rgSum, vSum);
+	_mm_storeu_si128((__m128i *) rgRunning, vRunning);
+	_mm_storeu_si128((__m128i *) rgBlocks, vBlocksTotal);
+
+	*pSum += rgSum[0] + rgSum[1];
+	*pWeighted += 16 * (rgRunning[0] + rgRunning[1])
+	            + rgBlocks[0] + rgBlocks[1];
+	return ibRead;
+}
+
+/*
+ * Within each 32-byte block, byte J is weighted 32 - J with multiply-adds. The
+ * sum of the blocks before each block is added to a running total, which gives
+ * the weight contributed by the blocks which follow.
+ */
+static BS_TARGET("avx2") size_t
+sum_weighted_avx2(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+)
+{
+	const __m256i vWeights = _mm256_setr_epi8(
+		32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1
+	);
+	const __m256i vOnes = _mm256_set1_epi16(1);
+	const __m256i vZero = _mm256_setzero_si256();
+	__m256i v, vSum = vZero, vRunning = vZero, vBlocks, vBlocksTotal = vZero;
+	uint64_t rgSum[4], rgRunning[4], rgBlocks[4];
+	size_t ibRead = 0, cBlocks;
+
+	while (cbInput - ibRead >= 32) {
+		vBlocks = vZero;
+		for (cBlocks = 0;
+		     (cBlocks < CBLOCKS_WEIGHTED) && (cbInput - ibRead >= 32);
+		     cBlocks++) {
+			v = _mm256_loadu_si256((const __m256i *) (pbInput + ibRead));
+			vRunning = _mm256_add_epi64(vRunning, vSum);
+			vSum = _mm256_add_epi64(vSum, _mm256_sad_epu8(v, vZero));
+			vBlocks = _mm256_add_epi32(vBlocks, _mm256_madd_epi16(
+				_mm256_maddubs_epi16(v, vWeights),
+				vOnes
+			));
+			ibRead += 32;
+		}
+
+		vBlocksTotal = _mm256_add_epi64(vBlocksTotal, _mm256_add_epi64(
+			_mm256_unpacklo_epi32(vBlocks, vZero),
+			_mm256_unpackhi_epi32(vBlocks, vZero)
+		));
+	}
+
+	_mm256_storeu_si256((__m256i *) rgSum, vSum);
+	_mm256_storeu_si256((__m256i *) rgRunning, vRunning);
+	_mm256_storeu_si256((__m256i *) rgBlocks, vBlocksTotal);
+
+	*pSum += rgSum[0] + rgSum[1] + rgSum[2] + rgSum[3];
+	*pWeighted += 32 * (rgRunning[0] + rgRunning[1] + rgRunning[2] + rgRunning[3])
+	            + rgBlocks[0] + rgBlocks[1] + rgBlocks[2] + rgBlocks[3];
+	return ibRead;
+}
+
+#endif /* BS_SIMD_X86 */
+
+uint64_t
+bs_sum_bytes(const BSbyte *pbInput, size_t cbInput)
+{
+	size_t ibRead = 0;
+	uint64_t cSum = 0;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+
+	if (grfFeatures & BS_CPU_AVX2) {
+		ibRead = sum_avx2(pbInput, cbInput, &cSum);
+	}
+	if (grfFeatures & BS_CPU_SSE2) {
+		ibRead += sum_sse2(pbInput + ibRead, cbInput - ibRead, &cSum);
+	}
+#endif
+
+	while (ibRead < cbInput) {
+		cSum += pbInput[ibRead];
+		ibRead++;
+	}
+
+	return cSum;
+}
+
+void
+bs_sum_weighted_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t *pSum,
+	uint64_t *pWeighted
+)
+{
+	size_t ibRead = 0;
+	uint64_t cSum = 0, cWeighted = 0;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+
+	if (grfFeatures & BS_CPU_AVX2) {
+		ibRead = sum_weighted_avx2(pbInput, cbInput, &cSum, &cWeighted);
+	} else if (grfFeatures & BS_CPU_SSE2) {
+		ibRead = sum_weighted_sse2(pbInput, cbInput, &cSum, &cWeighted);
+	}
+#endif
+
+	/* Each byte adds the running sum again, weighting earlier bytes more */
+	while (ibRead < cbInput) {
+		cSum += pbInput[ibRead];
+		cWeighted += cSum;
+		ibRead++;
+	}
+
+	*pSum = cSum;
+	*pWeighted = cWeighted;
+}
+
+BSresult
+bs_sum64_weighted(const BS *bs, uint64_t *sum, uint64_t *weighted)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(sum)
+	BS_CHECK_POINTER(weighted)
+	BS_ASSERT_VALID(bs)
+
+	bs_sum_weighted_bytes(bs->pbBytes, bs->cbBytes, sum, weighted);
+	return BS_OK;
+}
+
+/*
+ * Population counts and sums are built on the parallel fold, with each range
+ * reduced to a 64-bit total.
+ */
+
+static BSresult
+popcount_range(const BSbyte *block, size_t length, void *value, void *data)
+{
+	UNUSED(data);
+
+	*(uint64_t *) value += bs_popcount_bytes(block, length);
+	return BS_OK;
+}
+
+static BSresult
+sum_range(const BSbyte *block, size_t length, void *value, void *data)
+{
+	UNUSED(data);
+
+	*(uint64_t *) value += bs_sum_bytes(block, length);
+	return BS_OK;
+}
+
+static BSresult
+add_totals(void *value, const void *other, void *data)
+{
+	UNUSED(data);
+
+	*(uint64_t *) value += *(const uint64_t *) other;
+	return BS_OK;
+}
+
+static const uint64_t cZero = 0;
+
+BSresult
+bs_popcount(const BS *bs, uint64_t *count)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(count)
+	BS_ASSERT_VALID(bs)
+
+	*count = bs_popcount_bytes(bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
+
+BSresult
+bs_popcount_parallel(const BS *bs, uint64_t *count, BSpool *pool)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(count)
+
+	return bs_fold_parallel(
+		bs,
+		count,
+		sizeof(uint64_t),
+		&cZero,
+		popcount_range,
+		add_totals,
+		NULL,
+		pool
+	);
+}
+
+BSresult
+bs_sum64(const BS *bs, uint64_t *sum)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(sum)
+	BS_ASSERT_VALID(bs)
+
+	*sum = bs_sum_bytes(bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
+
+BSresult
+bs_sum64_parallel(const BS *bs, uint64_t *sum, BSpool *pool)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(sum)
+
+	return bs_fold_parallel(
+		bs,
+		sum,
+		sizeof(uint64_t),
+		&cZero,
+		sum_range,
+		add_totals,
+		NULL,
+		pool
+	);
 }
@@ -0,0 +1,464 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct BSreduction {
+	const char *szName;
+	size_t cbResult;        /* Size of the value passed back at the end */
+	int fHashstate;         /* Whether the reduction needs a hash state */
+	void (*fpReset) (BSfoldstate *state);
+	BSresult (*fpUpdate) (BSfoldstate *state, const BS *bs);
+	void (*fpFinal) (const BSfoldstate *state, void *result);
+};
+
+struct BSfoldstate {
+	const struct BSreduction *reduction;
+	BShashstate *hashstate;
+	union {
+		uint64_t rgValues[2];
+		uint64_t counts[256];
+		BSstats stats;
+		uint32_t checksum;
+		uint16_t fletcher16;
+		struct {
+			uint32_t checksum;
+			int fPending;       /* Whether the last piece had an odd byte */
+			BSbyte bPending;    /* The odd byte, waiting for its partner */
+		} fletcher32;
+	} value;
+};
+
+/*
+ * Reductions
+ * Each keeps its running value in the state's union, and starts from the
+ * value for an empty stream.
+ */
+
+static void
+reset_zero(BSfoldstate *state)
+{
+	memset(&state->value, 0, sizeof(state->value));
+}
+
+static void
+reset_one(BSfoldstate *state)
+{
+	reset_zero(state);
+	state->value.checksum = 1;
+}
+
+static void
+reset_stats(BSfoldstate *state)
+{
+	reset_zero(state);
+	state->value.stats.min = 255;
+	state->value.stats.max = 0;
+}
+
+static void
+reset_hash(BSfoldstate *state)
+{
+	bs_hashstate_reset(state->hashstate, 0);
+}
+
+static BSresult
+update_sum(BSfoldstate *state, const BS *bs)
+{
+	state->value.rgValues[0] += bs_sum_bytes(bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
+
+static BSresult
+update_popcount(BSfoldstate *state, const BS *bs)
+{
+	state->value.rgValues[0] += bs_popcount_bytes(bs->pbBytes, bs->cbBytes);
+	return BS_OK;
+}
+
+/* Earlier bytes are all a piece's length further from the end than before */
+static BSresult
+update_weighted(BSfoldstate *state, const BS *bs)
+{
+	uint64_t *rgValues = state->value.rgValues, cSum, cWeighted;
+
+	bs_sum_weighted_bytes(bs->pbBytes, bs->cbBytes, &cSum, &cWeighted);
+	rgValues[1] += bs->cbBytes * rgValues[0] + cWeighted;
+	rgValues[0] += cSum;
+	return BS_OK;
+}
+
+static BSresult
+update_histogram(BSfoldstate *state, const BS *bs)
+{
+	bs_histogram_bytes(bs->pbBytes, bs->cbBytes, state->value.counts);
+	return BS_OK;
+}
+
+static BSresult
+update_stats(BSfoldstate *state, const BS *bs)
+{
+	BSstats *stats = &state->value.stats;
+	BSstats piece;
+	size_t iCount;
+
+	bs_stats(bs, BS_STAT_ALL, &piece);
+	stats->sum += piece.sum;
+	stats->popcount += piece.popcount;
+	if (piece.min < stats->min) {
+		stats->min = piece.min;
+	}
+	if (piece.max > stats->max) {
+		stats->max = piece.max;
+	}
+	for (iCount = 0; iCount < 256; iCount++) {
+		stats->counts[iCount] += piece.counts[iCount];
+	}
+	return BS_OK;
+}
+
+static BSresult
+update_crc32(BSfoldstate *state, const BS *bs)
+{
+	return bs_crc32_update(bs, &state->value.checksum);
+}
+
+static BSresult
+update_crc32c(BSfoldstate *state, const BS *bs)
+{
+	return bs_crc32c_update(bs, &state->value.checksum);
+}
+
+static BSresult
+update_adler32(BSfoldstate *state, const BS *bs)
+{
+	return bs_adler32_update(bs, &state->value.checksum);
+}
+
+static BSresult
+update_fletcher16(BSfoldstate *state, const BS *bs)
+{
+	return bs_fletcher16_update(bs, &state->value.fletcher16);
+}
+
+/*
+ * Fletcher-32 sums 16-bit words, which may be split between pieces. An odd
+ * byte at the end of a piece is held back until the next byte arrives, and
+ * only padded if the message ends there.
+ */
+static BSresult
+update_fletcher32(BSfoldstate *state, const BS *bs)
+{
+	const BSbyte *pbInput = bs->pbBytes;
+	size_t cbInput = bs->cbBytes;
+	BSbyte rgbWord[2];
+
+	if (cbInput == 0) {
+		return BS_OK;
+	}
+
+	if (state->value.fletcher32.fPending) {
+		rgbWord[0] = state->value.fletcher32.bPending;
+		rgbWord[1] = pbInput[0];
+		state->value.fletcher32.checksum = bs_fletcher32_bytes(
+			state->value.fletcher32.checksum,
+			rgbWord,
+			2
+		);
+		state->value.fletcher32.fPending = 0;
+		pbInput++;
+		cbInput--;
+	}
+
+	if (cbInput % 2 == 1) {
+		state->value.fletcher32.bPending = pbInput[cbInput - 1];
+		state->value.fletcher32.fPending = 1;
+		cbInput--;
+	}
+
+	state->value.fletcher32.checksum = bs_fletcher32_bytes(
+		state->value.fletcher32.checksum,
+		pbInput,
+		cbInput
+	);
+	return BS_OK;
+}
+
+static BSresult
+update_hash(BSfoldstate *state, const BS *bs)
+{
+	return bs_hashstate_update(state->hashstate, bs);
+}
+
+/* Most running values are already the final value */
+static void
+final_value(const BSfoldstate *state, void *result)
+{
+	memcpy(result, &state->value, state->reduction->cbResult);
+}
+
+static void
+final_fletcher32(const BSfoldstate *state, void *result)
+{
+	uint32_t checksum = state->value.fletcher32.checksum;
+
+	if (state->value.fletcher32.fPending) {
+		checksum = bs_fletcher32_bytes(
+			checksum,
+			&state->value.fletcher32.bPending,
+			1
+		);
+	}
+
+	memcpy(result, &checksum, sizeof(checksum));
+}
+
+static void
+final_xxh3_64(const BSfoldstate *state, void *result)
+{
+	uint64_t hash;
+
+	bs_hashstate_digest64(state->hashstate, &hash);
+	memcpy(result, &hash, sizeof(hash));
+}
+
+static void
+final_xxh3_128(const BSfoldstate *state, void *result)
+{
+	BShash128 hash;
+
+	bs_hashstate_digest128(state->hashstate, &hash);
+	memcpy(result, &hash, sizeof(hash));
+}
+
+static const struct BSreduction rgReductions[] = {
+	{
+		"sum",
+		sizeof(uint64_t),
+		0,
+		reset_zero,
+		update_sum,
+		final_value
+	},
+	{
+		"popcount",
+		sizeof(uint64_t),
+		0,
+		reset_zero,
+		update_popcount,
+		final_value
+	},
+	{
+		"weighted",
+		2 * sizeof(uint64_t),
+		0,
+		reset_zero,
+		update_weighted,
+		final_value
+	},
+	{
+		"histogram",
+		256 * sizeof(uint64_t),
+		0,
+		reset_zero,
+		update_histogram,
+		final_value
+	},
+	{
+		"stats",
+		sizeof(BSstats),
+		0,
+		reset_stats,
+		update_stats,
+		final_value
+	},
+	{
+		"crc32",
+		sizeof(uint32_t),
+		0,
+		reset_zero,
+		update_crc32,
+		final_value
+	},
+	{
+		"crc32c",
+		sizeof(uint32_t),
+		0,
+		reset_zero,
+		update_crc32c,
+		final_value
+	},
+	{
+		"adler32",
+		sizeof(uint32_t),
+		0,
+		reset_one,
+		update_adler32,
+		final_value
+	},
+	{
+		"fletcher16",
+		sizeof(uint16_t),
+		0,
+		reset_zero,
+		update_fletcher16,
+		final_value
+	},
+	{
+		"fletcher32",
+		sizeof(uint32_t),
+		0,
+		reset_zero,
+		update_fletcher32,
+		final_fletcher32
+	},
+	{
+		"xxh3-64",
+		sizeof(uint64_t),
+		1,
+		reset_hash,
+		update_hash,
+		final_xxh3_64
+	},
+	{
+		"xxh3-128",
+		sizeof(BShash128),
+		1,
+		reset_hash,
+		update_hash,
+		final_xxh3_128
+	},
+	{ NULL, 0, 0, NULL, NULL, NULL }
+};
+
+static const struct BSreduction *
+find_reduction(const char *reduction)
+{
+	size_t iReduction = 0;
+
+	while (rgReductions[iReduction].szName != NULL) {
+		if (strcmp(reduction, rgReductions[iReduction].szName) == 0) {
+			return &rgReductions[iReduction];
+		}
+		iReduction++;
+	}
+
+	return NULL;
+}
+
+BSfoldstate *
+bs_foldstate_create(const char *reduction)
+{
+	const struct BSreduction *pReduction;
+	BSfoldstate *state;
+
+	if (reduction == NULL) {
+		return NULL;
+	}
+
+	pReduction = find_reduction(reduction);
+	if (pReduction == NULL) {
+		return NULL;
+	}
+
+	state = malloc(sizeof(*state));
+	if (state == NULL) {
+		return NULL;
+	}
+
+	state->reduction = pReduction;
+	state->hashstate = NULL;
+	if (pReduction->fHashstate) {
+		state->hashstate = bs_hashstate_create(0);
+		if (state->hashstate == NULL) {
+			free(state);
+			return NULL;
+		}
+	}
+
+	bs_foldstate_reset(state);
+	return state;
+}
+
+void
+bs_foldstate_free(BSfoldstate *state)
+{
+	if (state != NULL) {
+		bs_hashstate_free(state->hashstate);
+		free(state);
+	}
+}
+
+void
+bs_foldstate_reset(BSfoldstate *state)
+{
+	if (state != NULL) {
+		state->reduction->fpReset(state);
+	}
+}
+
+BSresult
+bs_foldstate_update(BSfoldstate *state, const BS *bs)
+{
+	BS_CHECK_POINTER(state)
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+
+	return state->reduction->fpUpdate(state, bs);
+}
+
+BSresult
+bs_foldstate_operation(const BS *bs, void *data)
+{
+	return bs_foldstate_update((BSfoldstate *) data, bs);
+}
+
+BSresult
+bs_foldstate_size(const BSfoldstate *state, size_t *size)
+{
+	BS_CHECK_POINTER(state)
+	BS_CHECK_POINTER(size)
+
+	*size = state->reduction->cbResult;
+	return BS_OK;
+}
+
+BSresult
+bs_foldstate_final(const BSfoldstate *state, void *result, size_t size)
+{
+	BS_CHECK_POINTER(state)
+	BS_CHECK_POINTER(result)
+
+	if (size < state->reduction->cbResult) {
+		return BS_SHORT_BUFFER;
+	}
+
+	state->reduction->fpFinal(state, result);
+	return BS_OK;
+}
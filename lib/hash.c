@@ -0,0 +1,1141 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include "cpu.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Hashes are XXH3 (from xxHash 0.8), so they match other implementations.
+ * Short inputs are mixed a few words at a time. Long inputs are split into
+ * 64-byte stripes, each keyed with a sliding window onto a secret and added
+ * into eight 64-bit accumulators using only 32x32-bit multiplies, which vector
+ * units can do; the accumulators are scrambled after every block of stripes.
+ */
+
+/* 64-bit constants are built from halves, which C89 can write */
+#define U64(high, low) (((uint64_t) (high) << 32) | (uint64_t) (low))
+
+#define PRIME32_1 0x9E3779B1
+#define PRIME32_2 0x85EBCA77
+#define PRIME32_3 0xC2B2AE3D
+#define PRIME64_1 U64(0x9E3779B1, 0x85EBCA87)
+#define PRIME64_2 U64(0xC2B2AE3D, 0x27D4EB4F)
+#define PRIME64_3 U64(0x165667B1, 0x9E3779F9)
+#define PRIME64_4 U64(0x85EBCA77, 0xC2B2AE63)
+#define PRIME64_5 U64(0x27D4EB2F, 0x165667C5)
+#define PRIME_MX1 U64(0x16566791, 0x9E3779F9)
+#define PRIME_MX2 U64(0x9FB21C65, 0x1E98DF25)
+
+#define CB_STRIPE           64
+#define CB_SECRET           192
+#define CB_SECRET_MIN       136  /* Length of secret used for mid-sized input */
+#define C_STRIPES_PER_BLOCK ((CB_SECRET - CB_STRIPE) / 8)
+#define CB_BLOCK            (CB_STRIPE * C_STRIPES_PER_BLOCK)
+#define CB_MIDSIZE_MAX      240
+#define CB_BUFFER           256
+
+/* Secret offsets for the final stripe, and for merging the accumulators */
+#define IB_SECRET_LAST_STRIPE (CB_SECRET - CB_STRIPE - 7)
+#define IB_SECRET_MERGE       11
+
+static const BSbyte rgbDefaultSecret[CB_SECRET] = {
+	0xB8, 0xFE, 0x6C, 0x39, 0x23, 0xA4, 0x4B, 0xBE,
+	0x7C, 0x01, 0x81, 0x2C, 0xF7, 0x21, 0xAD, 0x1C,
+	0xDE, 0xD4, 0x6D, 0xE9, 0x83, 0x90, 0x97, 0xDB,
+	0x72, 0x40, 0xA4, 0xA4, 0xB7, 0xB3, 0x67, 0x1F,
+	0xCB, 0x79, 0xE6, 0x4E, 0xCC, 0xC0, 0xE5, 0x78,
+	0x82, 0x5A, 0xD0, 0x7D, 0xCC, 0xFF, 0x72, 0x21,
+	0xB8, 0x08, 0x46, 0x74, 0xF7, 0x43, 0x24, 0x8E,
+	0xE0, 0x35, 0x90, 0xE6, 0x81, 0x3A, 0x26, 0x4C,
+	0x3C, 0x28, 0x52, 0xBB, 0x91, 0xC3, 0x00, 0xCB,
+	0x88, 0xD0, 0x65, 0x8B, 0x1B, 0x53, 0x2E, 0xA3,
+	0x71, 0x64, 0x48, 0x97, 0xA2, 0x0D, 0xF9, 0x4E,
+	0x38, 0x19, 0xEF, 0x46, 0xA9, 0xDE, 0xAC, 0xD8,
+	0xA8, 0xFA, 0x76, 0x3F, 0xE3, 0x9C, 0x34, 0x3F,
+	0xF9, 0xDC, 0xBB, 0xC7, 0xC7, 0x0B, 0x4F, 0x1D,
+	0x8A, 0x51, 0xE0, 0x4B, 0xCD, 0xB4, 0x59, 0x31,
+	0xC8, 0x9F, 0x7E, 0xC9, 0xD9, 0x78, 0x73, 0x64,
+	0xEA, 0xC5, 0xAC, 0x83, 0x34, 0xD3, 0xEB, 0xC3,
+	0xC5, 0x81, 0xA0, 0xFF, 0xFA, 0x13, 0x63, 0xEB,
+	0x17, 0x0D, 0xDD, 0x51, 0xB7, 0xF0, 0xDA, 0x49,
+	0xD3, 0x16, 0x55, 0x26, 0x29, 0xD4, 0x68, 0x9E,
+	0x2B, 0x16, 0xBE, 0x58, 0x7D, 0x47, 0xA1, 0xFC,
+	0x8F, 0xF8, 0xB8, 0xD1, 0x7A, 0xD0, 0x31, 0xCE,
+	0x45, 0xCB, 0x3A, 0x8F, 0x95, 0x16, 0x04, 0x28,
+	0xAF, 0xD7, 0xFB, 0xCA, 0xBB, 0x4B, 0x40, 0x7E
+};
+
+struct BShashstate {
+	uint64_t rgAcc[8];             /* Accumulators */
+	BSbyte rgbSecret[CB_SECRET];   /* Secret, derived from the seed */
+	BSbyte rgbBuffer[CB_BUFFER];   /* Input not yet accumulated */
+	size_t cbBuffered;             /* Count of bytes in the buffer */
+	size_t cStripes;               /* Stripes done in the current block */
+	uint64_t cbTotal;              /* Count of bytes hashed */
+	uint64_t seed;                 /* Seed */
+};
+
+/*
+ * Arithmetic helpers
+ */
+
+/*
+ * Words are little-endian. Where the processor is too, they're copied straight
+ * out, which the compiler can turn into a single load.
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+static uint32_t
+read32(const BSbyte *pb)
+{
+	uint32_t value;
+
+	memcpy(&value, pb, 4);
+	return value;
+}
+
+static uint64_t
+read64(const BSbyte *pb)
+{
+	uint64_t value;
+
+	memcpy(&value, pb, 8);
+	return value;
+}
+
+#else
+
+static uint32_t
+read32(const BSbyte *pb)
+{
+	return (uint32_t) pb[0]       | (uint32_t) pb[1] <<  8
+	     | (uint32_t) pb[2] << 16 | (uint32_t) pb[3] << 24;
+}
+
+static uint64_t
+read64(const BSbyte *pb)
+{
+	return (uint64_t) read32(pb) | (uint64_t) read32(pb + 4) << 32;
+}
+
+#endif
+
+static void
+write64(BSbyte *pb, uint64_t value)
+{
+	unsigned int ib;
+
+	for (ib = 0; ib < 8; ib++) {
+		pb[ib] = (BSbyte) (value >> (8 * ib));
+	}
+}
+
+static uint32_t
+swap32(uint32_t value)
+{
+	return (value << 24) | ((value << 8) & 0x00FF0000)
+	     | ((value >> 8) & 0x0000FF00) | (value >> 24);
+}
+
+static uint64_t
+swap64(uint64_t value)
+{
+	return (uint64_t) swap32((uint32_t) value) << 32
+	     | swap32((uint32_t) (value >> 32));
+}
+
+static uint64_t
+rotl64(uint64_t value, unsigned int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+/* Multiplies out to 128 bits, passing back the high half */
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+
+__extension__ typedef unsigned __int128 uint128;
+
+static uint64_t
+mul128(uint64_t a, uint64_t b, uint64_t *pHigh)
+{
+	uint128 product = (uint128) a * b;
+
+	*pHigh = (uint64_t) (product >> 64);
+	return (uint64_t) product;
+}
+
+#else
+
+static uint64_t
+mul128(uint64_t a, uint64_t b, uint64_t *pHigh)
+{
+	uint64_t lowLow = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+	uint64_t highLow = (a >> 32) * (b & 0xFFFFFFFF);
+	uint64_t lowHigh = (a & 0xFFFFFFFF) * (b >> 32);
+	uint64_t highHigh = (a >> 32) * (b >> 32);
+	uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+
+	*pHigh = (highLow >> 32) + (cross >> 32) + highHigh;
+	return (cross << 32) | (lowLow & 0xFFFFFFFF);
+}
+
+#endif
+
+static uint64_t
+mul128_fold64(uint64_t a, uint64_t b)
+{
+	uint64_t high, low = mul128(a, b, &high);
+
+	return low ^ high;
+}
+
+static uint64_t
+avalanche_xxh64(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+static uint64_t
+avalanche(uint64_t hash)
+{
+	hash ^= hash >> 37;
+	hash *= PRIME_MX1;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+static uint64_t
+rrmxmx(uint64_t hash, uint64_t length)
+{
+	hash ^= rotl64(hash, 49) ^ rotl64(hash, 24);
+	hash *= PRIME_MX2;
+	hash ^= (hash >> 35) + length;
+	hash *= PRIME_MX2;
+	hash ^= hash >> 28;
+	return hash;
+}
+
+static uint64_t
+mix16(const BSbyte *pbInput, const BSbyte *pbSecret, uint64_t seed)
+{
+	return mul128_fold64(
+		read64(pbInput) ^ (read64(pbSecret) + seed),
+		read64(pbInput + 8) ^ (read64(pbSecret + 8) - seed)
+	);
+}
+
+static void
+mix32(
+	uint64_t rgAcc[2],
+	const BSbyte *pbInput1,
+	const BSbyte *pbInput2,
+	const BSbyte *pbSecret,
+	uint64_t seed
+)
+{
+	rgAcc[0] += mix16(pbInput1, pbSecret, seed);
+	rgAcc[0] ^= read64(pbInput2) + read64(pbInput2 + 8);
+	rgAcc[1] += mix16(pbInput2, pbSecret + 16, seed);
+	rgAcc[1] ^= read64(pbInput1) + read64(pbInput1 + 8);
+}
+
+/*
+ * Stripe kernels
+ * Accumulating takes in CSTRIPES stripes, moving along the secret by eight
+ * bytes for each. Scrambling mixes the accumulators with the secret.
+ */
+
+static void
+accumulate_scalar(
+	uint64_t rgAcc[8],
+	const BSbyte *pbInput,
+	const BSbyte *pbSecret,
+	size_t cStripes
+)
+{
+	uint64_t data, key;
+	size_t iStripe;
+	unsigned int iLane;
+
+	for (iStripe = 0; iStripe < cStripes; iStripe++) {
+		for (iLane = 0; iLane < 8; iLane++) {
+			data = read64(pbInput + 8 * iLane);
+			key = data ^ read64(pbSecret + 8 * iLane);
+			rgAcc[iLane ^ 1] += data;
+			rgAcc[iLane] += (key & 0xFFFFFFFF) * (key >> 32);
+		}
+		pbInput += CB_STRIPE;
+		pbSecret += 8;
+	}
+}
+
+static void
+scramble_scalar(uint64_t rgAcc[8], const BSbyte *pbSecret)
+{
+	unsigned int iLane;
+
+	for (iLane = 0; iLane < 8; iLane++) {
+		rgAcc[iLane] ^= rgAcc[iLane] >> 47;
+		rgAcc[iLane] ^= read64(pbSecret + 8 * iLane);
+		rgAcc[iLane] *= PRIME32_1;
+	}
+}
+
+#ifdef BS_SIMD_X86
+
+/*
+ * Each lane adds the product of the halves of its keyed data, plus the data
+ * from its neighbour (swapping the 64-bit halves of each 128-bit lane).
+ */
+#define ACCUMULATE(vAcc, vData, vKey, mul_epu32, srli_epi64, shuffle_epi32, \
+		add_epi64) \
+	vAcc = add_epi64(vAcc, add_epi64( \
+		mul_epu32(vKey, srli_epi64(vKey, 32)), \
+		shuffle_epi32(vData, _MM_SHUFFLE(1, 0, 3, 2)) \
+	))
+
+/* The 32-bit prime is multiplied into each half of each lane separately */
+#define SCRAMBLE(vAcc, vKey, vPrime, mul_epu32, srli_epi64, slli_epi64, \
+		xor_si, add_epi64) \
+	vAcc = xor_si(xor_si(vAcc, srli_epi64(vAcc, 47)), vKey); \
+	vAcc = add_epi64( \
+		mul_epu32(vAcc, vPrime), \
+		slli_epi64(mul_epu32(srli_epi64(vAcc, 32), vPrime), 32) \
+	)
+
+#define ACCUMULATE_SSE2(vAcc, ib) \
+	vData = _mm_loadu_si128((const __m128i *) (pbInput + (ib))); \
+	vKey = _mm_xor_si128( \
+		vData, \
+		_mm_loadu_si128((const __m128i *) (pbSecret + (ib))) \
+	); \
+	ACCUMULATE(vAcc, vData, vKey, _mm_mul_epu32, _mm_srli_epi64, \
+		_mm_shuffle_epi32, _mm_add_epi64)
+
+static BS_TARGET("sse2") void
+accumulate_sse2(
+	uint64_t rgAcc[8],
+	const BSbyte *pbInput,
+	const BSbyte *pbSecret,
+	size_t cStripes
+)
+{
+	__m128i vAcc0 = _mm_loadu_si128((const __m128i *) rgAcc);
+	__m128i vAcc1 = _mm_loadu_si128((const __m128i *) (rgAcc + 2));
+	__m128i vAcc2 = _mm_loadu_si128((const __m128i *) (rgAcc + 4));
+	__m128i vAcc3 = _mm_loadu_si128((const __m128i *) (rgAcc + 6));
+	__m128i vData, vKey;
+	size_t iStripe;
+
+	for (iStripe = 0; iStripe < cStripes; iStripe++) {
+		ACCUMULATE_SSE2(vAcc0, 0);
+		ACCUMULATE_SSE2(vAcc1, 16);
+		ACCUMULATE_SSE2(vAcc2, 32);
+		ACCUMULATE_SSE2(vAcc3, 48);
+		pbInput += CB_STRIPE;
+		pbSecret += 8;
+	}
+
+	_mm_storeu_si128((__m128i *) rgAcc, vAcc0);
+	_mm_storeu_si128((__m128i *) (rgAcc + 2), vAcc1);
+	_mm_storeu_si128((__m128i *) (rgAcc + 4), vAcc2);
+	_mm_storeu_si128((__m128i *) (rgAcc + 6), vAcc3);
+}
+
+static BS_TARGET("sse2") void
+scramble_sse2(uint64_t rgAcc[8], const BSbyte *pbSecret)
+{
+	const __m128i vPrime = _mm_set1_epi32((int) PRIME32_1);
+	__m128i vAcc, vKey;
+	unsigned int iVector;
+
+	for (iVector = 0; iVector < 4; iVector++) {
+		vAcc = _mm_loadu_si128((const __m128i *) (rgAcc + 2 * iVector));
+		vKey = _mm_loadu_si128((const __m128i *) (pbSecret + 16 * iVector));
+		SCRAMBLE(vAcc, vKey, vPrime, _mm_mul_epu32, _mm_srli_epi64,
+			_mm_slli_epi64, _mm_xor_si128, _mm_add_epi64);
+		_mm_storeu_si128((__m128i *) (rgAcc + 2 * iVector), vAcc);
+	}
+}
+
+#define ACCUMULATE_AVX2(vAcc, ib) \
+	vData = _mm256_loadu_si256((const __m256i *) (pbInput + (ib))); \
+	vKey = _mm256_xor_si256( \
+		vData, \
+		_mm256_loadu_si256((const __m256i *) (pbSecret + (ib))) \
+	); \
+	ACCUMULATE(vAcc, vData, vKey, _mm256_mul_epu32, _mm256_srli_epi64, \
+		_mm256_shuffle_epi32, _mm256_add_epi64)
+
+static BS_TARGET("avx2") void
+accumulate_avx2(
+	uint64_t rgAcc[8],
+	const BSbyte *pbInput,
+	const BSbyte *pbSecret,
+	size_t cStripes
+)
+{
+	__m256i vAcc0 = _mm256_loadu_si256((const __m256i *) rgAcc);
+	__m256i vAcc1 = _mm256_loadu_si256((const __m256i *) (rgAcc + 4));
+	__m256i vData, vKey;
+	size_t iStripe;
+
+	for (iStripe = 0; iStripe < cStripes; iStripe++) {
+		ACCUMULATE_AVX2(vAcc0, 0);
+		ACCUMULATE_AVX2(vAcc1, 32);
+		pbInput += CB_STRIPE;
+		pbSecret += 8;
+	}
+
+	_mm256_storeu_si256((__m256i *) rgAcc, vAcc0);
+	_mm256_storeu_si256((__m256i *) (rgAcc + 4), vAcc1);
+}
+
+static BS_TARGET("avx2") void
+scramble_avx2(uint64_t rgAcc[8], const BSbyte *pbSecret)
+{
+	const __m256i vPrime = _mm256_set1_epi32((int) PRIME32_1);
+	__m256i vAcc, vKey;
+	unsigned int iVector;
+
+	for (iVector = 0; iVector < 2; iVector++) {
+		vAcc = _mm256_loadu_si256((const __m256i *) (rgAcc + 4 * iVector));
+		vKey = _mm256_loadu_si256((const __m256i *) (pbSecret + 32 * iVector));
+		SCRAMBLE(vAcc, vKey, vPrime, _mm256_mul_epu32, _mm256_srli_epi64,
+			_mm256_slli_epi64, _mm256_xor_si256, _mm256_add_epi64);
+		_mm256_storeu_si256((__m256i *) (rgAcc + 4 * iVector), vAcc);
+	}
+}
+
+#undef ACCUMULATE_AVX2
+#undef ACCUMULATE_SSE2
+#undef SCRAMBLE
+#undef ACCUMULATE
+
+#endif /* BS_SIMD_X86 */
+
+/*
+ * The kernels are chosen from GRFFEATURES, which callers look up once rather
+ * than for every block.
+ */
+static void
+accumulate(
+	unsigned int grfFeatures,
+	uint64_t rgAcc[8],
+	const BSbyte *pbInput,
+	const BSbyte *pbSecret,
+	size_t cStripes
+)
+{
+#ifdef BS_SIMD_X86
+	if (grfFeatures & BS_CPU_AVX2) {
+		accumulate_avx2(rgAcc, pbInput, pbSecret, cStripes);
+		return;
+	}
+	if (grfFeatures & BS_CPU_SSE2) {
+		accumulate_sse2(rgAcc, pbInput, pbSecret, cStripes);
+		return;
+	}
+#else
+	UNUSED(grfFeatures);
+#endif
+
+	accumulate_scalar(rgAcc, pbInput, pbSecret, cStripes);
+}
+
+static void
+scramble(unsigned int grfFeatures, uint64_t rgAcc[8], const BSbyte *pbSecret)
+{
+#ifdef BS_SIMD_X86
+	if (grfFeatures & BS_CPU_AVX2) {
+		scramble_avx2(rgAcc, pbSecret);
+		return;
+	}
+	if (grfFeatures & BS_CPU_SSE2) {
+		scramble_sse2(rgAcc, pbSecret);
+		return;
+	}
+#else
+	UNUSED(grfFeatures);
+#endif
+
+	scramble_scalar(rgAcc, pbSecret);
+}
+
+/*
+ * Long inputs
+ */
+
+static void
+init_accumulators(uint64_t rgAcc[8])
+{
+	rgAcc[0] = PRIME32_3;
+	rgAcc[1] = PRIME64_1;
+	rgAcc[2] = PRIME64_2;
+	rgAcc[3] = PRIME64_3;
+	rgAcc[4] = PRIME64_4;
+	rgAcc[5] = PRIME32_2;
+	rgAcc[6] = PRIME64_5;
+	rgAcc[7] = PRIME32_1;
+}
+
+/* Secrets for other seeds are offset from the default */
+static void
+derive_secret(BSbyte rgbSecret[CB_SECRET], uint64_t seed)
+{
+	unsigned int ib;
+
+	for (ib = 0; ib < CB_SECRET; ib += 16) {
+		write64(rgbSecret + ib, read64(rgbDefaultSecret + ib) + seed);
+		write64(rgbSecret + ib + 8, read64(rgbDefaultSecret + ib + 8) - seed);
+	}
+}
+
+/* Takes in everything but the last stripe, which always has some input */
+static void
+hash_long(
+	uint64_t rgAcc[8],
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte *pbSecret
+)
+{
+	unsigned int grfFeatures = bs_cpu_features();
+	size_t cBlocks = (cbInput - 1) / CB_BLOCK, iBlock;
+
+	init_accumulators(rgAcc);
+
+	for (iBlock = 0; iBlock < cBlocks; iBlock++) {
+		accumulate(
+			grfFeatures,
+			rgAcc,
+			pbInput,
+			pbSecret,
+			C_STRIPES_PER_BLOCK
+		);
+		scramble(grfFeatures, rgAcc, pbSecret + CB_SECRET - CB_STRIPE);
+		pbInput += CB_BLOCK;
+		cbInput -= CB_BLOCK;
+	}
+
+	accumulate(
+		grfFeatures,
+		rgAcc,
+		pbInput,
+		pbSecret,
+		(cbInput - 1) / CB_STRIPE
+	);
+	accumulate(
+		grfFeatures,
+		rgAcc,
+		pbInput + cbInput - CB_STRIPE,
+		pbSecret + IB_SECRET_LAST_STRIPE,
+		1
+	);
+}
+
+static uint64_t
+merge_accumulators(
+	const uint64_t rgAcc[8],
+	const BSbyte *pbSecret,
+	uint64_t start
+)
+{
+	unsigned int iPair;
+
+	for (iPair = 0; iPair < 4; iPair++) {
+		start += mul128_fold64(
+			rgAcc[2 * iPair] ^ read64(pbSecret + 16 * iPair),
+			rgAcc[2 * iPair + 1] ^ read64(pbSecret + 16 * iPair + 8)
+		);
+	}
+
+	return avalanche(start);
+}
+
+static uint64_t
+digest64_long(const uint64_t rgAcc[8], const BSbyte *pbSecret, uint64_t cb)
+{
+	return merge_accumulators(
+		rgAcc,
+		pbSecret + IB_SECRET_MERGE,
+		cb * PRIME64_1
+	);
+}
+
+static void
+digest128_long(
+	const uint64_t rgAcc[8],
+	const BSbyte *pbSecret,
+	uint64_t cb,
+	BShash128 *hash
+)
+{
+	hash->low = merge_accumulators(
+		rgAcc,
+		pbSecret + IB_SECRET_MERGE,
+		cb * PRIME64_1
+	);
+	hash->high = merge_accumulators(
+		rgAcc,
+		pbSecret + CB_SECRET - 8 * 8 - IB_SECRET_MERGE,
+		~(cb * PRIME64_2)
+	);
+}
+
+/*
+ * 64-bit hashes
+ */
+
+static uint64_t
+hash64_short(const BSbyte *pbInput, size_t cbInput, uint64_t seed)
+{
+	const BSbyte *pbSecret = rgbDefaultSecret;
+	uint64_t keyed, low, high;
+	uint32_t combined;
+
+	if (cbInput > 8) {
+		low = read64(pbInput)
+		    ^ ((read64(pbSecret + 24) ^ read64(pbSecret + 32)) + seed);
+		high = read64(pbInput + cbInput - 8)
+		     ^ ((read64(pbSecret + 40) ^ read64(pbSecret + 48)) - seed);
+		return avalanche(
+			cbInput + swap64(low) + high + mul128_fold64(low, high)
+		);
+	}
+
+	if (cbInput >= 4) {
+		seed ^= (uint64_t) swap32((uint32_t) seed) << 32;
+		keyed = (read32(pbInput + cbInput - 4)
+		      + ((uint64_t) read32(pbInput) << 32))
+		      ^ ((read64(pbSecret + 8) ^ read64(pbSecret + 16)) - seed);
+		return rrmxmx(keyed, cbInput);
+	}
+
+	if (cbInput > 0) {
+		combined = ((uint32_t) pbInput[0] << 16)
+		         | ((uint32_t) pbInput[cbInput >> 1] << 24)
+		         | (uint32_t) pbInput[cbInput - 1]
+		         | ((uint32_t) cbInput << 8);
+		return avalanche_xxh64(
+			combined ^ ((read32(pbSecret) ^ read32(pbSecret + 4)) + seed)
+		);
+	}
+
+	return avalanche_xxh64(
+		seed ^ read64(pbSecret + 56) ^ read64(pbSecret + 64)
+	);
+}
+
+static uint64_t
+hash64_medium(const BSbyte *pbInput, size_t cbInput, uint64_t seed)
+{
+	const BSbyte *pbSecret = rgbDefaultSecret;
+	uint64_t acc = cbInput * PRIME64_1;
+	size_t iRound;
+
+	if (cbInput <= 128) {
+		/* Pairs of blocks from each end, overlapping for odd lengths */
+		for (iRound = (cbInput - 1) / 32 + 1; iRound-- > 0; ) {
+			acc += mix16(pbInput + 16 * iRound, pbSecret + 32 * iRound, seed);
+			acc += mix16(
+				pbInput + cbInput - 16 * (iRound + 1),
+				pbSecret + 32 * iRound + 16,
+				seed
+			);
+		}
+		return avalanche(acc);
+	}
+
+	for (iRound = 0; iRound < 8; iRound++) {
+		acc += mix16(pbInput + 16 * iRound, pbSecret + 16 * iRound, seed);
+	}
+	acc = avalanche(acc);
+	for (iRound = 8; iRound < cbInput / 16; iRound++) {
+		acc += mix16(
+			pbInput + 16 * iRound,
+			pbSecret + 16 * (iRound - 8) + 3,
+			seed
+		);
+	}
+	acc += mix16(pbInput + cbInput - 16, pbSecret + CB_SECRET_MIN - 17, seed);
+	return avalanche(acc);
+}
+
+static uint64_t
+hash64_bytes(const BSbyte *pbInput, size_t cbInput, uint64_t seed)
+{
+	BSbyte rgbSecret[CB_SECRET];
+	uint64_t rgAcc[8];
+
+	if (cbInput <= 16) {
+		return hash64_short(pbInput, cbInput, seed);
+	}
+	if (cbInput <= CB_MIDSIZE_MAX) {
+		return hash64_medium(pbInput, cbInput, seed);
+	}
+
+	if (seed == 0) {
+		hash_long(rgAcc, pbInput, cbInput, rgbDefaultSecret);
+		return digest64_long(rgAcc, rgbDefaultSecret, cbInput);
+	}
+
+	derive_secret(rgbSecret, seed);
+	hash_long(rgAcc, pbInput, cbInput, rgbSecret);
+	return digest64_long(rgAcc, rgbSecret, cbInput);
+}
+
+/*
+ * 128-bit hashes
+ */
+
+static void
+hash128_short(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t seed,
+	BShash128 *hash
+)
+{
+	const BSbyte *pbSecret = rgbDefaultSecret;
+	uint64_t low, high, keyed;
+	uint32_t combined;
+
+	if (cbInput > 8) {
+		low = read64(pbInput);
+		high = read64(pbInput + cbInput - 8);
+		low = mul128(
+			low ^ high
+			    ^ ((read64(pbSecret + 32) ^ read64(pbSecret + 40)) - seed),
+			PRIME64_1,
+			&keyed
+		);
+		low += (uint64_t) (cbInput - 1) << 54;
+		high ^= (read64(pbSecret + 48) ^ read64(pbSecret + 56)) + seed;
+		keyed += high + (high & 0xFFFFFFFF) * (PRIME32_2 - 1);
+		low ^= swap64(keyed);
+
+		hash->low = mul128(low, PRIME64_2, &hash->high);
+		hash->high += keyed * PRIME64_2;
+		hash->low = avalanche(hash->low);
+		hash->high = avalanche(hash->high);
+		return;
+	}
+
+	if (cbInput >= 4) {
+		seed ^= (uint64_t) swap32((uint32_t) seed) << 32;
+		keyed = read32(pbInput)
+		      + ((uint64_t) read32(pbInput + cbInput - 4) << 32);
+		keyed ^= (read64(pbSecret + 16) ^ read64(pbSecret + 24)) + seed;
+
+		low = mul128(keyed, PRIME64_1 + (cbInput << 2), &high);
+		high += low << 1;
+		low ^= high >> 3;
+		low ^= low >> 35;
+		low *= PRIME_MX2;
+		low ^= low >> 28;
+
+		hash->low = low;
+		hash->high = avalanche(high);
+		return;
+	}
+
+	if (cbInput > 0) {
+		combined = ((uint32_t) pbInput[0] << 16)
+		         | ((uint32_t) pbInput[cbInput >> 1] << 24)
+		         | (uint32_t) pbInput[cbInput - 1]
+		         | ((uint32_t) cbInput << 8);
+		hash->low = avalanche_xxh64(
+			combined ^ ((read32(pbSecret) ^ read32(pbSecret + 4)) + seed)
+		);
+		combined = swap32(combined);
+		combined = (combined << 13) | (combined >> 19);
+		hash->high = avalanche_xxh64(
+			combined ^ ((read32(pbSecret + 8) ^ read32(pbSecret + 12)) - seed)
+		);
+		return;
+	}
+
+	hash->low = avalanche_xxh64(
+		seed ^ read64(pbSecret + 64) ^ read64(pbSecret + 72)
+	);
+	hash->high = avalanche_xxh64(
+		seed ^ read64(pbSecret + 80) ^ read64(pbSecret + 88)
+	);
+}
+
+static void
+hash128_medium(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t seed,
+	BShash128 *hash
+)
+{
+	const BSbyte *pbSecret = rgbDefaultSecret;
+	uint64_t rgAcc[2];
+	size_t iRound;
+
+	rgAcc[0] = cbInput * PRIME64_1;
+	rgAcc[1] = 0;
+
+	if (cbInput <= 128) {
+		for (iRound = (cbInput - 1) / 32 + 1; iRound-- > 0; ) {
+			mix32(
+				rgAcc,
+				pbInput + 16 * iRound,
+				pbInput + cbInput - 16 * (iRound + 1),
+				pbSecret + 32 * iRound,
+				seed
+			);
+		}
+	} else {
+		for (iRound = 0; iRound < 4; iRound++) {
+			mix32(
+				rgAcc,
+				pbInput + 32 * iRound,
+				pbInput + 32 * iRound + 16,
+				pbSecret + 32 * iRound,
+				seed
+			);
+		}
+		rgAcc[0] = avalanche(rgAcc[0]);
+		rgAcc[1] = avalanche(rgAcc[1]);
+		for (iRound = 4; iRound < cbInput / 32; iRound++) {
+			mix32(
+				rgAcc,
+				pbInput + 32 * iRound,
+				pbInput + 32 * iRound + 16,
+				pbSecret + 32 * (iRound - 4) + 3,
+				seed
+			);
+		}
+		mix32(
+			rgAcc,
+			pbInput + cbInput - 16,
+			pbInput + cbInput - 32,
+			pbSecret + CB_SECRET_MIN - 17 - 16,
+			0 - seed
+		);
+	}
+
+	hash->low = avalanche(rgAcc[0] + rgAcc[1]);
+	hash->high = 0 - avalanche(
+		rgAcc[0] * PRIME64_1 + rgAcc[1] * PRIME64_4
+		+ (cbInput - seed) * PRIME64_2
+	);
+}
+
+static void
+hash128_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint64_t seed,
+	BShash128 *hash
+)
+{
+	BSbyte rgbSecret[CB_SECRET];
+	uint64_t rgAcc[8];
+
+	if (cbInput <= 16) {
+		hash128_short(pbInput, cbInput, seed, hash);
+	} else if (cbInput <= CB_MIDSIZE_MAX) {
+		hash128_medium(pbInput, cbInput, seed, hash);
+	} else if (seed == 0) {
+		hash_long(rgAcc, pbInput, cbInput, rgbDefaultSecret);
+		digest128_long(rgAcc, rgbDefaultSecret, cbInput, hash);
+	} else {
+		derive_secret(rgbSecret, seed);
+		hash_long(rgAcc, pbInput, cbInput, rgbSecret);
+		digest128_long(rgAcc, rgbSecret, cbInput, hash);
+	}
+}
+
+BSresult
+bs_hash64(const BS *bs, uint64_t *hash)
+{
+	return bs_hash64_seeded(bs, 0, hash);
+}
+
+BSresult
+bs_hash64_seeded(const BS *bs, uint64_t seed, uint64_t *hash)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(hash)
+	BS_ASSERT_VALID(bs)
+
+	*hash = hash64_bytes(bs->pbBytes, bs->cbBytes, seed);
+	return BS_OK;
+}
+
+BSresult
+bs_hash128(const BS *bs, BShash128 *hash)
+{
+	return bs_hash128_seeded(bs, 0, hash);
+}
+
+BSresult
+bs_hash128_seeded(const BS *bs, uint64_t seed, BShash128 *hash)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(hash)
+	BS_ASSERT_VALID(bs)
+
+	hash128_bytes(bs->pbBytes, bs->cbBytes, seed, hash);
+	return BS_OK;
+}
+
+/*
+ * Streaming
+ * Input is buffered until there's more than a buffer's worth, and then whole
+ * stripes are taken in from the buffer. The buffer is never emptied entirely,
+ * since the last stripe is handled differently; the bytes before it are kept
+ * at the end of the buffer in case they're needed to make up a full stripe.
+ */
+
+BShashstate *
+bs_hashstate_create(uint64_t seed)
+{
+	BShashstate *state = malloc(sizeof(*state));
+
+	if (state != NULL) {
+		bs_hashstate_reset(state, seed);
+	}
+
+	return state;
+}
+
+void
+bs_hashstate_free(BShashstate *state)
+{
+	free(state);
+}
+
+void
+bs_hashstate_reset(BShashstate *state, uint64_t seed)
+{
+	if (state == NULL) {
+		return;
+	}
+
+	init_accumulators(state->rgAcc);
+	derive_secret(state->rgbSecret, seed);
+	state->cbBuffered = 0;
+	state->cStripes = 0;
+	state->cbTotal = 0;
+	state->seed = seed;
+}
+
+/*
+ * Takes in CSTRIPES stripes, scrambling if they complete a block
+ * *PCSTRIPESDONE counts the stripes already taken in the current block.
+ */
+static void
+consume_stripes(
+	unsigned int grfFeatures,
+	uint64_t rgAcc[8],
+	size_t *pcStripesDone,
+	const BSbyte *pbSecret,
+	const BSbyte *pbInput,
+	size_t cStripes
+)
+{
+	const BSbyte *pbKey = pbSecret + 8 * *pcStripesDone;
+	size_t cStripesToEnd = C_STRIPES_PER_BLOCK - *pcStripesDone;
+
+	if (cStripes >= cStripesToEnd) {
+		accumulate(grfFeatures, rgAcc, pbInput, pbKey, cStripesToEnd);
+		scramble(grfFeatures, rgAcc, pbSecret + CB_SECRET - CB_STRIPE);
+		accumulate(
+			grfFeatures,
+			rgAcc,
+			pbInput + CB_STRIPE * cStripesToEnd,
+			pbSecret,
+			cStripes - cStripesToEnd
+		);
+		*pcStripesDone = cStripes - cStripesToEnd;
+	} else {
+		accumulate(grfFeatures, rgAcc, pbInput, pbKey, cStripes);
+		*pcStripesDone += cStripes;
+	}
+}
+
+static void
+update_bytes(BShashstate *state, const BSbyte *pbInput, size_t cbInput)
+{
+	const BSbyte *pbEnd = pbInput + cbInput;
+	unsigned int grfFeatures;
+	size_t cbLoad;
+
+	state->cbTotal += cbInput;
+
+	if (cbInput <= CB_BUFFER - state->cbBuffered) {
+		memcpy(state->rgbBuffer + state->cbBuffered, pbInput, cbInput);
+		state->cbBuffered += cbInput;
+		return;
+	}
+
+	grfFeatures = bs_cpu_features();
+
+	/* Fill the buffer and take it in, as there's more to come after it */
+	if (state->cbBuffered > 0) {
+		cbLoad = CB_BUFFER - state->cbBuffered;
+		memcpy(state->rgbBuffer + state->cbBuffered, pbInput, cbLoad);
+		pbInput += cbLoad;
+		consume_stripes(
+			grfFeatures,
+			state->rgAcc,
+			&state->cStripes,
+			state->rgbSecret,
+			state->rgbBuffer,
+			CB_BUFFER / CB_STRIPE
+		);
+		state->cbBuffered = 0;
+	}
+
+	/* Take in the input directly, leaving at least one byte */
+	if ((size_t) (pbEnd - pbInput) > CB_BUFFER) {
+		do {
+			consume_stripes(
+				grfFeatures,
+				state->rgAcc,
+				&state->cStripes,
+				state->rgbSecret,
+				pbInput,
+				CB_BUFFER / CB_STRIPE
+			);
+			pbInput += CB_BUFFER;
+		} while ((size_t) (pbEnd - pbInput) > CB_BUFFER);
+		memcpy(
+			state->rgbBuffer + CB_BUFFER - CB_STRIPE,
+			pbInput - CB_STRIPE,
+			CB_STRIPE
+		);
+	}
+
+	memcpy(state->rgbBuffer, pbInput, pbEnd - pbInput);
+	state->cbBuffered = pbEnd - pbInput;
+}
+
+/* Finishes a copy of the accumulators for a long input */
+static void
+digest_long(const BShashstate *state, uint64_t rgAcc[8])
+{
+	unsigned int grfFeatures = bs_cpu_features();
+	BSbyte rgbLastStripe[CB_STRIPE];
+	const BSbyte *pbLastStripe;
+	size_t cStripesDone = state->cStripes, cbCatchup;
+
+	memcpy(rgAcc, state->rgAcc, sizeof(state->rgAcc));
+
+	if (state->cbBuffered >= CB_STRIPE) {
+		consume_stripes(
+			grfFeatures,
+			rgAcc,
+			&cStripesDone,
+			state->rgbSecret,
+			state->rgbBuffer,
+			(state->cbBuffered - 1) / CB_STRIPE
+		);
+		pbLastStripe = state->rgbBuffer + state->cbBuffered - CB_STRIPE;
+	} else {
+		/* The rest of the stripe is left at the end of the buffer */
+		cbCatchup = CB_STRIPE - state->cbBuffered;
+		memcpy(
+			rgbLastStripe,
+			state->rgbBuffer + CB_BUFFER - cbCatchup,
+			cbCatchup
+		);
+		memcpy(rgbLastStripe + cbCatchup, state->rgbBuffer, state->cbBuffered);
+		pbLastStripe = rgbLastStripe;
+	}
+
+	accumulate(
+		grfFeatures,
+		rgAcc,
+		pbLastStripe,
+		state->rgbSecret + IB_SECRET_LAST_STRIPE,
+		1
+	);
+}
+
+BSresult
+bs_hashstate_update(BShashstate *state, const BS *bs)
+{
+	BS_CHECK_POINTER(state)
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+
+	if (bs->cbBytes > 0) {
+		update_bytes(state, bs->pbBytes, bs->cbBytes);
+	}
+
+	return BS_OK;
+}
+
+BSresult
+bs_hashstate_digest64(const BShashstate *state, uint64_t *hash)
+{
+	uint64_t rgAcc[8];
+
+	BS_CHECK_POINTER(state)
+	BS_CHECK_POINTER(hash)
+
+	if (state->cbTotal <= CB_MIDSIZE_MAX) {
+		*hash = hash64_bytes(state->rgbBuffer, state->cbBuffered, state->seed);
+		return BS_OK;
+	}
+
+	digest_long(state, rgAcc);
+	*hash = digest64_long(rgAcc, state->rgbSecret, state->cbTotal);
+	return BS_OK;
+}
+
+BSresult
+bs_hashstate_digest128(const BShashstate *state, BShash128 *hash)
+{
+	uint64_t rgAcc[8];
+
+	BS_CHECK_POINTER(state)
+	BS_CHECK_POINTER(hash)
+
+	if (state->cbTotal <= CB_MIDSIZE_MAX) {
+		hash128_bytes(state->rgbBuffer, state->cbBuffered, state->seed, hash);
+		return BS_OK;
+	}
+
+	digest_long(state, rgAcc);
+	digest128_long(rgAcc, state->rgbSecret, state->cbTotal, hash);
+	return BS_OK;
+}
@@ -26,9 +26,46 @@
 
 #include "libbs.h"
 #include "bs_internal.h"
+#include "cpu.h"
+#include "pool.h"
+#include <stdlib.h>
 
 BSresult
 bs_map(BS *bs, BSbyte (*operation) (BSbyte byte))
+{
+	return bs_map_to(bs, bs, operation);
+}
+
+BSresult
+bs_map_to(BS *dst, const BS *src, BSbyte (*operation) (BSbyte byte))
+{
+	size_t ibByteStream;
+	BSresult result;
+
+	BS_CHECK_POINTER(dst)
+	BS_CHECK_POINTER(src)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(dst)
+	BS_ASSERT_VALID(src)
+
+	result = bs_malloc(dst, src->cbBytes);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	for (ibByteStream = 0; ibByteStream < src->cbBytes; ibByteStream++) {
+		dst->pbBytes[ibByteStream] = operation(src->pbBytes[ibByteStream]);
+	}
+
+	return BS_OK;
+}
+
+BSresult
+bs_map_ctx(
+	BS *bs,
+	BSbyte (*operation) (BSbyte byte, size_t index, void *data),
+	void *data
+)
 {
 	size_t ibByteStream;
 
@@ -37,44 +74,622 @@ bs_map(BS *bs, BSbyte (*operation) (BSbyte byte))
 	BS_ASSERT_VALID(bs)
 
 	for (ibByteStream = 0; ibByteStream < bs->cbBytes; ibByteStream++) {
-		bs->pbBytes[ibByteStream] = operation(bs->pbBytes[ibByteStream]);
+		bs->pbBytes[ibByteStream] = operation(
+			bs->pbBytes[ibByteStream],
+			ibByteStream,
+			data
+		);
+	}
+
+	return BS_OK;
+}
+
+BSresult
+bs_map_blocks(
+	BS *bs,
+	size_t block_size,
+	BSresult (*operation) (
+		BSbyte *block,
+		size_t length,
+		size_t offset,
+		void *data
+	),
+	void *data
+)
+{
+	size_t ibByteStream = 0, cbBlock;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(bs)
+
+	if (block_size == 0) {
+		return BS_INVALID;
+	}
+
+	while (ibByteStream < bs->cbBytes) {
+		cbBlock = bs->cbBytes - ibByteStream;
+		if (cbBlock > block_size) {
+			cbBlock = block_size;
+		}
+
+		result = operation(
+			bs->pbBytes + ibByteStream,
+			cbBlock,
+			ibByteStream,
+			data
+		);
+		if (result != BS_OK) {
+			return result;
+		}
+
+		ibByteStream += cbBlock;
+	}
+
+	return BS_OK;
+}
+
+static void
+map_table_bytes(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte table[256]
+)
+{
+	size_t ibInput = 0;
+
+	/* Unrolled so that independent lookups can overlap */
+	while (cbInput - ibInput >= 4) {
+		pbOutput[ibInput + 0] = table[pbInput[ibInput + 0]];
+		pbOutput[ibInput + 1] = table[pbInput[ibInput + 1]];
+		pbOutput[ibInput + 2] = table[pbInput[ibInput + 2]];
+		pbOutput[ibInput + 3] = table[pbInput[ibInput + 3]];
+		ibInput += 4;
+	}
+
+	while (ibInput < cbInput) {
+		pbOutput[ibInput] = table[pbInput[ibInput]];
+		ibInput++;
+	}
+}
+
+#ifdef BS_SIMD_X86
+
+/*
+ * Each of the vectorised kernels below works through whole vectors only and
+ * returns the number of bytes processed (the case and NOT kernels work in place
+ * and return a pointer to the first byte they didn't process). The caller
+ * finishes off the last few bytes with a table.
+ */
+
+/*
+ * Case conversion flips bit 0x20 of every byte in [ bFirst, bFirst + 25 ].
+ * Adding 0x80 - bFirst moves that range to [ -128, -103 ] as signed bytes, so a
+ * single signed comparison picks out the letters.
+ */
+static BS_TARGET("sse2") BSbyte *
+map_case_sse2(BSbyte *pbBytes, BSbyte *pbEnd, BSbyte bFirst)
+{
+	const __m128i vBias = _mm_set1_epi8((char) (0x80 - bFirst));
+	const __m128i vLimit = _mm_set1_epi8(-128 + 26);
+	const __m128i vFlip = _mm_set1_epi8(0x20);
+	__m128i v, vLetters;
+
+	while (pbEnd - pbBytes >= 16) {
+		v = _mm_loadu_si128((const __m128i *) pbBytes);
+		vLetters = _mm_cmplt_epi8(_mm_add_epi8(v, vBias), vLimit);
+		v = _mm_xor_si128(v, _mm_and_si128(vLetters, vFlip));
+		_mm_storeu_si128((__m128i *) pbBytes, v);
+		pbBytes += 16;
+	}
+
+	return pbBytes;
+}
+
+static BS_TARGET("avx2") BSbyte *
+map_case_avx2(BSbyte *pbBytes, BSbyte *pbEnd, BSbyte bFirst)
+{
+	const __m256i vBias = _mm256_set1_epi8((char) (0x80 - bFirst));
+	const __m256i vLimit = _mm256_set1_epi8(-128 + 26);
+	const __m256i vFlip = _mm256_set1_epi8(0x20);
+	__m256i v, vLetters;
+
+	while (pbEnd - pbBytes >= 32) {
+		v = _mm256_loadu_si256((const __m256i *) pbBytes);
+		vLetters = _mm256_cmpgt_epi8(vLimit, _mm256_add_epi8(v, vBias));
+		v = _mm256_xor_si256(v, _mm256_and_si256(vLetters, vFlip));
+		_mm256_storeu_si256((__m256i *) pbBytes, v);
+		pbBytes += 32;
+	}
+
+	return pbBytes;
+}
+
+static BS_TARGET("sse2") BSbyte *
+map_not_sse2(BSbyte *pbBytes, BSbyte *pbEnd)
+{
+	const __m128i vOnes = _mm_set1_epi8(-1);
+	__m128i v;
+
+	while (pbEnd - pbBytes >= 16) {
+		v = _mm_loadu_si128((const __m128i *) pbBytes);
+		_mm_storeu_si128((__m128i *) pbBytes, _mm_xor_si128(v, vOnes));
+		pbBytes += 16;
+	}
+
+	return pbBytes;
+}
+
+static BS_TARGET("avx2") BSbyte *
+map_not_avx2(BSbyte *pbBytes, BSbyte *pbEnd)
+{
+	const __m256i vOnes = _mm256_set1_epi8(-1);
+	__m256i v;
+
+	while (pbEnd - pbBytes >= 32) {
+		v = _mm256_loadu_si256((const __m256i *) pbBytes);
+		_mm256_storeu_si256((__m256i *) pbBytes, _mm256_xor_si256(v, vOnes));
+		pbBytes += 32;
+	}
+
+	return pbBytes;
+}
+
+/*
+ * A shuffle looks up the low nibble of each byte in all sixteen rows of the
+ * table at once. The bits of the high nibble then choose between the results
+ * pairwise, starting from the top: blendv looks only at bit 7 of each byte, so
+ * the selector is shifted left to bring bits 6, 5 and 4 there in turn.
+ */
+#define BLEND_ROWS(iRow) _mm256_blendv_epi8( \
+	_mm256_shuffle_epi8(rgvRows[iRow], vLow), \
+	_mm256_shuffle_epi8(rgvRows[(iRow) + 8], vLow), \
+	vSelect \
+)
+
+static BS_TARGET("avx2") size_t
+map_table_avx2(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte table[256]
+)
+{
+	const __m256i vNibble = _mm256_set1_epi8(0x0F);
+	__m256i rgvRows[16];
+	__m256i v, vLow, vSelect, v0, v1, v2, v3, v4, v5, v6, v7;
+	size_t ibInput = 0;
+	int iRow;
+
+	for (iRow = 0; iRow < 16; iRow++) {
+		rgvRows[iRow] = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *) (table + 16 * iRow))
+		);
+	}
+
+	while (cbInput - ibInput >= 32) {
+		v = _mm256_loadu_si256((const __m256i *) (pbInput + ibInput));
+		vLow = _mm256_and_si256(v, vNibble);
+
+		/* Bit 7 */
+		vSelect = v;
+		v0 = BLEND_ROWS(0);
+		v1 = BLEND_ROWS(1);
+		v2 = BLEND_ROWS(2);
+		v3 = BLEND_ROWS(3);
+		v4 = BLEND_ROWS(4);
+		v5 = BLEND_ROWS(5);
+		v6 = BLEND_ROWS(6);
+		v7 = BLEND_ROWS(7);
+
+		/* Bit 6 */
+		vSelect = _mm256_add_epi8(vSelect, vSelect);
+		v0 = _mm256_blendv_epi8(v0, v4, vSelect);
+		v1 = _mm256_blendv_epi8(v1, v5, vSelect);
+		v2 = _mm256_blendv_epi8(v2, v6, vSelect);
+		v3 = _mm256_blendv_epi8(v3, v7, vSelect);
+
+		/* Bit 5 */
+		vSelect = _mm256_add_epi8(vSelect, vSelect);
+		v0 = _mm256_blendv_epi8(v0, v2, vSelect);
+		v1 = _mm256_blendv_epi8(v1, v3, vSelect);
+
+		/* Bit 4 */
+		vSelect = _mm256_add_epi8(vSelect, vSelect);
+		v0 = _mm256_blendv_epi8(v0, v1, vSelect);
+
+		_mm256_storeu_si256((__m256i *) (pbOutput + ibInput), v0);
+		ibInput += 32;
+	}
+
+	return ibInput;
+}
+
+#undef BLEND_ROWS
+
+/*
+ * With VBMI a two-register permute covers 128 table entries, so two of them
+ * cover the whole table and bit 7 of each byte picks the right half.
+ */
+static BS_TARGET("avx512bw,avx512vbmi") size_t
+map_table_avx512vbmi(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte table[256]
+)
+{
+	const __m512i vTable0 = _mm512_loadu_si512(table);
+	const __m512i vTable1 = _mm512_loadu_si512(table + 64);
+	const __m512i vTable2 = _mm512_loadu_si512(table + 128);
+	const __m512i vTable3 = _mm512_loadu_si512(table + 192);
+	__m512i v, vLow, vHigh;
+	size_t ibInput = 0;
+
+	while (cbInput - ibInput >= 64) {
+		v = _mm512_loadu_si512(pbInput + ibInput);
+		vLow = _mm512_permutex2var_epi8(vTable0, v, vTable1);
+		vHigh = _mm512_permutex2var_epi8(vTable2, v, vTable3);
+		v = _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), vLow, vHigh);
+		_mm512_storeu_si512(pbOutput + ibInput, v);
+		ibInput += 64;
+	}
+
+	return ibInput;
+}
+
+#endif /* BS_SIMD_X86 */
+
+static void
+map_table_into(
+	BSbyte *pbOutput,
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte table[256]
+)
+{
+	size_t cbDone = 0;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+
+	if (grfFeatures & BS_CPU_AVX512VBMI) {
+		cbDone = map_table_avx512vbmi(pbOutput, pbInput, cbInput, table);
+	} else if (grfFeatures & BS_CPU_AVX2) {
+		cbDone = map_table_avx2(pbOutput, pbInput, cbInput, table);
+	}
+#endif
+
+	map_table_bytes(pbOutput + cbDone, pbInput + cbDone, cbInput - cbDone, table);
+}
+
+BSresult
+bs_map_table(BS *bs, const BSbyte table[256])
+{
+	return bs_map_table_to(bs, bs, table);
+}
+
+BSresult
+bs_map_table_to(BS *dst, const BS *src, const BSbyte table[256])
+{
+	BSresult result;
+
+	BS_CHECK_POINTER(dst)
+	BS_CHECK_POINTER(src)
+	BS_CHECK_POINTER(table)
+	BS_ASSERT_VALID(dst)
+	BS_ASSERT_VALID(src)
+
+	result = bs_malloc(dst, src->cbBytes);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	map_table_into(dst->pbBytes, src->pbBytes, src->cbBytes, table);
+
+	return BS_OK;
+}
+
+struct BSmapjob {
+	BSbyte *pbBytes;                     /* Start of the whole stream */
+	BSbyte (*fpOperation) (BSbyte byte); /* Operation for bs_map_parallel */
+	const BSbyte *pbTable;               /* Table for bs_map_table_parallel */
+};
+
+static BSresult
+map_range(size_t offset, size_t length, void *data)
+{
+	struct BSmapjob *job = data;
+	BSbyte *pbBytes = job->pbBytes + offset;
+	size_t ibRange;
+
+	for (ibRange = 0; ibRange < length; ibRange++) {
+		pbBytes[ibRange] = job->fpOperation(pbBytes[ibRange]);
 	}
 
 	return BS_OK;
 }
 
-static BSbyte
-uppercase_byte(BSbyte byte)
+static BSresult
+map_table_range(size_t offset, size_t length, void *data)
 {
-	return (byte >= 'a' && byte <= 'z') ? byte - 'a' + 'A' : byte;
+	struct BSmapjob *job = data;
+
+	map_table_into(
+		job->pbBytes + offset,
+		job->pbBytes + offset,
+		length,
+		job->pbTable
+	);
+
+	return BS_OK;
 }
 
-static BSbyte
-lowercase_byte(BSbyte byte)
+BSresult
+bs_map_parallel(BS *bs, BSbyte (*operation) (BSbyte byte), BSpool *pool)
 {
-	return (byte >= 'A' && byte <= 'Z') ? byte - 'A' + 'a' : byte;
+	struct BSmapjob job;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(operation)
+	BS_ASSERT_VALID(bs)
+
+	job.pbBytes = bs->pbBytes;
+	job.fpOperation = operation;
+	job.pbTable = NULL;
+
+	return bs_pool_run(pool, bs->cbBytes, BS_PARALLEL_RANGE, map_range, &job);
 }
 
-static BSbyte
-not_byte(BSbyte byte)
+BSresult
+bs_map_table_parallel(BS *bs, const BSbyte table[256], BSpool *pool)
 {
-	return ~byte;
+	struct BSmapjob job;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(table)
+	BS_ASSERT_VALID(bs)
+
+	job.pbBytes = bs->pbBytes;
+	job.fpOperation = NULL;
+	job.pbTable = table;
+
+	return bs_pool_run(
+		pool,
+		bs->cbBytes,
+		BS_PARALLEL_RANGE,
+		map_table_range,
+		&job
+	);
+}
+
+BSresult
+bs_map_compile(BSbyte table[256], BSbyte (*operation) (BSbyte byte))
+{
+	size_t iByte;
+
+	BS_CHECK_POINTER(table)
+	BS_CHECK_POINTER(operation)
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		table[iByte] = operation((BSbyte) iByte);
+	}
+
+	return BS_OK;
+}
+
+static const BSbyte
+rgUppercase[256] = {
+/*       0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F */
+/* 0 */  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+/* 1 */  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+/* 2 */  0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+/* 3 */  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+/* 4 */  0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+/* 5 */  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+/* 6 */  0x60, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+/* 7 */  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+/* 8 */  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+/* 9 */  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+/* A */  0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+/* B */  0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+/* C */  0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF,
+/* D */  0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF,
+/* E */  0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+/* F */  0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+static const BSbyte
+rgLowercase[256] = {
+/*       0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F */
+/* 0 */  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+/* 1 */  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+/* 2 */  0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+/* 3 */  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+/* 4 */  0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+/* 5 */  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+/* 6 */  0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+/* 7 */  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+/* 8 */  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+/* 9 */  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+/* A */  0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+/* B */  0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+/* C */  0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF,
+/* D */  0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF,
+/* E */  0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+/* F */  0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
+};
+
+static const BSbyte
+rgNot[256] = {
+/*       0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F */
+/* 0 */  0xFF, 0xFE, 0xFD, 0xFC, 0xFB, 0xFA, 0xF9, 0xF8, 0xF7, 0xF6, 0xF5, 0xF4, 0xF3, 0xF2, 0xF1, 0xF0,
+/* 1 */  0xEF, 0xEE, 0xED, 0xEC, 0xEB, 0xEA, 0xE9, 0xE8, 0xE7, 0xE6, 0xE5, 0xE4, 0xE3, 0xE2, 0xE1, 0xE0,
+/* 2 */  0xDF, 0xDE, 0xDD, 0xDC, 0xDB, 0xDA, 0xD9, 0xD8, 0xD7, 0xD6, 0xD5, 0xD4, 0xD3, 0xD2, 0xD1, 0xD0,
+/* 3 */  0xCF, 0xCE, 0xCD, 0xCC, 0xCB, 0xCA, 0xC9, 0xC8, 0xC7, 0xC6, 0xC5, 0xC4, 0xC3, 0xC2, 0xC1, 0xC0,
+/* 4 */  0xBF, 0xBE, 0xBD, 0xBC, 0xBB, 0xBA, 0xB9, 0xB8, 0xB7, 0xB6, 0xB5, 0xB4, 0xB3, 0xB2, 0xB1, 0xB0,
+/* 5 */  0xAF, 0xAE, 0xAD, 0xAC, 0xAB, 0xAA, 0xA9, 0xA8, 0xA7, 0xA6, 0xA5, 0xA4, 0xA3, 0xA2, 0xA1, 0xA0,
+/* 6 */  0x9F, 0x9E, 0x9D, 0x9C, 0x9B, 0x9A, 0x99, 0x98, 0x97, 0x96, 0x95, 0x94, 0x93, 0x92, 0x91, 0x90,
+/* 7 */  0x8F, 0x8E, 0x8D, 0x8C, 0x8B, 0x8A, 0x89, 0x88, 0x87, 0x86, 0x85, 0x84, 0x83, 0x82, 0x81, 0x80,
+/* 8 */  0x7F, 0x7E, 0x7D, 0x7C, 0x7B, 0x7A, 0x79, 0x78, 0x77, 0x76, 0x75, 0x74, 0x73, 0x72, 0x71, 0x70,
+/* 9 */  0x6F, 0x6E, 0x6D, 0x6C, 0x6B, 0x6A, 0x69, 0x68, 0x67, 0x66, 0x65, 0x64, 0x63, 0x62, 0x61, 0x60,
+/* A */  0x5F, 0x5E, 0x5D, 0x5C, 0x5B, 0x5A, 0x59, 0x58, 0x57, 0x56, 0x55, 0x54, 0x53, 0x52, 0x51, 0x50,
+/* B */  0x4F, 0x4E, 0x4D, 0x4C, 0x4B, 0x4A, 0x49, 0x48, 0x47, 0x46, 0x45, 0x44, 0x43, 0x42, 0x41, 0x40,
+/* C */  0x3F, 0x3E, 0x3D, 0x3C, 0x3B, 0x3A, 0x39, 0x38, 0x37, 0x36, 0x35, 0x34, 0x33, 0x32, 0x31, 0x30,
+/* D */  0x2F, 0x2E, 0x2D, 0x2C, 0x2B, 0x2A, 0x29, 0x28, 0x27, 0x26, 0x25, 0x24, 0x23, 0x22, 0x21, 0x20,
+/* E */  0x1F, 0x1E, 0x1D, 0x1C, 0x1B, 0x1A, 0x19, 0x18, 0x17, 0x16, 0x15, 0x14, 0x13, 0x12, 0x11, 0x10,
+/* F */  0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09, 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00
+};
+
+static BSresult
+map_case(BS *bs, BSbyte bFirst, const BSbyte table[256])
+{
+	BSbyte *pbBytes, *pbEnd;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+#endif
+
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+
+	pbBytes = bs->pbBytes;
+	pbEnd = pbBytes + bs->cbBytes;
+
+#ifdef BS_SIMD_X86
+	if (grfFeatures & BS_CPU_AVX2) {
+		pbBytes = map_case_avx2(pbBytes, pbEnd, bFirst);
+	} else if (grfFeatures & BS_CPU_SSE2) {
+		pbBytes = map_case_sse2(pbBytes, pbEnd, bFirst);
+	}
+#else
+	UNUSED(bFirst);
+#endif
+
+	map_table_bytes(pbBytes, pbBytes, pbEnd - pbBytes, table);
+
+	return BS_OK;
 }
 
 BSresult
 bs_map_uppercase(BS *bs)
 {
-	return bs_map(bs, uppercase_byte);
+	return map_case(bs, 'a', rgUppercase);
 }
 
 BSresult
 bs_map_lowercase(BS *bs)
 {
-	return bs_map(bs, lowercase_byte);
+	return map_case(bs, 'A', rgLowercase);
 }
 
 BSresult
 bs_map_not(BS *bs)
 {
-	return bs_map(bs, not_byte);
+	BSbyte *pbBytes, *pbEnd;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+#endif
+
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+
+	pbBytes = bs->pbBytes;
+	pbEnd = pbBytes + bs->cbBytes;
+
+#ifdef BS_SIMD_X86
+	if (grfFeatures & BS_CPU_AVX2) {
+		pbBytes = map_not_avx2(pbBytes, pbEnd);
+	} else if (grfFeatures & BS_CPU_SSE2) {
+		pbBytes = map_not_sse2(pbBytes, pbEnd);
+	}
+#endif
+
+	map_table_bytes(pbBytes, pbBytes, pbEnd - pbBytes, rgNot);
+
+	return BS_OK;
+}
+
+struct BSmapchain {
+	BSbyte rgbTable[256]; /* Composition of every map added so far */
+};
+
+BSmapchain *
+bs_mapchain_create(void)
+{
+	BSmapchain *chain;
+	size_t iByte;
+
+	chain = malloc(sizeof(struct BSmapchain));
+	if (chain == NULL) {
+		return NULL;
+	}
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		chain->rgbTable[iByte] = (BSbyte) iByte;
+	}
+
+	return chain;
+}
+
+void
+bs_mapchain_free(BSmapchain *chain)
+{
+	free(chain);
+}
+
+BSresult
+bs_mapchain_add(BSmapchain *chain, BSbyte (*operation) (BSbyte byte))
+{
+	size_t iByte;
+
+	BS_CHECK_POINTER(chain)
+	BS_CHECK_POINTER(operation)
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		chain->rgbTable[iByte] = operation(chain->rgbTable[iByte]);
+	}
+
+	return BS_OK;
+}
+
+BSresult
+bs_mapchain_add_table(BSmapchain *chain, const BSbyte table[256])
+{
+	size_t iByte;
+
+	BS_CHECK_POINTER(chain)
+	BS_CHECK_POINTER(table)
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		chain->rgbTable[iByte] = table[chain->rgbTable[iByte]];
+	}
+
+	return BS_OK;
+}
+
+BSresult
+bs_mapchain_add_uppercase(BSmapchain *chain)
+{
+	return bs_mapchain_add_table(chain, rgUppercase);
+}
+
+BSresult
+bs_mapchain_add_lowercase(BSmapchain *chain)
+{
+	return bs_mapchain_add_table(chain, rgLowercase);
+}
+
+BSresult
+bs_mapchain_add_not(BSmapchain *chain)
+{
+	return bs_mapchain_add_table(chain, rgNot);
+}
+
+BSresult
+bs_map_chain(BS *bs, const BSmapchain *chain)
+{
+	BS_CHECK_POINTER(chain)
+
+	return bs_map_table(bs, chain->rgbTable);
 }
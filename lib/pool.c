@@ -0,0 +1,292 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include "pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct BSpool {
+	pthread_t *rgThreads;  /* Worker threads */
+	size_t cThreads;       /* Count of worker threads (not counting callers) */
+	pthread_mutex_t mutexRun; /* Held while running a job */
+	pthread_mutex_t mutex;    /* Protects everything below */
+	pthread_cond_t condWork;  /* Signalled when a job starts or on shutdown */
+	pthread_cond_t condDone;  /* Signalled when the last worker finishes */
+	int fShutdown;            /* Set when workers should exit */
+	unsigned long iJob;       /* Incremented for each new job */
+	size_t cBusy;             /* Workers yet to finish the current job */
+	BSresult (*fpOperation) (size_t offset, size_t length, void *data);
+	void *pvData;             /* Data pointer for the current job */
+	size_t cbTotal;           /* Length of the current job */
+	size_t cbRange;           /* Range size for the current job */
+	size_t ibNext;            /* Start of the next unclaimed range */
+	BSresult result;          /* First failure seen in the current job */
+};
+
+/*
+ * Claims and processes ranges until the job is finished.
+ * Must be called with the mutex held, which is released around each call to
+ * the operation.
+ */
+static void
+run_ranges(BSpool *pool)
+{
+	size_t ibStart, cbRange;
+	BSresult result;
+
+	while ((pool->ibNext < pool->cbTotal) && (pool->result == BS_OK)) {
+		ibStart = pool->ibNext;
+		cbRange = pool->cbTotal - ibStart;
+		if (cbRange > pool->cbRange) {
+			cbRange = pool->cbRange;
+		}
+		pool->ibNext += cbRange;
+
+		pthread_mutex_unlock(&pool->mutex);
+		result = pool->fpOperation(ibStart, cbRange, pool->pvData);
+		pthread_mutex_lock(&pool->mutex);
+
+		if ((result != BS_OK) && (pool->result == BS_OK)) {
+			pool->result = result;
+		}
+	}
+}
+
+static void *
+run_worker(void *data)
+{
+	BSpool *pool = data;
+	unsigned long iJobSeen = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	for (;;) {
+		while (!pool->fShutdown && (pool->iJob == iJobSeen)) {
+			pthread_cond_wait(&pool->condWork, &pool->mutex);
+		}
+		if (pool->fShutdown) {
+			break;
+		}
+		iJobSeen = pool->iJob;
+
+		run_ranges(pool);
+
+		pool->cBusy--;
+		if (pool->cBusy == 0) {
+			pthread_cond_signal(&pool->condDone);
+		}
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+static void
+stop_workers(BSpool *pool, size_t cThreads)
+{
+	size_t iThread;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->fShutdown = 1;
+	pthread_cond_broadcast(&pool->condWork);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (iThread = 0; iThread < cThreads; iThread++) {
+		pthread_join(pool->rgThreads[iThread], NULL);
+	}
+}
+
+/*
+ * Initialises the pool's mutexes and condition variables
+ * Returns nonzero on success. On failure anything already initialised is
+ * destroyed again, so none of them may be used.
+ */
+static int
+init_sync(BSpool *pool)
+{
+	if (pthread_mutex_init(&pool->mutexRun, NULL)) {
+		return 0;
+	}
+
+	if (pthread_mutex_init(&pool->mutex, NULL)) {
+		pthread_mutex_destroy(&pool->mutexRun);
+		return 0;
+	}
+
+	if (pthread_cond_init(&pool->condWork, NULL)) {
+		pthread_mutex_destroy(&pool->mutex);
+		pthread_mutex_destroy(&pool->mutexRun);
+		return 0;
+	}
+
+	if (pthread_cond_init(&pool->condDone, NULL)) {
+		pthread_cond_destroy(&pool->condWork);
+		pthread_mutex_destroy(&pool->mutex);
+		pthread_mutex_destroy(&pool->mutexRun);
+		return 0;
+	}
+
+	return 1;
+}
+
+BSpool *
+bs_pool_create(size_t threads)
+{
+	BSpool *pool;
+	size_t iThread;
+	long cProcessors;
+
+	if (threads == 0) {
+		cProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cProcessors > 0) ? (size_t) cProcessors : 1;
+	}
+
+	pool = malloc(sizeof(struct BSpool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	/* The calling thread always does its share, so needs no worker */
+	pool->cThreads = threads - 1;
+	pool->rgThreads = NULL;
+	if (pool->cThreads > 0) {
+		pool->rgThreads = malloc(pool->cThreads * sizeof(pthread_t));
+		if (pool->rgThreads == NULL) {
+			free(pool);
+			return NULL;
+		}
+	}
+
+	if (!init_sync(pool)) {
+		free(pool->rgThreads);
+		free(pool);
+		return NULL;
+	}
+
+	pool->fShutdown = 0;
+	pool->iJob = 0;
+	pool->cBusy = 0;
+
+	for (iThread = 0; iThread < pool->cThreads; iThread++) {
+		if (pthread_create(&pool->rgThreads[iThread], NULL, run_worker, pool)) {
+			stop_workers(pool, iThread);
+			pool->cThreads = 0;
+			bs_pool_free(pool);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+void
+bs_pool_free(BSpool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	if (pool->cThreads > 0) {
+		stop_workers(pool, pool->cThreads);
+	}
+
+	pthread_cond_destroy(&pool->condDone);
+	pthread_cond_destroy(&pool->condWork);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->mutexRun);
+	free(pool->rgThreads);
+	free(pool);
+}
+
+size_t
+bs_pool_threads(const BSpool *pool)
+{
+	return (pool == NULL) ? 1 : pool->cThreads + 1;
+}
+
+BSresult
+bs_pool_run(
+	BSpool *pool,
+	size_t length,
+	size_t range,
+	BSresult (*operation) (size_t offset, size_t length, void *data),
+	void *data
+)
+{
+	size_t ibStart, cbRange;
+	BSresult result;
+
+	assert(range > 0);
+
+	/* Not worth waking anyone up */
+	if ((pool == NULL) || (pool->cThreads == 0) || (length <= range)) {
+		for (ibStart = 0; ibStart < length; ibStart += cbRange) {
+			cbRange = length - ibStart;
+			if (cbRange > range) {
+				cbRange = range;
+			}
+
+			result = operation(ibStart, cbRange, data);
+			if (result != BS_OK) {
+				return result;
+			}
+		}
+
+		return BS_OK;
+	}
+
+	pthread_mutex_lock(&pool->mutexRun);
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->fpOperation = operation;
+	pool->pvData = data;
+	pool->cbTotal = length;
+	pool->cbRange = range;
+	pool->ibNext = 0;
+	pool->result = BS_OK;
+	pool->cBusy = pool->cThreads;
+	pool->iJob++;
+	pthread_cond_broadcast(&pool->condWork);
+
+	run_ranges(pool);
+
+	while (pool->cBusy > 0) {
+		pthread_cond_wait(&pool->condDone, &pool->mutex);
+	}
+	result = pool->result;
+
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_mutex_unlock(&pool->mutexRun);
+
+	return result;
+}
@@ -0,0 +1,61 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef __POOL_H
+#define __POOL_H
+
+#include "libbs.h"
+
+/**
+ * Parallel range size
+ * Large enough that claiming a range costs next to nothing compared with
+ * processing it, yet small enough to sit comfortably in a core's L2 cache and
+ * to share out evenly between threads.
+ */
+#define BS_PARALLEL_RANGE 65536
+
+/**
+ * Run an operation over ranges in parallel
+ * Splits [ 0, LENGTH ) into RANGE-byte pieces and calls OPERATION on each of
+ * them, using the pool's threads as well as the calling one. Threads claim the
+ * next unprocessed range whenever they finish one, so faster threads simply end
+ * up doing more of the work.
+ * If POOL is NULL, or the work is too small to share out, everything is run on
+ * the calling thread.
+ * Returns BS_OK if all ranges are processed successfully
+ * Returns failure code from the operation otherwise, in which case no new
+ * ranges are started
+ */
+BSresult bs_pool_run(
+	BSpool *pool,
+	size_t length,
+	size_t range,
+	BSresult (*operation) (size_t offset, size_t length, void *data),
+	void *data
+);
+
+#endif /* __POOL_H */
@@ -0,0 +1,432 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include <string.h>
+
+/*
+ * Length-changing transforms size their output with a counting pass, then write
+ * it over the stream in one go. Transforms which only grow the stream write
+ * backwards from the end of the enlarged buffer, so the bytes ahead of the
+ * first change never move.
+ * The escapes are counted with bitmaps, which suit the vectorised counting
+ * kernels, and written with tables of escape lengths, which are quicker to
+ * look up one byte at a time.
+ */
+
+/* Bytes escaped by bs_escape_c(): controls, '"', '\\' and anything above '~' */
+static const BSbyte rgbEscapeC[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0x04, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x80,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/* The subset of those which have no short escape, and are written in octal */
+static const BSbyte rgbEscapeOctal[32] = {
+	0x7F, 0xC0, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/* Lengths of the escapes written for each byte */
+static const BSbyte rgcchEscapeC[256] = {
+	/* 0x00 */ 4, 4, 4, 4, 4, 4, 4, 2, 2, 2, 2, 2, 2, 2, 4, 4,
+	/* 0x10 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0x20 */ 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x30 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1,
+	/* 0x60 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 4,
+	/* 0x80 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0x90 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0xA0 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0xB0 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0xC0 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0xD0 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0xE0 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	/* 0xF0 */ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+};
+
+/* Short escapes for BEL through CR */
+static const char rgchEscapeShort[] = "abtnvfr";
+
+/* Bytes escaped by bs_escape_percent(): all but RFC 3986 unreserved ones */
+static const BSbyte rgbEscapePercent[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x9F, 0x00, 0xFC,
+	0x01, 0x00, 0x00, 0x78, 0x01, 0x00, 0x00, 0xB8,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/* Lengths of the escapes written for each byte */
+static const BSbyte rgcchEscapePercent[256] = {
+	/* 0x00 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0x10 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0x20 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 1, 1, 3,
+	/* 0x30 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 3, 3,
+	/* 0x40 */ 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 1,
+	/* 0x60 */ 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	/* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 3, 3, 1, 3,
+	/* 0x80 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0x90 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xA0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xB0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xC0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xD0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xE0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	/* 0xF0 */ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+};
+
+static const char rgchHex[] = "0123456789ABCDEF";
+
+BSresult
+bs_substitute(BS *bs, const char *const table[256])
+{
+	size_t rgcchTable[256];
+	size_t cchMax = 1, cbInput, cbOutput = 0, cbShift = 0, iByte;
+	size_t ibRead, ibWrite;
+	int fDeletes = 0, fSwaps = 0;
+	BSbyte *pbRead;
+	BSbyte bCurrent;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(table)
+	BS_ASSERT_VALID(bs)
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		rgcchTable[iByte] = (table[iByte] != NULL) ? strlen(table[iByte]) : 1;
+		if (rgcchTable[iByte] > cchMax) {
+			cchMax = rgcchTable[iByte];
+		}
+		fDeletes |= (rgcchTable[iByte] == 0);
+		fSwaps |= (table[iByte] != NULL) && (rgcchTable[iByte] == 1);
+	}
+
+	cbInput = bs->cbBytes;
+	if (cbInput > (size_t) -1 / cchMax) {
+		return BS_MEMORY;
+	}
+
+	if (!fDeletes) {
+		for (ibRead = 0; ibRead < cbInput; ibRead++) {
+			cbOutput += rgcchTable[bs->pbBytes[ibRead]];
+		}
+
+		result = bs_malloc(bs, cbOutput);
+		if (result != BS_OK) {
+			return result;
+		}
+
+		/*
+		 * Once the output has caught up with the input the rest is already in
+		 * place, unless some bytes are swapped for others of the same length.
+		 */
+		ibRead = cbInput;
+		ibWrite = cbOutput;
+		while ((ibRead > 0) && (fSwaps || (ibWrite > ibRead))) {
+			bCurrent = bs->pbBytes[--ibRead];
+			ibWrite -= rgcchTable[bCurrent];
+			if (table[bCurrent] == NULL) {
+				bs->pbBytes[ibWrite] = bCurrent;
+			} else {
+				memcpy(
+					bs->pbBytes + ibWrite,
+					table[bCurrent],
+					rgcchTable[bCurrent]
+				);
+			}
+		}
+
+		return BS_OK;
+	}
+
+	/*
+	 * Some bytes shrink and others may grow, so neither direction is safe in
+	 * general. Instead find the furthest the output ever runs ahead of the
+	 * input, and move the input up that far before writing forwards.
+	 */
+	for (ibRead = 0; ibRead < cbInput; ibRead++) {
+		cbOutput += rgcchTable[bs->pbBytes[ibRead]];
+		if (cbOutput > ibRead + 1 + cbShift) {
+			cbShift = cbOutput - (ibRead + 1);
+		}
+	}
+
+	if (cbShift > 0) {
+		result = bs_malloc(bs, cbInput + cbShift);
+		if (result != BS_OK) {
+			return result;
+		}
+		memmove(bs->pbBytes + cbShift, bs->pbBytes, cbInput);
+	}
+
+	pbRead = bs->pbBytes + cbShift;
+	ibWrite = 0;
+	for (ibRead = 0; ibRead < cbInput; ibRead++) {
+		bCurrent = pbRead[ibRead];
+		if (table[bCurrent] == NULL) {
+			bs->pbBytes[ibWrite] = bCurrent;
+		} else {
+			memcpy(bs->pbBytes + ibWrite, table[bCurrent], rgcchTable[bCurrent]);
+		}
+		ibWrite += rgcchTable[bCurrent];
+	}
+
+	return bs_malloc(bs, cbOutput);
+}
+
+/*
+ * Counts the bytes which run back from IBREAD and have escapes of length one
+ * in RGCCH. Eight bytes are checked at once where possible, so that long runs
+ * can be moved in one go.
+ */
+static size_t
+clean_run(const BSbyte *pbBytes, size_t ibRead, const BSbyte rgcch[256])
+{
+	const BSbyte *pb;
+	size_t cbRun = 0;
+
+	while (ibRead - cbRun >= 8) {
+		pb = pbBytes + ibRead - cbRun - 8;
+		if ((rgcch[pb[0]] | rgcch[pb[1]] | rgcch[pb[2]] | rgcch[pb[3]]
+		     | rgcch[pb[4]] | rgcch[pb[5]] | rgcch[pb[6]] | rgcch[pb[7]]) != 1) {
+			break;
+		}
+		cbRun += 8;
+	}
+
+	while ((cbRun < ibRead) && (rgcch[pbBytes[ibRead - cbRun - 1]] == 1)) {
+		cbRun++;
+	}
+
+	return cbRun;
+}
+
+BSresult
+bs_escape_c(BS *bs)
+{
+	size_t cbInput, cbOutput, ibRead, ibWrite, cbRun;
+	BSbyte bCurrent;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+
+	/* Escapes add one character, or three for octal ones */
+	cbInput = bs->cbBytes;
+	cbOutput = bs_count_bitmap_bytes(bs->pbBytes, cbInput, rgbEscapeC);
+	if (cbOutput == 0) {
+		return BS_OK;
+	}
+	cbOutput += 2 * bs_count_bitmap_bytes(bs->pbBytes, cbInput, rgbEscapeOctal);
+	if (cbOutput > (size_t) -1 - cbInput) {
+		return BS_MEMORY;
+	}
+	cbOutput += cbInput;
+
+	result = bs_malloc(bs, cbOutput);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	ibRead = cbInput;
+	ibWrite = cbOutput;
+	while (ibWrite > ibRead) {
+		cbRun = clean_run(bs->pbBytes, ibRead, rgcchEscapeC);
+		ibRead -= cbRun;
+		ibWrite -= cbRun;
+		memmove(bs->pbBytes + ibWrite, bs->pbBytes + ibRead, cbRun);
+
+		bCurrent = bs->pbBytes[--ibRead];
+		if (rgcchEscapeC[bCurrent] == 4) {
+			bs->pbBytes[--ibWrite] = '0' + (bCurrent & 7);
+			bs->pbBytes[--ibWrite] = '0' + ((bCurrent >> 3) & 7);
+			bs->pbBytes[--ibWrite] = '0' + (bCurrent >> 6);
+		} else if ((bCurrent >= 0x07) && (bCurrent <= 0x0D)) {
+			bs->pbBytes[--ibWrite] = rgchEscapeShort[bCurrent - 0x07];
+		} else { /* '"' and '\\' escape themselves */
+			bs->pbBytes[--ibWrite] = bCurrent;
+		}
+		bs->pbBytes[--ibWrite] = '\\';
+	}
+
+	return BS_OK;
+}
+
+BSresult
+bs_escape_percent(BS *bs)
+{
+	size_t cbInput, cbOutput, ibRead, ibWrite, cbRun;
+	BSbyte bCurrent;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_ASSERT_VALID(bs)
+
+	/* Escapes add two characters */
+	cbInput = bs->cbBytes;
+	cbOutput = bs_count_bitmap_bytes(bs->pbBytes, cbInput, rgbEscapePercent);
+	if (cbOutput == 0) {
+		return BS_OK;
+	}
+	if (cbOutput > ((size_t) -1 - cbInput) / 2) {
+		return BS_MEMORY;
+	}
+	cbOutput = cbInput + 2 * cbOutput;
+
+	result = bs_malloc(bs, cbOutput);
+	if (result != BS_OK) {
+		return result;
+	}
+
+	ibRead = cbInput;
+	ibWrite = cbOutput;
+	while (ibWrite > ibRead) {
+		cbRun = clean_run(bs->pbBytes, ibRead, rgcchEscapePercent);
+		ibRead -= cbRun;
+		ibWrite -= cbRun;
+		memmove(bs->pbBytes + ibWrite, bs->pbBytes + ibRead, cbRun);
+
+		bCurrent = bs->pbBytes[--ibRead];
+		bs->pbBytes[--ibWrite] = rgchHex[bCurrent & 0x0F];
+		bs->pbBytes[--ibWrite] = rgchHex[bCurrent >> 4];
+		bs->pbBytes[--ibWrite] = '%';
+	}
+
+	return BS_OK;
+}
+
+/*
+ * Finds the first occurrence of the CBFIND bytes at PBFIND within the CBINPUT
+ * bytes at PBINPUT, returning NULL if there is none.
+ */
+static const BSbyte *
+find_bytes(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	const BSbyte *pbFind,
+	size_t cbFind
+)
+{
+	const BSbyte *pbMatch;
+
+	while (cbInput >= cbFind) {
+		/* Look for the first byte, then check the rest */
+		pbMatch = memchr(pbInput, pbFind[0], cbInput - cbFind + 1);
+		if (pbMatch == NULL) {
+			return NULL;
+		}
+		if (memcmp(pbMatch + 1, pbFind + 1, cbFind - 1) == 0) {
+			return pbMatch;
+		}
+
+		cbInput -= (size_t) (pbMatch - pbInput) + 1;
+		pbInput = pbMatch + 1;
+	}
+
+	return NULL;
+}
+
+BSresult
+bs_replace(
+	BS *bs,
+	const BSbyte *find,
+	size_t cbFind,
+	const BSbyte *replacement,
+	size_t cbReplacement
+)
+{
+	const BSbyte *pbRead, *pbEnd, *pbMatch;
+	size_t cbInput, cMatches = 0, cbShift = 0, ibWrite = 0;
+	BSresult result;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(find)
+	BS_CHECK_POINTER(replacement)
+	BS_ASSERT_VALID(bs)
+
+	if (cbFind == 0) {
+		return BS_INVALID;
+	}
+
+	cbInput = bs->cbBytes;
+	if (cbInput < cbFind) {
+		return BS_OK;
+	}
+
+	pbRead = bs->pbBytes;
+	pbEnd = bs->pbBytes + cbInput;
+	while ((pbMatch = find_bytes(pbRead, pbEnd - pbRead, find, cbFind)) != NULL) {
+		cMatches++;
+		pbRead = pbMatch + cbFind;
+	}
+
+	if (cMatches == 0) {
+		return BS_OK;
+	}
+
+	/*
+	 * Matches must be found left to right, so the stream is always rewritten
+	 * forwards. If it grows then move the input up out of the way first.
+	 */
+	if (cbReplacement > cbFind) {
+		if (cbReplacement - cbFind > ((size_t) -1 - cbInput) / cMatches) {
+			return BS_MEMORY;
+		}
+		cbShift = cMatches * (cbReplacement - cbFind);
+
+		result = bs_malloc(bs, cbInput + cbShift);
+		if (result != BS_OK) {
+			return result;
+		}
+		memmove(bs->pbBytes + cbShift, bs->pbBytes, cbInput);
+	}
+
+	pbRead = bs->pbBytes + cbShift;
+	pbEnd = pbRead + cbInput;
+	while (cMatches > 0) {
+		pbMatch = find_bytes(pbRead, pbEnd - pbRead, find, cbFind);
+
+		memmove(bs->pbBytes + ibWrite, pbRead, pbMatch - pbRead);
+		ibWrite += pbMatch - pbRead;
+		memcpy(bs->pbBytes + ibWrite, replacement, cbReplacement);
+		ibWrite += cbReplacement;
+
+		pbRead = pbMatch + cbFind;
+		cMatches--;
+	}
+
+	memmove(bs->pbBytes + ibWrite, pbRead, pbEnd - pbRead);
+	ibWrite += pbEnd - pbRead;
+
+	return bs_malloc(bs, ibWrite);
+}
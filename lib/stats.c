@@ -0,0 +1,394 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "bs_internal.h"
+#include "cpu.h"
+#include "pool.h"
+#include <math.h>
+#include <string.h>
+
+/*
+ * Histograms are counted into several interleaved tables so that runs of the
+ * same byte don't make each increment wait for the store before it. Counters
+ * are only 32 bits wide to keep the tables in L1, so the input is counted in
+ * chunks small enough that they can't overflow.
+ */
+#define C_HISTOGRAM_TABLES 4
+#define CB_HISTOGRAM_CHUNK ((size_t) 1 << 30)
+
+static void
+histogram_tables(
+	const BSbyte *pbInput,
+	size_t cbInput,
+	uint32_t rgrgcCounts[C_HISTOGRAM_TABLES][256]
+)
+{
+	size_t ibRead = 0;
+
+	while (cbInput - ibRead >= 8) {
+		rgrgcCounts[0][pbInput[ibRead    ]]++;
+		rgrgcCounts[1][pbInput[ibRead + 1]]++;
+		rgrgcCounts[2][pbInput[ibRead + 2]]++;
+		rgrgcCounts[3][pbInput[ibRead + 3]]++;
+		rgrgcCounts[0][pbInput[ibRead + 4]]++;
+		rgrgcCounts[1][pbInput[ibRead + 5]]++;
+		rgrgcCounts[2][pbInput[ibRead + 6]]++;
+		rgrgcCounts[3][pbInput[ibRead + 7]]++;
+		ibRead += 8;
+	}
+	while (ibRead < cbInput) {
+		rgrgcCounts[0][pbInput[ibRead]]++;
+		ibRead++;
+	}
+}
+
+/* Adds the tables into COUNTS and clears them again */
+static void
+histogram_flush(
+	uint32_t rgrgcCounts[C_HISTOGRAM_TABLES][256],
+	uint64_t counts[256]
+)
+{
+	unsigned int iByte;
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		counts[iByte] += (uint64_t) rgrgcCounts[0][iByte]
+		               + rgrgcCounts[1][iByte]
+		               + rgrgcCounts[2][iByte]
+		               + rgrgcCounts[3][iByte];
+	}
+	memset(rgrgcCounts, 0, C_HISTOGRAM_TABLES * 256 * sizeof(uint32_t));
+}
+
+void
+bs_histogram_bytes(const BSbyte *pbInput, size_t cbInput, uint64_t counts[256])
+{
+	uint32_t rgrgcCounts[C_HISTOGRAM_TABLES][256];
+	size_t cbChunk;
+
+	memset(rgrgcCounts, 0, sizeof(rgrgcCounts));
+
+	while (cbInput > 0) {
+		cbChunk = cbInput < CB_HISTOGRAM_CHUNK ? cbInput : CB_HISTOGRAM_CHUNK;
+		histogram_tables(pbInput, cbChunk, rgrgcCounts);
+		histogram_flush(rgrgcCounts, counts);
+		pbInput += cbChunk;
+		cbInput -= cbChunk;
+	}
+}
+
+BSresult
+bs_histogram(const BS *bs, uint64_t counts[256])
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(counts)
+	BS_ASSERT_VALID(bs)
+
+	memset(counts, 0, 256 * sizeof(uint64_t));
+	bs_histogram_bytes(bs->pbBytes, bs->cbBytes, counts);
+
+	return BS_OK;
+}
+
+/*
+ * Parallel histograms give each range its own table of counts, which are added
+ * together at the end.
+ */
+
+static BSresult
+histogram_range(const BSbyte *block, size_t length, void *value, void *data)
+{
+	UNUSED(data);
+
+	bs_histogram_bytes(block, length, value);
+	return BS_OK;
+}
+
+static BSresult
+add_histograms(void *value, const void *other, void *data)
+{
+	uint64_t *counts = value;
+	const uint64_t *otherCounts = other;
+	unsigned int iByte;
+
+	UNUSED(data);
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		counts[iByte] += otherCounts[iByte];
+	}
+	return BS_OK;
+}
+
+static const uint64_t rgcZero[256] = { 0 };
+
+BSresult
+bs_histogram_parallel(const BS *bs, uint64_t counts[256], BSpool *pool)
+{
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(counts)
+
+	return bs_fold_parallel(
+		bs,
+		counts,
+		sizeof(rgcZero),
+		rgcZero,
+		histogram_range,
+		add_histograms,
+		NULL,
+		pool
+	);
+}
+
+BSresult
+bs_histogram_entropy(const uint64_t counts[256], double *entropy)
+{
+	double total = 0.0, sum = 0.0;
+	unsigned int iByte;
+
+	BS_CHECK_POINTER(counts)
+	BS_CHECK_POINTER(entropy)
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		total += (double) counts[iByte];
+	}
+	if (total == 0.0) {
+		*entropy = 0.0;
+		return BS_OK;
+	}
+
+	/* -sum(p log p) = log n - sum(c log c) / n, taking logs to base 2 */
+	for (iByte = 0; iByte < 256; iByte++) {
+		if (counts[iByte] != 0) {
+			sum += (double) counts[iByte] * log((double) counts[iByte]);
+		}
+	}
+
+	*entropy = (log(total) - sum / total) / log(2.0);
+	if (*entropy < 0.0) {
+		*entropy = 0.0;  /* Rounding when only one byte value is present */
+	}
+	return BS_OK;
+}
+
+BSresult
+bs_histogram_chi_squared(const uint64_t counts[256], double *chi_squared)
+{
+	double total = 0.0, expected, difference, sum = 0.0;
+	unsigned int iByte;
+
+	BS_CHECK_POINTER(counts)
+	BS_CHECK_POINTER(chi_squared)
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		total += (double) counts[iByte];
+	}
+	if (total == 0.0) {
+		*chi_squared = 0.0;
+		return BS_OK;
+	}
+
+	expected = total / 256.0;
+	for (iByte = 0; iByte < 256; iByte++) {
+		difference = (double) counts[iByte] - expected;
+		sum += difference * difference;
+	}
+
+	*chi_squared = sum / expected;
+	return BS_OK;
+}
+
+/*
+ * Minimum and maximum kernels
+ * Each works through whole vectors only, returning the number of bytes read
+ * and narrowing *PMIN and *PMAX to take in the bytes read.
+ */
+
+#ifdef BS_SIMD_X86
+
+static BS_TARGET("sse2") size_t
+minmax_sse2(const BSbyte *pbInput, size_t cbInput, BSbyte *pMin, BSbyte *pMax)
+{
+	__m128i vMin = _mm_set1_epi8((char) *pMin);
+	__m128i vMax = _mm_set1_epi8((char) *pMax);
+	__m128i vInput;
+	BSbyte rgbMin[16], rgbMax[16];
+	size_t ibRead = 0;
+	unsigned int iLane;
+
+	while (cbInput - ibRead >= 16) {
+		vInput = _mm_loadu_si128((const __m128i *) (pbInput + ibRead));
+		vMin = _mm_min_epu8(vMin, vInput);
+		vMax = _mm_max_epu8(vMax, vInput);
+		ibRead += 16;
+	}
+
+	_mm_storeu_si128((__m128i *) rgbMin, vMin);
+	_mm_storeu_si128((__m128i *) rgbMax, vMax);
+	for (iLane = 0; iLane < 16; iLane++) {
+		if (rgbMin[iLane] < *pMin) {
+			*pMin = rgbMin[iLane];
+		}
+		if (rgbMax[iLane] > *pMax) {
+			*pMax = rgbMax[iLane];
+		}
+	}
+	return ibRead;
+}
+
+static BS_TARGET("avx2") size_t
+minmax_avx2(const BSbyte *pbInput, size_t cbInput, BSbyte *pMin, BSbyte *pMax)
+{
+	__m256i vMinA = _mm256_set1_epi8((char) *pMin), vMinB = vMinA;
+	__m256i vMaxA = _mm256_set1_epi8((char) *pMax), vMaxB = vMaxA;
+	__m256i vInputA, vInputB;
+	BSbyte rgbMin[32], rgbMax[32];
+	size_t ibRead = 0;
+	unsigned int iLane;
+
+	while (cbInput - ibRead >= 64) {
+		vInputA = _mm256_loadu_si256((const __m256i *) (pbInput + ibRead));
+		vInputB = _mm256_loadu_si256((const __m256i *) (pbInput + ibRead + 32));
+		vMinA = _mm256_min_epu8(vMinA, vInputA);
+		vMinB = _mm256_min_epu8(vMinB, vInputB);
+		vMaxA = _mm256_max_epu8(vMaxA, vInputA);
+		vMaxB = _mm256_max_epu8(vMaxB, vInputB);
+		ibRead += 64;
+	}
+
+	_mm256_storeu_si256((__m256i *) rgbMin, _mm256_min_epu8(vMinA, vMinB));
+	_mm256_storeu_si256((__m256i *) rgbMax, _mm256_max_epu8(vMaxA, vMaxB));
+	for (iLane = 0; iLane < 32; iLane++) {
+		if (rgbMin[iLane] < *pMin) {
+			*pMin = rgbMin[iLane];
+		}
+		if (rgbMax[iLane] > *pMax) {
+			*pMax = rgbMax[iLane];
+		}
+	}
+	return ibRead;
+}
+
+#endif /* BS_SIMD_X86 */
+
+static void
+minmax_bytes(const BSbyte *pbInput, size_t cbInput, BSbyte *pMin, BSbyte *pMax)
+{
+	size_t ibRead = 0;
+#ifdef BS_SIMD_X86
+	unsigned int grfFeatures = bs_cpu_features();
+
+	if (grfFeatures & BS_CPU_AVX2) {
+		ibRead = minmax_avx2(pbInput, cbInput, pMin, pMax);
+	}
+	if (grfFeatures & BS_CPU_SSE2) {
+		ibRead += minmax_sse2(pbInput + ibRead, cbInput - ibRead, pMin, pMax);
+	}
+#endif
+
+	while (ibRead < cbInput) {
+		if (pbInput[ibRead] < *pMin) {
+			*pMin = pbInput[ibRead];
+		}
+		if (pbInput[ibRead] > *pMax) {
+			*pMax = pbInput[ibRead];
+		}
+		ibRead++;
+	}
+}
+
+/*
+ * Blocks are sized to stay in cache while every requested statistic reads
+ * them, so each byte comes from memory only once.
+ */
+#define CB_STATS_BLOCK 32768
+
+BSresult
+bs_stats(const BS *bs, unsigned int stats, BSstats *result)
+{
+	uint32_t rgrgcCounts[C_HISTOGRAM_TABLES][256];
+	const BSbyte *pbBlock;
+	size_t cbLeft, cbBlock, cbCounted = 0;
+	BSbyte bMin = 255, bMax = 0;
+
+	BS_CHECK_POINTER(bs)
+	BS_CHECK_POINTER(result)
+	BS_ASSERT_VALID(bs)
+
+	if (stats & ~(unsigned int) BS_STAT_ALL) {
+		return BS_INVALID;
+	}
+
+	if (stats & BS_STAT_SUM) {
+		result->sum = 0;
+	}
+	if (stats & BS_STAT_POPCOUNT) {
+		result->popcount = 0;
+	}
+	if (stats & BS_STAT_HISTOGRAM) {
+		memset(result->counts, 0, sizeof(result->counts));
+		memset(rgrgcCounts, 0, sizeof(rgrgcCounts));
+	}
+
+	pbBlock = bs->pbBytes;
+	cbLeft = bs->cbBytes;
+	while (cbLeft > 0) {
+		cbBlock = cbLeft < CB_STATS_BLOCK ? cbLeft : CB_STATS_BLOCK;
+
+		if (stats & BS_STAT_SUM) {
+			result->sum += bs_sum_bytes(pbBlock, cbBlock);
+		}
+		if (stats & BS_STAT_POPCOUNT) {
+			result->popcount += bs_popcount_bytes(pbBlock, cbBlock);
+		}
+		if (stats & (BS_STAT_MIN | BS_STAT_MAX)) {
+			minmax_bytes(pbBlock, cbBlock, &bMin, &bMax);
+		}
+		if (stats & BS_STAT_HISTOGRAM) {
+			/* The tables are only flushed as often as they need to be */
+			histogram_tables(pbBlock, cbBlock, rgrgcCounts);
+			cbCounted += cbBlock;
+			if (cbCounted >= CB_HISTOGRAM_CHUNK) {
+				histogram_flush(rgrgcCounts, result->counts);
+				cbCounted = 0;
+			}
+		}
+
+		pbBlock += cbBlock;
+		cbLeft -= cbBlock;
+	}
+
+	if (stats & BS_STAT_HISTOGRAM) {
+		histogram_flush(rgrgcCounts, result->counts);
+	}
+	if (stats & BS_STAT_MIN) {
+		result->min = bMin;
+	}
+	if (stats & BS_STAT_MAX) {
+		result->max = bMax;
+	}
+	return BS_OK;
+}
@@ -75,7 +75,7 @@ bs_stream(
 
 	/* Loop over each chunk */
 	while (cbRemaining >= bs->cbBytes) {
-		memcpy(bs->pbBytes, stream + length - cbRemaining, cbSpace);
+		memcpy(bs->pbBytes, stream + length - cbRemaining, bs->cbBytes);
 		cbRemaining -= bs->cbBytes;
 
 		result = operation(bs, data);
@@ -101,6 +101,7 @@ bs_stream_flush(
 )
 {
 	BS *bsOutput;
+	BSresult result;
 
 	BS_CHECK_POINTER(bs)
 	BS_ASSERT_VALID(bs)
@@ -117,7 +118,9 @@ bs_stream_flush(
 	memcpy(bsOutput->pbBytes, bs->pbBytes, bs->cbStream);
 	bs->cbStream = 0;
 
-	return operation(bsOutput, data);
+	result = operation(bsOutput, data);
+	bs_free(bsOutput);
+	return result;
 }
 
 void
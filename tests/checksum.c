@@ -0,0 +1,344 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "input.h"
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Long enough for every path through the kernels, with some left over */
+#define CB_LONG (3 * 64 + 7)
+
+/* Long enough for sums to be reduced part way through */
+#define CB_HUGE ((1 << 23) + 4099)
+
+#define C_CPU_LEVELS 3
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	~0u
+};
+
+/* Fletcher-16 checksums are widened so all the checksums look alike */
+static BSresult
+fletcher16(const BS *bs, uint32_t *checksum)
+{
+	uint16_t fletcher = 0;
+	BSresult result = bs_fletcher16(bs, checksum ? &fletcher : NULL);
+
+	if (checksum && result == BS_OK) {
+		*checksum = fletcher;
+	}
+	return result;
+}
+
+static BSresult
+fletcher16_update(const BS *bs, uint32_t *checksum)
+{
+	uint16_t fletcher = checksum ? (uint16_t) *checksum : 0;
+	BSresult result = bs_fletcher16_update(bs, checksum ? &fletcher : NULL);
+
+	if (checksum && result == BS_OK) {
+		*checksum = fletcher;
+	}
+	return result;
+}
+
+struct BSChecksumType {
+	BSresult (*fpChecksum) (const BS *bs, uint32_t *checksum);
+	BSresult (*fpUpdate) (const BS *bs, uint32_t *checksum);
+	uint32_t initial;         /* Checksum of an empty stream */
+	uint32_t modulus;
+	unsigned int cbValue;     /* Bytes summed at a time */
+	unsigned int cBitsSum;    /* Width of each sum in the checksum */
+};
+
+static const struct BSChecksumType rgChecksumTypes[] = {
+	{ bs_adler32,    bs_adler32_update,    1, 65521, 1, 16 },
+	{ fletcher16,    fletcher16_update,    0,   255, 1,  8 },
+	{ bs_fletcher32, bs_fletcher32_update, 0, 65535, 2, 16 }
+};
+
+struct BSChecksumTestcase {
+	size_t iType;
+	const char *input;
+	size_t length;
+	uint32_t checksum;
+};
+
+static const struct BSChecksumTestcase rgTestcases[] = {
+	{ 0, "",          0, 0x00000001 },
+	{ 0, "a",         1, 0x00620062 },
+	{ 0, "Wikipedia", 9, 0x11E60398 },
+	{ 0, "The quick brown fox jumps over the lazy dog", 43, 0x5BDC0FDA },
+	{ 1, "",          0, 0x0000 },
+	{ 1, "abcde",     5, 0xC8F0 },
+	{ 1, "abcdef",    6, 0x2057 },
+	{ 1, "abcdefgh",  8, 0x0627 },
+	{ 2, "",          0, 0x00000000 },
+	{ 2, "abcde",     5, 0xF04FC729 },
+	{ 2, "abcdef",    6, 0x56502D2A },
+	{ 2, "abcdefgh",  8, 0xEBE19591 }
+};
+
+/* ========================== */
+/* Functions used for testing */
+/* ========================== */
+
+/* Every byte at its largest, the worst case for overflow */
+static BS *
+create_full_input(size_t cbInput)
+{
+	BS *bs = bs_create_size(cbInput);
+
+	memset(bs_get_buffer(bs), 0xFF, cbInput);
+	return bs;
+}
+
+/* Checksums CBINPUT bytes the slow way, reducing after every value */
+static uint32_t
+reference_checksum(size_t iType, const BSbyte *pbInput, size_t cbInput)
+{
+	const struct BSChecksumType *type = &rgChecksumTypes[iType];
+	uint32_t sum1 = type->initial, sum2 = 0, value;
+	size_t ibInput;
+
+	for (ibInput = 0; ibInput < cbInput; ibInput += type->cbValue) {
+		value = pbInput[ibInput];
+		if (type->cbValue == 2 && ibInput + 1 < cbInput) {
+			value |= (uint32_t) pbInput[ibInput + 1] << 8;
+		}
+		sum1 = (sum1 + value) % type->modulus;
+		sum2 = (sum2 + sum1) % type->modulus;
+	}
+
+	return (sum2 << type->cBitsSum) | sum1;
+}
+
+/* Checksums the first CBINPUT bytes of BS, in up to two pieces */
+static uint32_t
+checksum_prefix(size_t iType, const BS *bs, size_t cbInput, size_t cbFirst)
+{
+	BS *bsPiece = bs_create();
+	uint32_t checksum = rgChecksumTypes[iType].initial;
+
+	bs_load(bsPiece, bs_get_buffer(bs), cbFirst);
+	if (cbFirst > 0) {
+		rgChecksumTypes[iType].fpUpdate(bsPiece, &checksum);
+	}
+	bs_load(bsPiece, bs_get_buffer(bs) + cbFirst, cbInput - cbFirst);
+	if (cbInput > cbFirst) {
+		rgChecksumTypes[iType].fpUpdate(bsPiece, &checksum);
+	}
+
+	bs_free(bsPiece);
+	return checksum;
+}
+
+/* ============== */
+/* Checksum tests */
+/* ============== */
+
+START_TEST(test_checksum)
+{
+	const struct BSChecksumTestcase *tc = &rgTestcases[_i];
+	BS *bs = bs_create();
+	uint32_t checksum;
+	size_t iLevel;
+	BSresult result;
+
+	bs_load(bs, (const BSbyte *) tc->input, tc->length);
+
+	for (iLevel = 0; iLevel < C_CPU_LEVELS; iLevel++) {
+		bs_cpu_limit(rgCpuLevels[iLevel]);
+
+		checksum = 0xDEADBEEF;
+		result = rgChecksumTypes[tc->iType].fpChecksum(bs, &checksum);
+		fail_unless(result == BS_OK);
+		fail_unless(checksum == tc->checksum);
+	}
+
+	bs_cpu_limit(~0u);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_checksum_cpu_levels)
+{
+	size_t iType = _i / C_CPU_LEVELS;
+	BS *bs = create_input(CB_LONG);
+	BS *bsPrefix = bs_create();
+	uint32_t checksum;
+	size_t cbInput;
+	BSresult result;
+
+	bs_cpu_limit(rgCpuLevels[_i % C_CPU_LEVELS]);
+
+	for (cbInput = 1; cbInput <= CB_LONG; cbInput++) {
+		bs_load(bsPrefix, bs_get_buffer(bs), cbInput);
+
+		result = rgChecksumTypes[iType].fpChecksum(bsPrefix, &checksum);
+		fail_unless(result == BS_OK);
+		fail_unless(
+			checksum == reference_checksum(iType, bs_get_buffer(bs), cbInput)
+		);
+	}
+
+	bs_cpu_limit(~0u);
+	bs_free(bsPrefix);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_checksum_huge)
+{
+	size_t iType = _i / C_CPU_LEVELS;
+	BS *bs = create_full_input(CB_HUGE);
+	uint32_t checksum;
+	BSresult result;
+
+	bs_cpu_limit(rgCpuLevels[_i % C_CPU_LEVELS]);
+
+	result = rgChecksumTypes[iType].fpChecksum(bs, &checksum);
+	fail_unless(result == BS_OK);
+	fail_unless(
+		checksum == reference_checksum(iType, bs_get_buffer(bs), CB_HUGE)
+	);
+
+	bs_cpu_limit(~0u);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_checksum_update)
+{
+	const struct BSChecksumType *type = &rgChecksumTypes[_i];
+	BS *bs = create_input(CB_LONG);
+	uint32_t checksumExpected;
+	size_t cbFirst;
+
+	/* Pieces give the same result wherever the message is split */
+	checksumExpected = checksum_prefix(_i, bs, CB_LONG, 0);
+	for (cbFirst = 1; cbFirst < CB_LONG; cbFirst++) {
+		if (cbFirst % type->cbValue == 0) {
+			fail_unless(
+				checksum_prefix(_i, bs, CB_LONG, cbFirst) == checksumExpected
+			);
+		}
+	}
+
+	/* Updating with nothing changes nothing */
+	fail_unless(
+		checksum_prefix(_i, bs, 100, 100) == checksum_prefix(_i, bs, 100, 0)
+	);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_checksum_update_empty_bs)
+{
+	BS *bs = bs_create();
+	uint32_t checksum = 0x1234;
+	BSresult result;
+
+	result = rgChecksumTypes[_i].fpUpdate(bs, &checksum);
+	fail_unless(result == BS_OK);
+	fail_unless(checksum == 0x1234);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_checksum_null_bs)
+{
+	uint32_t checksum = 0x1234;
+	BSresult result;
+
+	result = rgChecksumTypes[_i].fpChecksum(NULL, &checksum);
+	fail_unless(result == BS_NULL);
+	fail_unless(checksum == 0x1234);
+
+	result = rgChecksumTypes[_i].fpUpdate(NULL, &checksum);
+	fail_unless(result == BS_NULL);
+	fail_unless(checksum == 0x1234);
+}
+END_TEST
+
+START_TEST(test_checksum_null_checksum)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = rgChecksumTypes[_i].fpChecksum(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	result = rgChecksumTypes[_i].fpUpdate(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+int
+main(/* int argc, char **argv */)
+{
+	Suite *s = suite_create("Checksums");
+	TCase *tc_core = tcase_create("Core");
+	size_t cTestcases =
+		sizeof(rgTestcases) / sizeof(struct BSChecksumTestcase);
+	size_t cTypes = sizeof(rgChecksumTypes) / sizeof(struct BSChecksumType);
+	SRunner *sr;
+	int number_failed;
+
+	tcase_add_loop_test(tc_core, test_checksum, 0, cTestcases);
+	tcase_add_loop_test(
+		tc_core,
+		test_checksum_cpu_levels,
+		0,
+		cTypes * C_CPU_LEVELS
+	);
+	tcase_add_loop_test(
+		tc_core,
+		test_checksum_huge,
+		0,
+		cTypes * C_CPU_LEVELS
+	);
+	tcase_add_loop_test(tc_core, test_checksum_update,          0, cTypes);
+	tcase_add_loop_test(tc_core, test_checksum_update_empty_bs, 0, cTypes);
+	tcase_add_loop_test(tc_core, test_checksum_null_bs,         0, cTypes);
+	tcase_add_loop_test(tc_core, test_checksum_null_checksum,   0, cTypes);
+
+	suite_add_tcase(s, tc_core);
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -44,6 +44,12 @@ overwrite_byte(BSbyte byte1, BSbyte byte2)
 	return byte2;
 }
 
+static BSbyte
+add_byte(BSbyte byte1, BSbyte byte2)
+{
+	return byte1 + byte2;
+}
+
 static BSresult
 combine_overwrite(BS *bs, const BS *operand)
 {
@@ -207,6 +213,60 @@ START_TEST(test_combinations_null_operand)
 END_TEST
 
 
+/* ============================= */
+/* Out-of-place combination test */
+/* ============================= */
+
+START_TEST(test_combine_to)
+{
+	BS *src = bs_create(), *operand = bs_create(), *dst = bs_create();
+
+	bs_load(src, (BSbyte *) "abcde", 5);
+	bs_load(operand, (BSbyte *) "\x01\x02", 2);
+
+	fail_unless(bs_combine_to(dst, src, operand, overwrite_byte) == BS_OK);
+	fail_unless(bs_size(dst) == 5);
+	fail_unless(memcmp(bs_get_buffer(dst), "\x01\x02\x01\x02\x01", 5) == 0);
+	fail_unless(memcmp(bs_get_buffer(src), "abcde", 5) == 0);
+	fail_unless(memcmp(bs_get_buffer(operand), "\x01\x02", 2) == 0);
+
+	bs_free(src);
+	bs_free(operand);
+	bs_free(dst);
+}
+END_TEST
+
+
+/* ============= */
+/* Parallel test */
+/* ============= */
+
+#define CB_PARALLEL (5 * 65536 + 123)
+
+START_TEST(test_combine_parallel)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = bs_create_size(CB_PARALLEL);
+	BS *expected = bs_create_size(CB_PARALLEL);
+	BS *operand = bs_create();
+
+	/* An operand length which doesn't divide the range size */
+	bs_load(operand, (BSbyte *) "\x01\x02\x03\x04\x05\x06\x07", 7);
+	bs_zero(bs);
+	bs_zero(expected);
+
+	fail_unless(bs_combine_parallel(bs, operand, add_byte, pool) == BS_OK);
+	bs_combine_add(expected, operand);
+	fail_unless(bs_compare_equal(bs, expected) == BS_OK);
+
+	bs_free(bs);
+	bs_free(expected);
+	bs_free(operand);
+	bs_pool_free(pool);
+}
+END_TEST
+
+
 /* ==================== */
 /* NULL parameter tests */
 /* ==================== */
@@ -248,6 +308,32 @@ START_TEST(test_generic_combination_null_operation)
 }
 END_TEST
 
+START_TEST(test_combine_to_null_dst)
+{
+	BS *bs = bs_create(), *operand = bs_create();
+	BSresult result;
+
+	result = bs_combine_to(NULL, bs, operand, overwrite_byte);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+	bs_free(operand);
+}
+END_TEST
+
+START_TEST(test_combine_to_null_src)
+{
+	BS *bs = bs_create(), *operand = bs_create();
+	BSresult result;
+
+	result = bs_combine_to(bs, NULL, operand, overwrite_byte);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+	bs_free(operand);
+}
+END_TEST
+
 
 int
 main(/* int argc, char **argv */)
@@ -265,9 +351,14 @@ main(/* int argc, char **argv */)
 	tcase_add_loop_test(tc_core, test_combinations_null_bs,          0, C_COMBINATIONS);
 	tcase_add_loop_test(tc_core, test_combinations_null_operand,     0, C_COMBINATIONS);
 
+	tcase_add_test(tc_core, test_combine_to);
+	tcase_add_loop_test(tc_core, test_combine_parallel, 0, 2);
+
 	tcase_add_test(tc_core, test_generic_combination_null_bs);
 	tcase_add_test(tc_core, test_generic_combination_null_operand);
 	tcase_add_test(tc_core, test_generic_combination_null_operation);
+	tcase_add_test(tc_core, test_combine_to_null_dst);
+	tcase_add_test(tc_core, test_combine_to_null_src);
 
 	suite_add_tcase(s, tc_core);
 	sr = srunner_create(s);
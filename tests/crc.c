@@ -0,0 +1,250 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "input.h"
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Long enough for every path through the fastest kernels */
+#define CB_LONG (3 * 8192 + 3 * 256 + 100)
+
+#define C_CPU_LEVELS 4
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	BS_CPU_SSE2 | BS_CPU_SSE42 | BS_CPU_PCLMUL,
+	~0u
+};
+
+struct BSCrcType {
+	BSresult (*fpCrc) (const BS *bs, uint32_t *crc);
+	BSresult (*fpUpdate) (const BS *bs, uint32_t *crc);
+};
+
+static const struct BSCrcType rgCrcTypes[] = {
+	{ bs_crc32,  bs_crc32_update  },
+	{ bs_crc32c, bs_crc32c_update }
+};
+
+struct BSCrcTestcase {
+	size_t iType;
+	const char *input;
+	size_t length;
+	uint32_t crc;
+};
+
+static const struct BSCrcTestcase rgTestcases[] = {
+	{ 0, "",           0, 0x00000000 },
+	{ 0, "a",          1, 0xE8B7BE43 },
+	{ 0, "123456789",  9, 0xCBF43926 },
+	{ 0, "The quick brown fox jumps over the lazy dog", 43, 0x414FA339 },
+	{ 1, "",           0, 0x00000000 },
+	{ 1, "a",          1, 0xC1D04330 },
+	{ 1, "123456789",  9, 0xE3069283 },
+	{ 1, "The quick brown fox jumps over the lazy dog", 43, 0x22620404 },
+	/* From RFC 3720, appendix B.4 */
+	{ 1, "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+	     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 32, 0x8A9136AA },
+	{ 1, "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F"
+	     "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F",
+	  32, 0x46DD794E }
+};
+
+/* ========================== */
+/* Functions used for testing */
+/* ========================== */
+
+/* Checksums the first CBINPUT bytes of BS, in up to two pieces */
+static uint32_t
+crc_prefix(size_t iType, const BS *bs, size_t cbInput, size_t cbFirst)
+{
+	BS *bsPiece = bs_create();
+	uint32_t crc = 0;
+
+	bs_load(bsPiece, bs_get_buffer(bs), cbFirst);
+	if (cbFirst > 0) {
+		rgCrcTypes[iType].fpUpdate(bsPiece, &crc);
+	}
+	bs_load(bsPiece, bs_get_buffer(bs) + cbFirst, cbInput - cbFirst);
+	if (cbInput > cbFirst) {
+		rgCrcTypes[iType].fpUpdate(bsPiece, &crc);
+	}
+
+	bs_free(bsPiece);
+	return crc;
+}
+
+/* ========= */
+/* CRC tests */
+/* ========= */
+
+START_TEST(test_crc)
+{
+	const struct BSCrcTestcase *tc = &rgTestcases[_i];
+	BS *bs = bs_create();
+	uint32_t crc;
+	size_t iLevel;
+	BSresult result;
+
+	bs_load(bs, (const BSbyte *) tc->input, tc->length);
+
+	for (iLevel = 0; iLevel < C_CPU_LEVELS; iLevel++) {
+		bs_cpu_limit(rgCpuLevels[iLevel]);
+
+		crc = 0xDEADBEEF;
+		result = rgCrcTypes[tc->iType].fpCrc(bs, &crc);
+		fail_unless(result == BS_OK);
+		fail_unless(crc == tc->crc);
+	}
+
+	bs_cpu_limit(~0u);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_crc_cpu_levels)
+{
+	size_t iType = _i / C_CPU_LEVELS;
+	BS *bs = create_input(CB_LONG);
+	BS *bsPrefix = bs_create();
+	uint32_t crc, crcExpected;
+	size_t cbInput;
+	BSresult result;
+
+	for (cbInput = 1; cbInput <= CB_LONG; cbInput += 1 + cbInput / 8) {
+		bs_load(bsPrefix, bs_get_buffer(bs), cbInput);
+
+		bs_cpu_limit(0);
+		rgCrcTypes[iType].fpCrc(bsPrefix, &crcExpected);
+
+		bs_cpu_limit(rgCpuLevels[_i % C_CPU_LEVELS]);
+		result = rgCrcTypes[iType].fpCrc(bsPrefix, &crc);
+		fail_unless(result == BS_OK);
+		fail_unless(crc == crcExpected);
+	}
+
+	bs_cpu_limit(~0u);
+	bs_free(bsPrefix);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_crc_update)
+{
+	BS *bs = create_input(CB_LONG);
+	uint32_t crcExpected;
+	size_t cbFirst;
+
+	/* Pieces give the same result wherever the message is split */
+	crcExpected = crc_prefix(_i, bs, CB_LONG, 0);
+	for (cbFirst = 1; cbFirst < CB_LONG; cbFirst += 1 + cbFirst / 4) {
+		fail_unless(crc_prefix(_i, bs, CB_LONG, cbFirst) == crcExpected);
+	}
+
+	/* Updating with nothing changes nothing */
+	fail_unless(crc_prefix(_i, bs, 100, 100) == crc_prefix(_i, bs, 100, 0));
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_crc_update_empty_bs)
+{
+	BS *bs = bs_create();
+	uint32_t crc = 0x12345678;
+	BSresult result;
+
+	result = rgCrcTypes[_i].fpUpdate(bs, &crc);
+	fail_unless(result == BS_OK);
+	fail_unless(crc == 0x12345678);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_crc_null_bs)
+{
+	uint32_t crc = 0x12345678;
+	BSresult result;
+
+	result = rgCrcTypes[_i].fpCrc(NULL, &crc);
+	fail_unless(result == BS_NULL);
+	fail_unless(crc == 0x12345678);
+
+	result = rgCrcTypes[_i].fpUpdate(NULL, &crc);
+	fail_unless(result == BS_NULL);
+	fail_unless(crc == 0x12345678);
+}
+END_TEST
+
+START_TEST(test_crc_null_crc)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = rgCrcTypes[_i].fpCrc(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	result = rgCrcTypes[_i].fpUpdate(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+int
+main(/* int argc, char **argv */)
+{
+	Suite *s = suite_create("CRC");
+	TCase *tc_core = tcase_create("Core");
+	size_t cTestcases = sizeof(rgTestcases) / sizeof(struct BSCrcTestcase);
+	size_t cCrcTypes = sizeof(rgCrcTypes) / sizeof(struct BSCrcType);
+	SRunner *sr;
+	int number_failed;
+
+	tcase_add_loop_test(tc_core, test_crc, 0, cTestcases);
+	tcase_add_loop_test(
+		tc_core,
+		test_crc_cpu_levels,
+		0,
+		cCrcTypes * C_CPU_LEVELS
+	);
+	tcase_add_loop_test(tc_core, test_crc_update,          0, cCrcTypes);
+	tcase_add_loop_test(tc_core, test_crc_update_empty_bs, 0, cCrcTypes);
+	tcase_add_loop_test(tc_core, test_crc_null_bs,         0, cCrcTypes);
+	tcase_add_loop_test(tc_core, test_crc_null_crc,        0, cCrcTypes);
+
+	suite_add_tcase(s, tc_core);
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
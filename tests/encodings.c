@@ -34,12 +34,19 @@
 /* Testcases */
 /* ========= */
 
-#define C_ENCODINGS 3
+#define C_ENCODINGS 10
 
 static char *rgszEncodings[C_ENCODINGS] = {
 	"hex",
 	"base64",
 	"base64url",
+	"base64mime",
+	"base64pem",
+	"base32",
+	"base32hex",
+	"base32crockford",
+	"ascii85",
+	"z85",
 };
 
 struct BSEncodingTestcase {
@@ -95,7 +102,32 @@ rgTestcases[] = {
 	{ "base64",    "Zm9v",              4, "foo",                      3, "Zm9v",              5 },
 	{ "base64",    "Zm9vYg==",          8, "foob",                     4, "Zm9vYg==",          9 },
 	{ "base64",    "Zm9vYmE=",          8, "fooba",                    5, "Zm9vYmE=",          9 },
-	{ "base64",    "Zm9vYmFy",          8, "foobar",                   6, "Zm9vYmFy",          9 }/*,
+	{ "base64",    "Zm9vYmFy",          8, "foobar",                   6, "Zm9vYmFy",          9 },
+
+	{ "base64mime", "",                 0, "",                         0, "",                  1 },
+	{ "base64mime", "Zm9vYmFy",         8, "foobar",                   6, "Zm9vYmFy",          9 },
+	{ "base64mime", " Zm9v\r\nYmE=\r\n", 13, "fooba",                  5, "Zm9vYmE=",          9 },
+	{ "base64mime", "Zm\t9vY g==",     10, "foob",                     4, "Zm9vYg==",          9 },
+	{ "base64mime",
+		"MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2\r\nNzg5",
+		82,
+		"012345678901234567890123456789012345678901234567890123456789",
+		60,
+		"MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2\r\nNzg5",
+		83
+	},
+	{ "base64pem",  "",                 0, "",                         0, "",                  1 },
+	{ "base64pem",  "Zm9v\nYmFy\n",   10, "foobar",                   6, "Zm9vYmFy",          9 },
+	{ "base64pem",
+		"MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDEyMzQ1Njc4OTAxMjM0NTY3\nODkwMTIzNDU2Nzg5\n",
+		82,
+		"012345678901234567890123456789012345678901234567890123456789",
+		60,
+		"MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDEyMzQ1Njc4OTAxMjM0NTY3\nODkwMTIzNDU2Nzg5",
+		82
+	},
+
+	/* These next testcases from RFC 4648 */
 	{ "base32",    "",                  0, "",                         0, "",                  1 },
 	{ "base32",    "MY======",          8, "f",                        1, "MY======",          9 },
 	{ "base32",    "MZXQ====",          8, "fo",                       2, "MZXQ====",          9 },
@@ -110,6 +142,38 @@ rgTestcases[] = {
 	{ "base32hex", "CPNMUOG=",          8, "foob",                     4, "CPNMUOG=",          9 },
 	{ "base32hex", "CPNMUOJ1",          8, "fooba",                    5, "CPNMUOJ1",          9 },
 	{ "base32hex", "CPNMUOJ1E8======", 16, "foobar",                   6, "CPNMUOJ1E8======", 17 },
+
+	{ "base32crockford", "",            0, "",                         0, "",                  1 },
+	{ "base32crockford", "CR",          2, "f",                        1, "CR",                3 },
+	{ "base32crockford", "CSQG",        4, "fo",                       2, "CSQG",              5 },
+	{ "base32crockford", "CSQPY",       5, "foo",                      3, "CSQPY",             6 },
+	{ "base32crockford", "csqpyrg",     7, "foob",                     4, "CSQPYRG",           8 },
+	{ "base32crockford", "CSQPYRK1",    8, "fooba",                    5, "CSQPYRK1",          9 },
+	{ "base32crockford", "CSQPYRKiE8", 10, "foobar",                   6, "CSQPYRK1E8",       11 },
+	{ "base32crockford", "ZZZZZZZZoO", 10, "\xFF\xFF\xFF\xFF\xFF\0",   6, "ZZZZZZZZ00",       11 },
+	{ "base32crockford", "CSQP-YRK1",   9, "fooba",                    5, "CSQPYRK1",          9 },
+	{ "base32crockford", "CS-QPYRK1-E8-", 13, "foobar",                6, "CSQPYRK1E8",       11 },
+	{ "base32crockford", "-C-R-",       5, "f",                        1, "CR",                3 },
+
+	{ "ascii85",   "",                  0, "",                         0, "",                  1 },
+	{ "ascii85",   "Ac",                2, "f",                        1, "Ac",                3 },
+	{ "ascii85",   "Ao@",               3, "fo",                       2, "Ao@",               4 },
+	{ "ascii85",   "AoDS",              4, "foo",                      3, "AoDS",              5 },
+	{ "ascii85",   "AoDTs",             5, "foob",                     4, "AoDTs",             6 },
+	{ "ascii85",   "AoDTs@/",           7, "fooba",                    5, "AoDTs@/",           8 },
+	{ "ascii85",   "9jqo^Bla",          8, "Man is",                   6, "9jqo^Bla",          9 },
+	{ "ascii85",   "z",                 1, "\0\0\0\0",                 4, "z",                 2 },
+	{ "ascii85",   "zrr",               3, "\0\0\0\0\xFF",             5, "zrr",               4 },
+	{ "ascii85",   "s8W-!",             5, "\xFF\xFF\xFF\xFF",         4, "s8W-!",             6 },
+
+	/* This next testcase from the Z85 specification */
+	{ "z85",       "HelloWorld",       10, "\x86\x4F\xD2\x6F\xB5\x59\xF7\x5B", 8, "HelloWorld", 11 },
+	{ "z85",       "",                  0, "",                         0, "",                  1 },
+	{ "z85",       "w=",                2, "f",                        1, "w=",                3 },
+	{ "z85",       "w]zP%",             5, "foob",                     4, "w]zP%",             6 },
+	{ "z85",       "w]zP%ve",           7, "fooba",                    5, "w]zP%ve",           8 },
+	{ "z85",       "00000@@",           7, "\0\0\0\0\xFF",             5, "00000@@",           8 },
+	{ "z85",       "%nSc0",             5, "\xFF\xFF\xFF\xFF",         4, "%nSc0",             6 }/*,
 	{ "base16",    "",                  0, "",                         0, "",                  1 },
 	{ "base16",    "66",                2, "f",                        1, "66",                3 },
 	{ "base16",    "666F",              4, "fo",                       2, "666F",              5 },
@@ -137,6 +201,39 @@ rgInvalidTestcases[] = {
 	{ "base64", "A\0==",   4 },
 	{ "base64", "A\x7F==", 4 },
 	{ "base64", "A\xFF==", 4 },
+	{ "base64", "A===",    4 },
+	{ "base64", "AA==AAAA", 8 },
+
+	{ "base64mime", "Zm9",        3 },
+	{ "base64mime", "Zm9v\r\nY",  7 },
+	{ "base64mime", "Zm9v#YmFy",  9 },
+	{ "base64mime", "Zg==\r\nZg==", 10 },
+	{ "base64pem",  "Zm9v\nYmF", 8 },
+
+	{ "base32",    "MY=====",   7 },
+	{ "base32",    "MY======MY======", 16 },
+	{ "base32",    "M=======",  8 },
+	{ "base32",    "my======",  8 },
+	{ "base32",    "MZXW6YT1",  8 },
+	{ "base32hex", "CPNMUOJW",  8 },
+
+	{ "base32crockford", "C",   1 },
+	{ "base32crockford", "CSQ", 3 },
+	{ "base32crockford", "CU",  2 },
+	{ "base32crockford", "CR==", 4 },
+	{ "base32crockford", "C-SQ", 4 },
+	{ "base32crockford", "--C--", 5 },
+	{ "base32crockford", "CSQP_YRK1", 9 },
+
+	{ "ascii85",   "A",        1 },
+	{ "ascii85",   "s8W-\"",  5 },
+	{ "ascii85",   "Azc",      3 },
+	{ "ascii85",   "Ao~S",     4 },
+	{ "ascii85",   "AoDTsA",   6 },
+
+	{ "z85",       "z",        1 },
+	{ "z85",       "%nSc1",    5 },
+	{ "z85",       "w\"",      2 },
 };
 
 
@@ -230,6 +327,466 @@ START_TEST(test_decode_null_encoding)
 END_TEST
 
 
+/* ======================== */
+/* Tests for bs_decode_skip */
+/* ======================== */
+
+static const BSbyte rgbSkipNothing[32] = { 0 };
+
+/* ' ', '-', ':' and LF */
+static const BSbyte rgbSkipSeparators[32] = {
+	0x00, 0x04, 0x00, 0x00, 0x01, 0x20, 0x00, 0x04
+};
+
+START_TEST(test_decode_skip)
+{
+	struct BSEncodingTestcase testcase = rgTestcases[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(
+		bs,
+		testcase.szEncoding,
+		testcase.szInput,
+		testcase.cchInput,
+		rgbSkipNothing
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_size(bs) == testcase.cbBytes);
+	fail_unless(
+		memcmp(bs_get_buffer(bs), testcase.rgbBytes, testcase.cbBytes) == 0
+	);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_skip_invalid)
+{
+	struct BSEncodingInvalidTestcase testcase = rgInvalidTestcases[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(
+		bs,
+		testcase.szEncoding,
+		testcase.szInput,
+		testcase.cchInput,
+		rgbSkipNothing
+	);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+struct BSDecodeSkipTestcase {
+	const char *szEncoding; /* What encoding to test */
+	const char *szInput;    /* Input string to decode */
+	BSbyte *rgbBytes;       /* Expected bytestream contents */
+	size_t cbBytes;         /* Expected bytestream length */
+};
+
+static struct BSDecodeSkipTestcase
+rgSkipTestcases[] = {
+	{ "hex",             "de:ad:be:ef",       "\xDE\xAD\xBE\xEF",         4 },
+	{ "hex",             "00-1A-2B-3C-4D-5E", "\x00\x1A\x2B\x3C\x4D\x5E", 6 },
+	{ "hex",             " :-\n",             "",                         0 },
+	{ "base64",          "Zm9v YmFy\n",       "foobar",                   6 },
+	{ "base64",          "Zm9v\nYg==\n",      "foob",                     4 },
+	{ "base64mime",      "Zm9v-\r\nYmE=",     "fooba",                    5 },
+	{ "base32crockford", "91JP-RV3F",         "Hello",                    5 },
+	{ "ascii85",         "9jqo^ z",           "Man \0\0\0\0",             8 },
+	{ "ascii85",         "z z",               "\0\0\0\0\0\0\0\0",         8 },
+	{ "z85",             "Hello World",       "\x86\x4F\xD2\x6F\xB5\x59\xF7\x5B", 8 },
+};
+
+START_TEST(test_decode_skip_separators)
+{
+	struct BSDecodeSkipTestcase testcase = rgSkipTestcases[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(
+		bs,
+		testcase.szEncoding,
+		testcase.szInput,
+		strlen(testcase.szInput),
+		rgbSkipSeparators
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_size(bs) == testcase.cbBytes);
+	fail_unless(
+		memcmp(bs_get_buffer(bs), testcase.rgbBytes, testcase.cbBytes) == 0
+	);
+
+	bs_free(bs);
+}
+END_TEST
+
+#define CB_LONG 10000
+
+START_TEST(test_decode_skip_long)
+{
+	BS *bs = bs_create();
+	BSbyte rgbBytes[CB_LONG];
+	char rgchEncoded[CB_LONG / 3 * 4 + 5];
+	char rgchInput[CB_LONG / 3 * 4 * 2 + 10];
+	size_t iByte, ichEncoded, cchInput = 0;
+	BSresult result;
+
+	for (iByte = 0; iByte < CB_LONG; iByte++) {
+		rgbBytes[iByte] = (BSbyte) (iByte * 167 + 13);
+	}
+
+	result = bs_load(bs, rgbBytes, CB_LONG);
+	fail_unless(result == BS_OK);
+	result = bs_encode(bs, "base64", rgchEncoded);
+	fail_unless(result == BS_OK);
+
+	/* Separate pairs of characters, with the occasional line break */
+	for (ichEncoded = 0; rgchEncoded[ichEncoded] != '\0'; ichEncoded++) {
+		rgchInput[cchInput++] = rgchEncoded[ichEncoded];
+		if (ichEncoded % 2 == 1) {
+			rgchInput[cchInput++] = (ichEncoded % 38 == 37) ? '\n' : ':';
+		}
+	}
+
+	result = bs_decode_skip(
+		bs,
+		"base64",
+		rgchInput,
+		cchInput,
+		rgbSkipSeparators
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_size(bs) == CB_LONG);
+	fail_unless(memcmp(bs_get_buffer(bs), rgbBytes, CB_LONG) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_skip_early_padding)
+{
+	BS *bs = bs_create();
+	char rgchInput[4096 + 4];
+	BSresult result;
+
+	/* Put padding at the end of the first chunk, with more data following */
+	memset(rgchInput, 'A', 4088);
+	memcpy(rgchInput + 4088, "QQ==QUJD", 8);
+
+	result = bs_decode_skip(bs, "base64", rgchInput, 4096, rgbSkipNothing);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_skip_null_bs)
+{
+	BSresult result;
+
+	result = bs_decode_skip(NULL, rgszEncodings[_i], "", 0, rgbSkipNothing);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_decode_skip_null_data)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(bs, rgszEncodings[_i], NULL, 0, rgbSkipNothing);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_skip_null_skip)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(bs, rgszEncodings[_i], "", 0, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_skip_bad_encoding)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(bs, "notanencoding", "", 0, rgbSkipNothing);
+	fail_unless(result == BS_BAD_ENCODING);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_skip_null_encoding)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_skip(bs, NULL, "", 0, rgbSkipNothing);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+/* ======================== */
+/* Tests for bs_decode_into */
+/* ======================== */
+
+START_TEST(test_decode_into)
+{
+	struct BSEncodingTestcase testcase = rgTestcases[_i];
+	BSbyte *rgbOutput = malloc(testcase.cbBytes + 1);
+	size_t cbWritten;
+	BSresult result;
+
+	fail_unless(rgbOutput != NULL);
+
+	/* Exactly the right size */
+	result = bs_decode_into(
+		testcase.szEncoding,
+		testcase.szInput,
+		testcase.cchInput,
+		rgbOutput,
+		testcase.cbBytes,
+		&cbWritten
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(cbWritten == testcase.cbBytes);
+	fail_unless(memcmp(rgbOutput, testcase.rgbBytes, testcase.cbBytes) == 0);
+
+	/* One byte too short */
+	if (testcase.cbBytes > 0) {
+		memset(rgbOutput, 0xA5, testcase.cbBytes + 1);
+
+		result = bs_decode_into(
+			testcase.szEncoding,
+			testcase.szInput,
+			testcase.cchInput,
+			rgbOutput,
+			testcase.cbBytes - 1,
+			&cbWritten
+		);
+		fail_unless(result == BS_SHORT_BUFFER);
+		fail_unless(rgbOutput[0] == 0xA5);
+	}
+
+	free(rgbOutput);
+}
+END_TEST
+
+START_TEST(test_decode_into_invalid)
+{
+	struct BSEncodingInvalidTestcase testcase = rgInvalidTestcases[_i];
+	BSbyte rgbOutput[32];
+	size_t cbWritten;
+	BSresult result;
+
+	result = bs_decode_into(
+		testcase.szEncoding,
+		testcase.szInput,
+		testcase.cchInput,
+		rgbOutput,
+		sizeof(rgbOutput),
+		&cbWritten
+	);
+	fail_unless(result == BS_INVALID);
+}
+END_TEST
+
+START_TEST(test_decode_into_null_output)
+{
+	BSresult result;
+
+	result = bs_decode_into("hex", "00", 2, NULL, 1, (size_t *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_decode_into_null_written)
+{
+	BSbyte rgbOutput[1];
+	BSresult result;
+
+	result = bs_decode_into("hex", "00", 2, rgbOutput, 1, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_decode_into_bad_encoding)
+{
+	BSresult result;
+
+	result = bs_decode_into(
+		"notanencoding",
+		"",
+		0,
+		NULL,
+		0,
+		(size_t *) 0xDEADBEEF
+	);
+	fail_unless(result == BS_BAD_ENCODING);
+}
+END_TEST
+
+
+/* ============================ */
+/* Tests for bs_decode_in_place */
+/* ============================ */
+
+START_TEST(test_decode_in_place)
+{
+	struct BSEncodingTestcase testcase = rgTestcases[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_load(bs, (const BSbyte *) testcase.szInput, testcase.cchInput);
+	fail_unless(result == BS_OK);
+
+	result = bs_decode_in_place(bs, testcase.szEncoding);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_size(bs) == testcase.cbBytes);
+	if (testcase.cbBytes > 0) {
+		fail_unless(
+			memcmp(bs_get_buffer(bs), testcase.rgbBytes, testcase.cbBytes) == 0
+		);
+	}
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_in_place_invalid)
+{
+	struct BSEncodingInvalidTestcase testcase = rgInvalidTestcases[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_load(bs, (const BSbyte *) testcase.szInput, testcase.cchInput);
+	fail_unless(result == BS_OK);
+
+	result = bs_decode_in_place(bs, testcase.szEncoding);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_decode_in_place_null_bs)
+{
+	BSresult result;
+
+	result = bs_decode_in_place(NULL, rgszEncodings[_i]);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_decode_in_place_bad_encoding)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_decode_in_place(bs, "notanencoding");
+	fail_unless(result == BS_BAD_ENCODING);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+/* ============================ */
+/* Tests for bs_decode_validate */
+/* ============================ */
+
+START_TEST(test_decode_validate)
+{
+	struct BSEncodingTestcase testcase = rgTestcases[_i];
+	size_t cbBytes;
+	BSresult result;
+
+	result = bs_decode_validate(
+		testcase.szEncoding,
+		testcase.szInput,
+		testcase.cchInput,
+		&cbBytes
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(cbBytes == testcase.cbBytes);
+}
+END_TEST
+
+START_TEST(test_decode_validate_invalid)
+{
+	struct BSEncodingInvalidTestcase testcase = rgInvalidTestcases[_i];
+	size_t cbBytes = 12345;
+	BSresult result;
+
+	result = bs_decode_validate(
+		testcase.szEncoding,
+		testcase.szInput,
+		testcase.cchInput,
+		&cbBytes
+	);
+	fail_unless(result == BS_INVALID);
+	fail_unless(cbBytes == 12345);
+}
+END_TEST
+
+START_TEST(test_decode_validate_null_data)
+{
+	BSresult result;
+
+	result = bs_decode_validate(
+		rgszEncodings[_i],
+		NULL,
+		0,
+		(size_t *) 0xDEADBEEF
+	);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_decode_validate_null_size)
+{
+	BSresult result;
+
+	result = bs_decode_validate(rgszEncodings[_i], "", 0, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_decode_validate_bad_encoding)
+{
+	BSresult result;
+
+	result = bs_decode_validate("notanencoding", "", 0, (size_t *) 0xDEADBEEF);
+	fail_unless(result == BS_BAD_ENCODING);
+}
+END_TEST
+
+START_TEST(test_decode_validate_null_encoding)
+{
+	BSresult result;
+
+	result = bs_decode_validate(NULL, "", 0, (size_t *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+
 /* ======================== */
 /* Tests for bs_encode_size */
 /* ======================== */
@@ -380,6 +937,8 @@ main(/* int argc, char **argv */)
 	size_t cTestcases = sizeof(rgTestcases) / sizeof(struct BSEncodingTestcase);
 	size_t cInvalidTestcases = sizeof(rgInvalidTestcases) /
 		sizeof(struct BSEncodingInvalidTestcase);
+	size_t cSkipTestcases = sizeof(rgSkipTestcases) /
+		sizeof(struct BSDecodeSkipTestcase);
 	SRunner *sr;
 	int number_failed;
 
@@ -390,6 +949,35 @@ main(/* int argc, char **argv */)
 	tcase_add_test(tc_core, test_decode_bad_encoding);
 	tcase_add_test(tc_core, test_decode_null_encoding);
 
+	tcase_add_loop_test(tc_core, test_decode_skip,            0, cTestcases);
+	tcase_add_loop_test(tc_core, test_decode_skip_invalid,    0, cInvalidTestcases);
+	tcase_add_loop_test(tc_core, test_decode_skip_separators, 0, cSkipTestcases);
+	tcase_add_test(tc_core, test_decode_skip_long);
+	tcase_add_test(tc_core, test_decode_skip_early_padding);
+	tcase_add_loop_test(tc_core, test_decode_skip_null_bs,    0, C_ENCODINGS);
+	tcase_add_loop_test(tc_core, test_decode_skip_null_data,  0, C_ENCODINGS);
+	tcase_add_loop_test(tc_core, test_decode_skip_null_skip,  0, C_ENCODINGS);
+	tcase_add_test(tc_core, test_decode_skip_bad_encoding);
+	tcase_add_test(tc_core, test_decode_skip_null_encoding);
+
+	tcase_add_loop_test(tc_core, test_decode_into,              0, cTestcases);
+	tcase_add_loop_test(tc_core, test_decode_into_invalid,      0, cInvalidTestcases);
+	tcase_add_test(tc_core, test_decode_into_null_output);
+	tcase_add_test(tc_core, test_decode_into_null_written);
+	tcase_add_test(tc_core, test_decode_into_bad_encoding);
+
+	tcase_add_loop_test(tc_core, test_decode_in_place,          0, cTestcases);
+	tcase_add_loop_test(tc_core, test_decode_in_place_invalid,  0, cInvalidTestcases);
+	tcase_add_loop_test(tc_core, test_decode_in_place_null_bs,  0, C_ENCODINGS);
+	tcase_add_test(tc_core, test_decode_in_place_bad_encoding);
+
+	tcase_add_loop_test(tc_core, test_decode_validate,           0, cTestcases);
+	tcase_add_loop_test(tc_core, test_decode_validate_invalid,   0, cInvalidTestcases);
+	tcase_add_loop_test(tc_core, test_decode_validate_null_data, 0, C_ENCODINGS);
+	tcase_add_loop_test(tc_core, test_decode_validate_null_size, 0, C_ENCODINGS);
+	tcase_add_test(tc_core, test_decode_validate_bad_encoding);
+	tcase_add_test(tc_core, test_decode_validate_null_encoding);
+
 	tcase_add_loop_test(tc_core, test_encode_size,           0, cTestcases);
 	tcase_add_loop_test(tc_core, test_encode_size_null_bs,   0, C_ENCODINGS);
 	tcase_add_loop_test(tc_core, test_encode_size_null_size, 0, C_ENCODINGS);
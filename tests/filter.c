@@ -51,6 +51,18 @@ exclude_all(BSbyte byte)
 	return BS_EXCLUDE;
 }
 
+static BSfilter
+filter_whitespace_byte(BSbyte byte)
+{
+	return (byte == ' ') ? BS_EXCLUDE : BS_INCLUDE;
+}
+
+static BSresult
+filter_set_vowels(BS *bs)
+{
+	return bs_filter_set(bs, (BSbyte *) "aeiou", 5);
+}
+
 static BSresult
 filter_include_all(BS *bs)
 {
@@ -68,12 +80,13 @@ filter_exclude_all(BS *bs)
 /* Testcases */
 /* ========= */
 
-#define C_FILTERS 3
+#define C_FILTERS 4
 
 static BSresult (*rgfFilters[C_FILTERS])(BS *) = {
 	filter_include_all,
 	filter_exclude_all,
 	bs_filter_whitespace,
+	filter_set_vowels,
 };
 
 struct BSFilterTestcase {
@@ -91,6 +104,8 @@ rgTestcases[] = {
 	{ bs_filter_whitespace, "\x9\xA\xD ", 4, "",         0 },
 	{ bs_filter_whitespace, "aAzZ09+.",   8, "aAzZ09+.", 8 },
 	{ bs_filter_whitespace, "test str",   8, "teststr",  7 },
+	{ filter_set_vowels,    "education",  9, "dctn",     4 },
+	{ filter_set_vowels,    "\0\xFFxyz",  5, "\0\xFFxyz", 5 },
 };
 
 
@@ -143,6 +158,267 @@ START_TEST(test_filters_null_bs)
 END_TEST
 
 
+/* =========================== */
+/* Out-of-place filtering test */
+/* =========================== */
+
+START_TEST(test_filter_to)
+{
+	BS *src = bs_create(), *dst = bs_create();
+
+	bs_load(src, (BSbyte *) "test str", 8);
+
+	fail_unless(bs_filter_to(dst, src, filter_whitespace_byte) == BS_OK);
+	fail_unless(bs_size(dst) == 7);
+	fail_unless(memcmp(bs_get_buffer(dst), "teststr", 7) == 0);
+	fail_unless(bs_size(src) == 8);
+	fail_unless(memcmp(bs_get_buffer(src), "test str", 8) == 0);
+
+	bs_free(src);
+	bs_free(dst);
+}
+END_TEST
+
+
+/* ============================ */
+/* Context and block-wise tests */
+/* ============================ */
+
+static BSfilter
+exclude_every_third(BSbyte byte, size_t index, void *data)
+{
+	size_t *pcCalls = data;
+
+	UNUSED(byte);
+	(*pcCalls)++;
+
+	return (index % 3 == 2) ? BS_EXCLUDE : BS_INCLUDE;
+}
+
+static BSresult
+exclude_every_third_block(
+	BSbyte *block,
+	size_t length,
+	size_t offset,
+	size_t *kept,
+	void *data
+)
+{
+	size_t ibRead, ibWrite = 0;
+
+	for (ibRead = 0; ibRead < length; ibRead++) {
+		switch (exclude_every_third(block[ibRead], offset + ibRead, data)) {
+			case BS_INCLUDE:
+				block[ibWrite++] = block[ibRead];
+				break;
+
+			case BS_EXCLUDE:
+				break;
+		}
+	}
+	*kept = ibWrite;
+
+	return BS_OK;
+}
+
+static BSresult
+keep_too_many(
+	BSbyte *block,
+	size_t length,
+	size_t offset,
+	size_t *kept,
+	void *data
+)
+{
+	UNUSED(block);
+	UNUSED(offset);
+	UNUSED(data);
+
+	*kept = (offset == 0) ? 1 : length + 1;
+
+	return BS_OK;
+}
+
+START_TEST(test_filter_ctx)
+{
+	BS *bs = bs_create();
+	size_t cCalls = 0;
+
+	bs_load(bs, (BSbyte *) "abcdefgh", 8);
+
+	fail_unless(bs_filter_ctx(bs, exclude_every_third, &cCalls) == BS_OK);
+	fail_unless(cCalls == 8);
+	fail_unless(bs_size(bs) == 6);
+	fail_unless(memcmp(bs_get_buffer(bs), "abdegh", 6) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_blocks)
+{
+	BS *bs = bs_create();
+	size_t cbBlock, cCalls;
+	BSresult result;
+
+	for (cbBlock = 1; cbBlock <= 9; cbBlock++) {
+		cCalls = 0;
+		bs_load(bs, (BSbyte *) "abcdefgh", 8);
+		result = bs_filter_blocks(
+			bs,
+			cbBlock,
+			exclude_every_third_block,
+			&cCalls
+		);
+		fail_unless(result == BS_OK);
+		fail_unless(cCalls == 8);
+		fail_unless(bs_size(bs) == 6);
+		fail_unless(memcmp(bs_get_buffer(bs), "abdegh", 6) == 0);
+	}
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_blocks_failure)
+{
+	BS *bs = bs_create();
+
+	bs_load(bs, (BSbyte *) "abcd", 4);
+
+	fail_unless(bs_filter_blocks(bs, 0, keep_too_many, NULL) == BS_INVALID);
+	fail_unless(bs_size(bs) == 4);
+
+	fail_unless(bs_filter_blocks(bs, 2, keep_too_many, NULL) == BS_INVALID);
+	fail_unless(bs_size(bs) == 1);
+	fail_unless(bs_get_byte(bs, 0) == 'a');
+
+	bs_free(bs);
+}
+END_TEST
+
+
+/* ===================== */
+/* Processor-level tests */
+/* ===================== */
+
+#define C_CPU_LEVELS 4
+
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	BS_CPU_SSE2 | BS_CPU_AVX2,
+	~0u
+};
+
+#define CB_LONG 1000
+
+static BSfilter
+exclude_set_byte(BSbyte byte)
+{
+	/* Whitespace, plus some bytes from each half of the nibble tables */
+	switch (byte) {
+		case 0x09:
+		case 0x0A:
+		case 0x0D:
+		case ' ':
+		case 0x7F:
+		case 0x80:
+		case 0xA5:
+		case 0xFF:
+			return BS_EXCLUDE;
+
+		default:
+			return BS_INCLUDE;
+	}
+}
+
+START_TEST(test_filters_cpu_levels)
+{
+	BSbyte rgbInput[CB_LONG];
+	size_t ibInput, cbInput;
+	BS *bs = bs_create(), *expected = bs_create();
+	BSbyte rgbSet[8] = { 0x09, 0x0A, 0x0D, ' ', 0x7F, 0x80, 0xA5, 0xFF };
+	BSresult result;
+
+	bs_cpu_limit(rgCpuLevels[_i]);
+
+	for (ibInput = 0; ibInput < CB_LONG; ibInput++) {
+		rgbInput[ibInput] = (BSbyte) (ibInput * 7 + ibInput / 256);
+	}
+
+	/* Odd lengths leave a tail after the last full vector */
+	for (cbInput = CB_LONG - 70; cbInput <= CB_LONG; cbInput += 7) {
+		bs_load(expected, rgbInput, cbInput);
+		bs_filter(expected, exclude_set_byte);
+
+		bs_load(bs, rgbInput, cbInput);
+		result = bs_filter_set(bs, rgbSet, sizeof(rgbSet));
+		fail_unless(result == BS_OK);
+		fail_unless(bs_compare_equal(bs, expected) == BS_OK);
+	}
+
+	bs_free(bs);
+	bs_free(expected);
+
+	bs_cpu_limit(~0u);
+}
+END_TEST
+
+
+/* ============== */
+/* Parallel tests */
+/* ============== */
+
+#define CB_PARALLEL (5 * 65536 + 123)
+
+static BS *
+create_parallel_input(void)
+{
+	BS *bs = bs_create_size(CB_PARALLEL);
+	BSbyte *pbBytes = bs_get_buffer(bs);
+	size_t ibBytes;
+
+	/* Vary the proportion removed from range to range */
+	for (ibBytes = 0; ibBytes < CB_PARALLEL; ibBytes++) {
+		pbBytes[ibBytes] = (ibBytes % (ibBytes / 65536 + 2)) ? 'x' : ' ';
+	}
+
+	return bs;
+}
+
+START_TEST(test_filters_parallel)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = create_parallel_input();
+	BS *dst = bs_create();
+	BS *expected = create_parallel_input();
+	BSbyte rgbBitmap[32] = { 0x00, 0x00, 0x00, 0x00, 0x01 };
+	BSresult result;
+
+	bs_filter(expected, filter_whitespace_byte);
+
+	result = bs_filter_to_parallel(dst, bs, filter_whitespace_byte, pool);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_compare_equal(dst, expected) == BS_OK);
+	fail_unless(bs_size(bs) == CB_PARALLEL);
+
+	fail_unless(bs_filter_parallel(bs, filter_whitespace_byte, pool) == BS_OK);
+	fail_unless(bs_compare_equal(bs, expected) == BS_OK);
+
+	bs_free(bs);
+	bs = create_parallel_input();
+	fail_unless(bs_filter_bitmap_parallel(bs, rgbBitmap, pool) == BS_OK);
+	fail_unless(bs_compare_equal(bs, expected) == BS_OK);
+
+	bs_free(bs);
+	bs_free(dst);
+	bs_free(expected);
+	bs_pool_free(pool);
+}
+END_TEST
+
+
 /* ==================== */
 /* NULL parameter tests */
 /* ==================== */
@@ -168,6 +444,96 @@ START_TEST(test_generic_filter_null_operation)
 }
 END_TEST
 
+START_TEST(test_filter_to_null_dst)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_filter_to(NULL, bs, include_all);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_to_null_src)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_filter_to(bs, NULL, include_all);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_ctx_null_bs)
+{
+	BSresult result;
+
+	result = bs_filter_ctx(NULL, exclude_every_third, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_filter_ctx_null_operation)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_filter_ctx(bs, NULL, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_blocks_null_bs)
+{
+	BSresult result;
+
+	result = bs_filter_blocks(NULL, 1, keep_too_many, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_filter_blocks_null_operation)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_filter_blocks(bs, 1, NULL, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_set_null_set)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_filter_set(bs, NULL, 0);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_filter_bitmap_null_bitmap)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_filter_bitmap(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
 
 int
 main(/* int argc, char **argv */)
@@ -182,8 +548,23 @@ main(/* int argc, char **argv */)
 	tcase_add_loop_test(tc_core, test_filters_empty_bs, 0, C_FILTERS);
 	tcase_add_loop_test(tc_core, test_filters_null_bs,  0, C_FILTERS);
 
+	tcase_add_test(tc_core, test_filter_to);
+	tcase_add_loop_test(tc_core, test_filters_cpu_levels, 0, C_CPU_LEVELS);
+	tcase_add_loop_test(tc_core, test_filters_parallel, 0, 2);
+	tcase_add_test(tc_core, test_filter_ctx);
+	tcase_add_test(tc_core, test_filter_blocks);
+	tcase_add_test(tc_core, test_filter_blocks_failure);
+
 	tcase_add_test(tc_core, test_generic_filter_null_bs);
 	tcase_add_test(tc_core, test_generic_filter_null_operation);
+	tcase_add_test(tc_core, test_filter_set_null_set);
+	tcase_add_test(tc_core, test_filter_bitmap_null_bitmap);
+	tcase_add_test(tc_core, test_filter_to_null_dst);
+	tcase_add_test(tc_core, test_filter_to_null_src);
+	tcase_add_test(tc_core, test_filter_ctx_null_bs);
+	tcase_add_test(tc_core, test_filter_ctx_null_operation);
+	tcase_add_test(tc_core, test_filter_blocks_null_bs);
+	tcase_add_test(tc_core, test_filter_blocks_null_operation);
 
 	suite_add_tcase(s, tc_core);
 	sr = srunner_create(s);
@@ -27,6 +27,7 @@
 #include "libbs.h"
 #include <check.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef UNUSED
 #define UNUSED(x) (void)(x)
@@ -44,6 +45,42 @@ fold_bad_operation(BSbyte byte, void *data)
 	return 999;
 }
 
+struct BSBlockTotal {
+	unsigned int total;  /* Sum of the bytes seen */
+	size_t cCalls;       /* Count of blocks seen */
+	size_t cbLongest;    /* Longest block seen */
+};
+
+static BSresult
+sum_block(const BSbyte *block, size_t length, void *data)
+{
+	struct BSBlockTotal *pTotal = data;
+	size_t ibBlock;
+
+	for (ibBlock = 0; ibBlock < length; ibBlock++) {
+		pTotal->total += block[ibBlock];
+	}
+	pTotal->cCalls++;
+	if (length > pTotal->cbLongest) {
+		pTotal->cbLongest = length;
+	}
+
+	return BS_OK;
+}
+
+static BSresult
+fail_on_zero_block(const BSbyte *block, size_t length, void *data)
+{
+	struct BSBlockTotal *pTotal = data;
+
+	if (memchr(block, 0, length) != NULL) {
+		return BS_INVALID;
+	}
+	pTotal->cCalls++;
+
+	return BS_OK;
+}
+
 
 /* ========= */
 /* Testcases */
@@ -175,6 +212,218 @@ START_TEST(test_folds_null_output)
 END_TEST
 
 
+/* ====================== */
+/* Population count tests */
+/* ====================== */
+
+#define C_CPU_LEVELS 4
+
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2 | BS_CPU_POPCNT,
+	BS_CPU_SSE2 | BS_CPU_POPCNT | BS_CPU_AVX2,
+	~0u
+};
+
+#define CB_LONG 3000
+
+START_TEST(test_popcount_cpu_levels)
+{
+	BSbyte rgbInput[CB_LONG + 3];
+	size_t ibInput, ibStart, cbInput;
+	uint64_t cBits, cExpected;
+	BS *bs = bs_create();
+	BSresult result;
+
+	bs_cpu_limit(rgCpuLevels[_i]);
+
+	for (ibInput = 0; ibInput < sizeof(rgbInput); ibInput++) {
+		rgbInput[ibInput] = (BSbyte) (ibInput * 167 + 13);
+	}
+
+	/* Vary the start as well as the length to cover unaligned loads */
+	for (ibStart = 0; ibStart < 3; ibStart++) {
+		for (cbInput = 1; cbInput <= CB_LONG; cbInput += 97) {
+			cExpected = 0;
+			for (ibInput = ibStart; ibInput < ibStart + cbInput; ibInput++) {
+				cExpected += (rgbInput[ibInput] >> 0 & 1)
+				           + (rgbInput[ibInput] >> 1 & 1)
+				           + (rgbInput[ibInput] >> 2 & 1)
+				           + (rgbInput[ibInput] >> 3 & 1)
+				           + (rgbInput[ibInput] >> 4 & 1)
+				           + (rgbInput[ibInput] >> 5 & 1)
+				           + (rgbInput[ibInput] >> 6 & 1)
+				           + (rgbInput[ibInput] >> 7 & 1);
+			}
+
+			bs_load(bs, rgbInput + ibStart, cbInput);
+			result = bs_popcount(bs, &cBits);
+			fail_unless(result == BS_OK);
+			fail_unless(cBits == cExpected);
+		}
+	}
+
+	bs_free(bs);
+
+	bs_cpu_limit(~0u);
+}
+END_TEST
+
+START_TEST(test_popcount_all_set)
+{
+	BS *bs = bs_create_size(CB_LONG);
+	uint64_t cBits;
+	BSresult result;
+
+	memset(bs_get_buffer(bs), 0xFF, CB_LONG);
+
+	result = bs_popcount(bs, &cBits);
+	fail_unless(result == BS_OK);
+	fail_unless(cBits == 8 * CB_LONG);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_popcount_null_bs)
+{
+	BSresult result;
+
+	result = bs_popcount(NULL, (uint64_t *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_popcount_null_count)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_popcount(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+/* ========= */
+/* Sum tests */
+/* ========= */
+
+START_TEST(test_sum64_cpu_levels)
+{
+	BSbyte rgbInput[CB_LONG + 3];
+	size_t ibInput, ibStart, cbInput;
+	uint64_t cSum, cWeighted, cExpectedSum, cExpectedWeighted;
+	BS *bs = bs_create();
+	BSresult result;
+
+	bs_cpu_limit(rgCpuLevels[_i]);
+
+	for (ibInput = 0; ibInput < sizeof(rgbInput); ibInput++) {
+		rgbInput[ibInput] = (BSbyte) (ibInput * 167 + 13);
+	}
+
+	for (ibStart = 0; ibStart < 3; ibStart++) {
+		for (cbInput = 1; cbInput <= CB_LONG; cbInput += 97) {
+			cExpectedSum = 0;
+			cExpectedWeighted = 0;
+			for (ibInput = ibStart; ibInput < ibStart + cbInput; ibInput++) {
+				cExpectedSum += rgbInput[ibInput];
+				cExpectedWeighted +=
+					(uint64_t) rgbInput[ibInput] * (ibStart + cbInput - ibInput);
+			}
+
+			bs_load(bs, rgbInput + ibStart, cbInput);
+			result = bs_sum64(bs, &cSum);
+			fail_unless(result == BS_OK);
+			fail_unless(cSum == cExpectedSum);
+
+			result = bs_sum64_weighted(bs, &cSum, &cWeighted);
+			fail_unless(result == BS_OK);
+			fail_unless(cSum == cExpectedSum);
+			fail_unless(cWeighted == cExpectedWeighted);
+		}
+	}
+
+	bs_free(bs);
+
+	bs_cpu_limit(~0u);
+}
+END_TEST
+
+START_TEST(test_sum64_weighted)
+{
+	BS *bs = bs_create();
+	uint64_t cSum, cWeighted;
+	BSresult result;
+
+	bs_load(bs, (BSbyte *) "abc", 3);
+
+	result = bs_sum64_weighted(bs, &cSum, &cWeighted);
+	fail_unless(result == BS_OK);
+	fail_unless(cSum == 294);
+	fail_unless(cWeighted == 3 * 'a' + 2 * 'b' + 1 * 'c');
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_sum64_empty_bs)
+{
+	BS *bs = bs_create();
+	uint64_t cSum = 1, cWeighted = 1;
+	BSresult result;
+
+	result = bs_sum64(bs, &cSum);
+	fail_unless(result == BS_OK);
+	fail_unless(cSum == 0);
+
+	result = bs_sum64_weighted(bs, &cSum, &cWeighted);
+	fail_unless(result == BS_OK);
+	fail_unless(cSum == 0);
+	fail_unless(cWeighted == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_sum64_null_bs)
+{
+	BSresult result;
+
+	result = bs_sum64(NULL, (uint64_t *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+
+	result = bs_sum64_weighted(
+		NULL,
+		(uint64_t *) 0xDEADBEEF,
+		(uint64_t *) 0xDEADBEEF
+	);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_sum64_null_output)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_sum64(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	result = bs_sum64_weighted(bs, NULL, (uint64_t *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+
+	result = bs_sum64_weighted(bs, (uint64_t *) 0xDEADBEEF, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+
 /* =========== */
 /* Other tests */
 /* =========== */
@@ -204,10 +453,351 @@ START_TEST(test_fold_bad_operation_empty_bs)
 END_TEST
 
 
+/* ================== */
+/* Block-wise folding */
+/* ================== */
+
+START_TEST(test_fold_blocks)
+{
+	BS *bs = bs_create();
+	struct BSBlockTotal total;
+	size_t cbBlock;
+	BSresult result;
+
+	bs_load(bs, (BSbyte *) "Test input", 10);
+
+	for (cbBlock = 1; cbBlock <= 11; cbBlock++) {
+		memset(&total, 0, sizeof(total));
+		result = bs_fold_blocks(bs, cbBlock, sum_block, &total);
+		fail_unless(result == BS_OK);
+		fail_unless(total.total == 1008);
+		fail_unless(total.cCalls == (10 + cbBlock - 1) / cbBlock);
+		fail_unless(total.cbLongest == ((cbBlock < 10) ? cbBlock : 10));
+	}
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_fold_blocks_failure)
+{
+	BS *bs = bs_create();
+	struct BSBlockTotal total;
+	BSresult result;
+
+	/* The zero is in the third block, so the fourth is never read */
+	bs_load(bs, (BSbyte *) "abcdefg\0hijklmn", 16);
+	memset(&total, 0, sizeof(total));
+
+	result = bs_fold_blocks(bs, 3, fail_on_zero_block, &total);
+	fail_unless(result == BS_INVALID);
+	fail_unless(total.cCalls == 2);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_fold_blocks_empty_bs)
+{
+	BS *bs = bs_create();
+	struct BSBlockTotal total;
+	BSresult result;
+
+	memset(&total, 0, sizeof(total));
+
+	result = bs_fold_blocks(bs, 4, sum_block, &total);
+	fail_unless(result == BS_OK);
+	fail_unless(total.cCalls == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_fold_blocks_zero_size)
+{
+	BS *bs = bs_create_size(1);
+	BSresult result;
+
+	result = bs_fold_blocks(bs, 0, sum_block, (void *) 0xDEADBEEF);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+/* ============== */
+/* Parallel tests */
+/* ============== */
+
+#define CB_PARALLEL (5 * 65536 + 123)
+
+#define HASH_BASE 31
+
+/*
+ * A polynomial hash of a range, together with HASH_BASE raised to the length of
+ * the range. Combining these is associative but not commutative, so any change
+ * to the order of the ranges would show up.
+ */
+struct BSHash {
+	uint64_t hash;
+	uint64_t power;
+};
+
+static const struct BSHash hashIdentity = { 0, 1 };
+
+static BSresult
+hash_range(const BSbyte *block, size_t length, void *value, void *data)
+{
+	struct BSHash *pHash = value;
+	size_t ibBlock;
+
+	UNUSED(data);
+
+	for (ibBlock = 0; ibBlock < length; ibBlock++) {
+		pHash->hash = pHash->hash * HASH_BASE + block[ibBlock];
+		pHash->power *= HASH_BASE;
+	}
+
+	return BS_OK;
+}
+
+static BSresult
+hash_combine(void *value, const void *other, void *data)
+{
+	struct BSHash *pHash = value;
+	const struct BSHash *pOther = other;
+
+	UNUSED(data);
+
+	pHash->hash = pHash->hash * pOther->power + pOther->hash;
+	pHash->power *= pOther->power;
+
+	return BS_OK;
+}
+
+static BSresult
+fail_range(const BSbyte *block, size_t length, void *value, void *data)
+{
+	UNUSED(block);
+	UNUSED(value);
+	UNUSED(data);
+
+	return (length < 65536) ? BS_INVALID : BS_OK;
+}
+
+static BSresult
+fail_combine(void *value, const void *other, void *data)
+{
+	UNUSED(value);
+	UNUSED(other);
+	UNUSED(data);
+
+	return BS_OVERFLOW;
+}
+
+static BS *
+create_parallel_input(void)
+{
+	BS *bs = bs_create_size(CB_PARALLEL);
+	BSbyte *pbBytes = bs_get_buffer(bs);
+	size_t ibBytes;
+
+	for (ibBytes = 0; ibBytes < CB_PARALLEL; ibBytes++) {
+		pbBytes[ibBytes] = (BSbyte) (ibBytes % 251);
+	}
+
+	return bs;
+}
+
+START_TEST(test_fold_parallel)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = create_parallel_input();
+	struct BSHash hash, expected = hashIdentity;
+	BSresult result;
+
+	hash_range(bs_get_buffer(bs), bs_size(bs), &expected, NULL);
+
+	result = bs_fold_parallel(
+		bs,
+		&hash,
+		sizeof(hash),
+		&hashIdentity,
+		hash_range,
+		hash_combine,
+		NULL,
+		pool
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(hash.hash == expected.hash);
+	fail_unless(hash.power == expected.power);
+
+	bs_free(bs);
+	bs_pool_free(pool);
+}
+END_TEST
+
+START_TEST(test_fold_parallel_totals)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = create_parallel_input();
+	uint64_t cTotal, cExpected;
+	unsigned int total;
+	BSresult result;
+
+	bs_cpu_limit(0);
+	bs_fold_sum(bs, &total);
+	cExpected = total;
+	bs_cpu_limit(~0u);
+
+	result = bs_sum64_parallel(bs, &cTotal, pool);
+	fail_unless(result == BS_OK);
+	fail_unless(cTotal == cExpected);
+
+	bs_cpu_limit(0);
+	bs_fold_bitcount(bs, &total);
+	cExpected = total;
+	bs_cpu_limit(~0u);
+
+	result = bs_popcount_parallel(bs, &cTotal, pool);
+	fail_unless(result == BS_OK);
+	fail_unless(cTotal == cExpected);
+
+	bs_free(bs);
+	bs_pool_free(pool);
+}
+END_TEST
+
+START_TEST(test_fold_parallel_failure)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = create_parallel_input();
+	struct BSHash hash;
+	BSresult result;
+
+	/* Only the last range is short */
+	result = bs_fold_parallel(
+		bs,
+		&hash,
+		sizeof(hash),
+		&hashIdentity,
+		fail_range,
+		hash_combine,
+		NULL,
+		pool
+	);
+	fail_unless(result == BS_INVALID);
+
+	result = bs_fold_parallel(
+		bs,
+		&hash,
+		sizeof(hash),
+		&hashIdentity,
+		hash_range,
+		fail_combine,
+		NULL,
+		pool
+	);
+	fail_unless(result == BS_OVERFLOW);
+
+	bs_free(bs);
+	bs_pool_free(pool);
+}
+END_TEST
+
+START_TEST(test_fold_parallel_empty_bs)
+{
+	BS *bs = bs_create();
+	struct BSHash hash = { 7, 7 };
+	BSresult result;
+
+	result = bs_fold_parallel(
+		bs,
+		&hash,
+		sizeof(hash),
+		&hashIdentity,
+		hash_range,
+		fail_combine,
+		NULL,
+		NULL
+	);
+	fail_unless(result == BS_OK);
+	fail_unless(hash.hash == 0);
+	fail_unless(hash.power == 1);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_fold_parallel_zero_size)
+{
+	BS *bs = bs_create_size(1);
+	struct BSHash hash;
+	BSresult result;
+
+	result = bs_fold_parallel(
+		bs,
+		&hash,
+		0,
+		&hashIdentity,
+		hash_range,
+		hash_combine,
+		NULL,
+		NULL
+	);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+
 /* ==================== */
 /* NULL parameter tests */
 /* ==================== */
 
+START_TEST(test_fold_parallel_null_pointers)
+{
+	BS *bs = bs_create();
+	struct BSHash hash;
+
+	fail_unless(bs_fold_parallel(NULL, &hash, sizeof(hash), &hashIdentity,
+		hash_range, hash_combine, NULL, NULL) == BS_NULL);
+	fail_unless(bs_fold_parallel(bs, NULL, sizeof(hash), &hashIdentity,
+		hash_range, hash_combine, NULL, NULL) == BS_NULL);
+	fail_unless(bs_fold_parallel(bs, &hash, sizeof(hash), NULL,
+		hash_range, hash_combine, NULL, NULL) == BS_NULL);
+	fail_unless(bs_fold_parallel(bs, &hash, sizeof(hash), &hashIdentity,
+		NULL, hash_combine, NULL, NULL) == BS_NULL);
+	fail_unless(bs_fold_parallel(bs, &hash, sizeof(hash), &hashIdentity,
+		hash_range, NULL, NULL, NULL) == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_fold_blocks_null_bs)
+{
+	BSresult result;
+
+	result = bs_fold_blocks(NULL, 1, sum_block, (void *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_fold_blocks_null_operation)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_fold_blocks(bs, 1, NULL, (void *) 0xDEADBEEF);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
 START_TEST(test_generic_fold_null_bs)
 {
 	BSresult result;
@@ -249,11 +839,36 @@ main(/* int argc, char **argv */)
 	tcase_add_loop_test(tc_core, test_folds_null_bs,     0, cFoldTypes);
 	tcase_add_loop_test(tc_core, test_folds_null_output, 0, cFoldTypes);
 
+	tcase_add_loop_test(tc_core, test_popcount_cpu_levels, 0, C_CPU_LEVELS);
+	tcase_add_test(tc_core, test_popcount_all_set);
+	tcase_add_test(tc_core, test_popcount_null_bs);
+	tcase_add_test(tc_core, test_popcount_null_count);
+
+	tcase_add_loop_test(tc_core, test_sum64_cpu_levels, 0, C_CPU_LEVELS);
+	tcase_add_test(tc_core, test_sum64_weighted);
+	tcase_add_test(tc_core, test_sum64_empty_bs);
+	tcase_add_test(tc_core, test_sum64_null_bs);
+	tcase_add_test(tc_core, test_sum64_null_output);
+
 	tcase_add_test(tc_core, test_fold_bad_operation);
 	tcase_add_test(tc_core, test_fold_bad_operation_empty_bs);
 
+	tcase_add_test(tc_core, test_fold_blocks);
+	tcase_add_test(tc_core, test_fold_blocks_failure);
+	tcase_add_test(tc_core, test_fold_blocks_empty_bs);
+	tcase_add_test(tc_core, test_fold_blocks_zero_size);
+
+	tcase_add_loop_test(tc_core, test_fold_parallel,         0, 2);
+	tcase_add_loop_test(tc_core, test_fold_parallel_totals,  0, 2);
+	tcase_add_loop_test(tc_core, test_fold_parallel_failure, 0, 2);
+	tcase_add_test(tc_core, test_fold_parallel_empty_bs);
+	tcase_add_test(tc_core, test_fold_parallel_zero_size);
+
 	tcase_add_test(tc_core, test_generic_fold_null_bs);
 	tcase_add_test(tc_core, test_generic_fold_null_operation);
+	tcase_add_test(tc_core, test_fold_blocks_null_bs);
+	tcase_add_test(tc_core, test_fold_blocks_null_operation);
+	tcase_add_test(tc_core, test_fold_parallel_null_pointers);
 
 	suite_add_tcase(s, tc_core);
 	sr = srunner_create(s);
@@ -0,0 +1,363 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "input.h"
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CB_INPUT 10000
+
+/* ========================== */
+/* Functions used for testing */
+/* ========================== */
+
+/* One-shot versions of each reduction, to compare against */
+
+static BSresult
+expected_sum(const BS *bs, void *result)
+{
+	return bs_sum64(bs, (uint64_t *) result);
+}
+
+static BSresult
+expected_popcount(const BS *bs, void *result)
+{
+	return bs_popcount(bs, (uint64_t *) result);
+}
+
+static BSresult
+expected_weighted(const BS *bs, void *result)
+{
+	uint64_t *rgValues = (uint64_t *) result;
+
+	return bs_sum64_weighted(bs, &rgValues[0], &rgValues[1]);
+}
+
+static BSresult
+expected_histogram(const BS *bs, void *result)
+{
+	return bs_histogram(bs, (uint64_t *) result);
+}
+
+static BSresult
+expected_stats(const BS *bs, void *result)
+{
+	return bs_stats(bs, BS_STAT_ALL, (BSstats *) result);
+}
+
+static BSresult
+expected_crc32(const BS *bs, void *result)
+{
+	return bs_crc32(bs, (uint32_t *) result);
+}
+
+static BSresult
+expected_crc32c(const BS *bs, void *result)
+{
+	return bs_crc32c(bs, (uint32_t *) result);
+}
+
+static BSresult
+expected_adler32(const BS *bs, void *result)
+{
+	return bs_adler32(bs, (uint32_t *) result);
+}
+
+static BSresult
+expected_fletcher16(const BS *bs, void *result)
+{
+	return bs_fletcher16(bs, (uint16_t *) result);
+}
+
+static BSresult
+expected_fletcher32(const BS *bs, void *result)
+{
+	return bs_fletcher32(bs, (uint32_t *) result);
+}
+
+static BSresult
+expected_xxh3_64(const BS *bs, void *result)
+{
+	return bs_hash64(bs, (uint64_t *) result);
+}
+
+static BSresult
+expected_xxh3_128(const BS *bs, void *result)
+{
+	return bs_hash128(bs, (BShash128 *) result);
+}
+
+struct BSReductionTestcase {
+	const char *szReduction;
+	size_t cbResult;
+	BSresult (*fpExpected) (const BS *bs, void *result);
+};
+
+static const struct BSReductionTestcase rgTestcases[] = {
+	{ "sum",        sizeof(uint64_t),       expected_sum        },
+	{ "popcount",   sizeof(uint64_t),       expected_popcount   },
+	{ "weighted",   2 * sizeof(uint64_t),   expected_weighted   },
+	{ "histogram",  256 * sizeof(uint64_t), expected_histogram  },
+	{ "stats",      sizeof(BSstats),        expected_stats      },
+	{ "crc32",      sizeof(uint32_t),       expected_crc32      },
+	{ "crc32c",     sizeof(uint32_t),       expected_crc32c     },
+	{ "adler32",    sizeof(uint32_t),       expected_adler32    },
+	{ "fletcher16", sizeof(uint16_t),       expected_fletcher16 },
+	{ "fletcher32", sizeof(uint32_t),       expected_fletcher32 },
+	{ "xxh3-64",    sizeof(uint64_t),       expected_xxh3_64    },
+	{ "xxh3-128",   sizeof(BShash128),      expected_xxh3_128   }
+};
+
+/* Stream buffer sizes, including odd sizes which split up 16-bit words */
+#define C_BUFFER_SIZES 6
+static const size_t rgcbBuffers[C_BUFFER_SIZES] = { 1, 2, 7, 64, 1000, 4099 };
+
+/* Every result fits in here, with space left over to spot overruns */
+typedef union BSResultBuffer {
+	uint64_t rgValues[2 * 256];
+	BSstats stats;
+} BSResultBuffer;
+
+/* Checks the fold so far matches the one-shot reduction of BS */
+static void
+check_final(const BSfoldstate *state, size_t iTestcase, const BS *bs)
+{
+	const struct BSReductionTestcase *tc = &rgTestcases[iTestcase];
+	BSResultBuffer expected, actual;
+	BSresult result;
+
+	/* Padding within the results must match too */
+	memset(&expected, 0, sizeof(expected));
+	memset(&actual, 0, sizeof(actual));
+
+	fail_unless(tc->fpExpected(bs, &expected) == BS_OK);
+	result = bs_foldstate_final(state, &actual, tc->cbResult);
+	fail_unless(result == BS_OK);
+	fail_unless(memcmp(&expected, &actual, sizeof(expected)) == 0);
+}
+
+/* ================ */
+/* Fold state tests */
+/* ================ */
+
+START_TEST(test_foldstate_stream)
+{
+	BSfoldstate *state = bs_foldstate_create(rgTestcases[_i].szReduction);
+	BS *bsInput = create_input(CB_INPUT);
+	const BSbyte *pbInput = bs_get_buffer(bsInput);
+	BS *bsBuffer;
+	size_t iBuffer, ibInput, cbChunk;
+	BSresult result;
+
+	fail_unless(state != NULL);
+
+	for (iBuffer = 0; iBuffer < C_BUFFER_SIZES; iBuffer++) {
+		bsBuffer = bs_create_size(rgcbBuffers[iBuffer]);
+		bs_foldstate_reset(state);
+
+		/* Data arrives in chunks which don't line up with the buffer */
+		for (ibInput = 0, cbChunk = 1;
+		     ibInput < CB_INPUT;
+		     ibInput += cbChunk, cbChunk = cbChunk * 3 % 1013 + 1) {
+			if (cbChunk > CB_INPUT - ibInput) {
+				cbChunk = CB_INPUT - ibInput;
+			}
+			result = bs_stream(
+				bsBuffer,
+				pbInput + ibInput,
+				cbChunk,
+				bs_foldstate_operation,
+				state
+			);
+			fail_unless(result == BS_OK);
+		}
+
+		result = bs_stream_flush(bsBuffer, bs_foldstate_operation, state);
+		fail_unless(result == BS_OK);
+
+		check_final(state, _i, bsInput);
+		bs_free(bsBuffer);
+	}
+
+	bs_foldstate_free(state);
+	bs_free(bsInput);
+}
+END_TEST
+
+START_TEST(test_foldstate_lengths)
+{
+	BSfoldstate *state = bs_foldstate_create(rgTestcases[_i].szReduction);
+	BS *bsInput = create_input(CB_INPUT);
+	const BSbyte *pbInput = bs_get_buffer(bsInput);
+	BS *bsPiece = bs_create(), *bsMessage;
+	size_t cbInput, cbFirst;
+
+	/* Each message is split in two, so either piece can be any length */
+	for (cbInput = 1; cbInput < 300; cbInput++) {
+		cbFirst = cbInput / 3;
+		bs_foldstate_reset(state);
+
+		if (cbFirst > 0) {
+			bs_load(bsPiece, pbInput, cbFirst);
+			fail_unless(bs_foldstate_update(state, bsPiece) == BS_OK);
+		}
+		bs_load(bsPiece, pbInput + cbFirst, cbInput - cbFirst);
+		fail_unless(bs_foldstate_update(state, bsPiece) == BS_OK);
+
+		bsMessage = bs_create_size(cbInput);
+		bs_load(bsMessage, pbInput, cbInput);
+		check_final(state, _i, bsMessage);
+		bs_free(bsMessage);
+	}
+
+	bs_foldstate_free(state);
+	bs_free(bsPiece);
+	bs_free(bsInput);
+}
+END_TEST
+
+START_TEST(test_foldstate_final_twice)
+{
+	BSfoldstate *state = bs_foldstate_create(rgTestcases[_i].szReduction);
+	BS *bsInput = create_input(101);
+	BS *bsDouble = bs_create_size(202);
+
+	bs_save(bsInput, bs_get_buffer(bsDouble));
+	bs_save(bsInput, bs_get_buffer(bsDouble) + 101);
+
+	/* Taking the value doesn't stop more being added */
+	bs_foldstate_update(state, bsInput);
+	check_final(state, _i, bsInput);
+	check_final(state, _i, bsInput);
+
+	bs_foldstate_update(state, bsInput);
+	check_final(state, _i, bsDouble);
+
+	/* Resetting starts again */
+	bs_foldstate_reset(state);
+	bs_foldstate_update(state, bsInput);
+	check_final(state, _i, bsInput);
+
+	bs_foldstate_free(state);
+	bs_free(bsDouble);
+	bs_free(bsInput);
+}
+END_TEST
+
+START_TEST(test_foldstate_empty)
+{
+	BSfoldstate *state = bs_foldstate_create(rgTestcases[_i].szReduction);
+	BS *bs = bs_create();
+
+	check_final(state, _i, bs);
+	fail_unless(bs_foldstate_update(state, bs) == BS_OK);
+	check_final(state, _i, bs);
+
+	bs_foldstate_free(state);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_foldstate_size)
+{
+	const struct BSReductionTestcase *tc = &rgTestcases[_i];
+	BSfoldstate *state = bs_foldstate_create(tc->szReduction);
+	BSResultBuffer value;
+	size_t size = 0;
+	BSresult result;
+
+	result = bs_foldstate_size(state, &size);
+	fail_unless(result == BS_OK);
+	fail_unless(size == tc->cbResult);
+
+	result = bs_foldstate_final(state, &value, tc->cbResult - 1);
+	fail_unless(result == BS_SHORT_BUFFER);
+
+	bs_foldstate_free(state);
+}
+END_TEST
+
+START_TEST(test_foldstate_unknown)
+{
+	fail_unless(bs_foldstate_create("no-such-reduction") == NULL);
+	fail_unless(bs_foldstate_create("") == NULL);
+	fail_unless(bs_foldstate_create(NULL) == NULL);
+}
+END_TEST
+
+START_TEST(test_foldstate_null_pointers)
+{
+	BSfoldstate *state = bs_foldstate_create("crc32");
+	BS *bs = bs_create();
+	BSResultBuffer value;
+	size_t size;
+
+	fail_unless(bs_foldstate_update(NULL, bs) == BS_NULL);
+	fail_unless(bs_foldstate_update(state, NULL) == BS_NULL);
+	fail_unless(bs_foldstate_operation(bs, NULL) == BS_NULL);
+	fail_unless(bs_foldstate_operation(NULL, state) == BS_NULL);
+	fail_unless(bs_foldstate_size(NULL, &size) == BS_NULL);
+	fail_unless(bs_foldstate_size(state, NULL) == BS_NULL);
+	fail_unless(bs_foldstate_final(NULL, &value, sizeof(value)) == BS_NULL);
+	fail_unless(bs_foldstate_final(state, NULL, sizeof(value)) == BS_NULL);
+
+	bs_foldstate_reset(NULL);
+	bs_foldstate_free(NULL);
+
+	bs_foldstate_free(state);
+	bs_free(bs);
+}
+END_TEST
+
+
+int
+main(/* int argc, char **argv */)
+{
+	Suite *s = suite_create("Fold state");
+	TCase *tc_core = tcase_create("Core");
+	size_t cTestcases =
+		sizeof(rgTestcases) / sizeof(struct BSReductionTestcase);
+	SRunner *sr;
+	int number_failed;
+
+	tcase_add_loop_test(tc_core, test_foldstate_stream,      0, cTestcases);
+	tcase_add_loop_test(tc_core, test_foldstate_lengths,     0, cTestcases);
+	tcase_add_loop_test(tc_core, test_foldstate_final_twice, 0, cTestcases);
+	tcase_add_loop_test(tc_core, test_foldstate_empty,       0, cTestcases);
+	tcase_add_loop_test(tc_core, test_foldstate_size,        0, cTestcases);
+	tcase_add_test(tc_core, test_foldstate_unknown);
+	tcase_add_test(tc_core, test_foldstate_null_pointers);
+
+	suite_add_tcase(s, tc_core);
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,381 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include "input.h"
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define U64(high, low) (((uint64_t) (high) << 32) | (uint64_t) (low))
+#define SEED U64(0x9E3779B9, 0x7F4A7C15)
+
+#define CB_LONG 3000
+
+#define C_CPU_LEVELS 3
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	~0u
+};
+
+struct BSHashTestcase {
+	size_t length;    /* Length of input made by create_input() */
+	uint64_t seed;
+	uint64_t hash64;
+	BShash128 hash128;
+};
+
+/* Calculated with the reference xxHash library */
+static const struct BSHashTestcase rgTestcases[] = {
+	{    0,    0, U64(0x2D068005, 0x38D394C2),
+	  { U64(0x6001C324, 0x468D497F), U64(0x99AA06D3, 0x014798D8) } },
+	{    0, SEED, U64(0x602B0E2C, 0xD6662C8B),
+	  { U64(0x4CA51769, 0x98171787), U64(0xD142977A, 0x2CCA554B) } },
+	{    1,    0, U64(0xC44BDFF4, 0x074EECDB),
+	  { U64(0xC44BDFF4, 0x074EECDB), U64(0xA6CD5E93, 0x92000F6A) } },
+	{    1, SEED, U64(0x062B185E, 0x4E01441A),
+	  { U64(0x062B185E, 0x4E01441A), U64(0xE366B8C9, 0x9A31DF50) } },
+	{    3,    0, U64(0xC3489259, 0xE968AD9E),
+	  { U64(0xC3489259, 0xE968AD9E), U64(0x656E81C5, 0x6E41FE02) } },
+	{    3, SEED, U64(0x71A5F088, 0xB9BF6B14),
+	  { U64(0x71A5F088, 0xB9BF6B14), U64(0x193B724F, 0xAA894163) } },
+	{    4,    0, U64(0xD3D60C15, 0x19014E89),
+	  { U64(0x81A65295, 0xDE8E7DDE), U64(0xAB5C3E74, 0x74D809DB) } },
+	{    4, SEED, U64(0x725545A3, 0xF20014CE),
+	  { U64(0x404C0CB4, 0x00A43F6A), U64(0x3C4BE873, 0x8C1CA5E5) } },
+	{    8,    0, U64(0xB88DEE77, 0xF6BF6980),
+	  { U64(0xEBABBD06, 0x95002FF6), U64(0xE4B9DD0B, 0x66FF3C50) } },
+	{    8, SEED, U64(0x3F5DA5B7, 0xAD256DE3),
+	  { U64(0xAFAAC201, 0xB17DE522), U64(0xBF56C664, 0x0E9A9197) } },
+	{    9,    0, U64(0x03688DCA, 0xD730D826),
+	  { U64(0x1C69C3F0, 0x4AAED08C), U64(0x82DDC95B, 0xC7600767) } },
+	{    9, SEED, U64(0xC332DEB8, 0x97105A63),
+	  { U64(0xF7EE6EFD, 0xB9C11CF0), U64(0x3A8C3953, 0x80D19465) } },
+	{   16,    0, U64(0x9DA23836, 0xADF2BE1E),
+	  { U64(0x94EAA17B, 0x20756F46), U64(0xDDF6C125, 0x4D70F767) } },
+	{   16, SEED, U64(0x6C542998, 0x420CA675),
+	  { U64(0xD18214BB, 0x29F42E22), U64(0x4A137456, 0xAE19BCA0) } },
+	{   17,    0, U64(0xF34C3C9C, 0xF5A112D1),
+	  { U64(0x735FE434, 0xDED90C3C), U64(0x263F67AF, 0x63088041) } },
+	{   17, SEED, U64(0x215D8E2B, 0x47EB92DB),
+	  { U64(0x365E7D43, 0x3A161892), U64(0x23338EDF, 0xB58EE008) } },
+	{  100,    0, U64(0x6DBB812C, 0xF19D012E),
+	  { U64(0x3DC31A0B, 0xA04530CD), U64(0x858BE3B5, 0x082C7EB7) } },
+	{  100, SEED, U64(0xE6B46695, 0x8CAA46AF),
+	  { U64(0x48A8EEA0, 0x36D73052), U64(0x52A8BAD7, 0x163FCF31) } },
+	{  128,    0, U64(0x65F3C2C0, 0x0FA93185),
+	  { U64(0xC6BD21EC, 0xC865F29F), U64(0xDD9E5AA9, 0xBD51CC9C) } },
+	{  128, SEED, U64(0x65C2E94E, 0xA7B79257),
+	  { U64(0x438E5B99, 0x9EE88B05), U64(0x45E311DA, 0x6869FA07) } },
+	{  129,    0, U64(0x28065C6E, 0xC25F5B25),
+	  { U64(0x7F4ACCB7, 0x6587485B), U64(0x00433635, 0xCF8D872E) } },
+	{  129, SEED, U64(0x17F705A2, 0x6996F1C9),
+	  { U64(0xF708A9ED, 0x675CD916), U64(0x787D1A40, 0x2A69ED5A) } },
+	{  240,    0, U64(0x4917A75C, 0x0EF8EED7),
+	  { U64(0xD10BEB4E, 0x0599E4B3), U64(0x89E3A0A2, 0xEE355D25) } },
+	{  240, SEED, U64(0xF906157A, 0x86B7EAC3),
+	  { U64(0x90FE0DE0, 0x3C6F6CD0), U64(0x0FA12FFA, 0x59FEBD06) } },
+	{  241,    0, U64(0x541B1922, 0x6F0052E8),
+	  { U64(0x541B1922, 0x6F0052E8), U64(0x75F4DA43, 0xF23CCE5A) } },
+	{  241, SEED, U64(0x6EC6D698, 0x19587A84),
+	  { U64(0x6EC6D698, 0x19587A84), U64(0x3DEE3A45, 0xC8BB9D70) } },
+	{ 1024,    0, U64(0x71BEE625, 0x238ADDB4),
+	  { U64(0x71BEE625, 0x238ADDB4), U64(0xA3DA96FB, 0xD6887361) } },
+	{ 1024, SEED, U64(0xB76CB481, 0x3088FE8E),
+	  { U64(0xB76CB481, 0x3088FE8E), U64(0x9515602D, 0xC5E20C5C) } },
+	{ 1025,    0, U64(0xD9B414F4, 0xE1BBF7AD),
+	  { U64(0xD9B414F4, 0xE1BBF7AD), U64(0xA53CD4FD, 0x16206676) } },
+	{ 1025, SEED, U64(0x8A4648C4, 0x70315844),
+	  { U64(0x8A4648C4, 0x70315844), U64(0x5E657B8C, 0xF784BFF8) } },
+	{ 3000,    0, U64(0xF8B5749E, 0xC75008AB),
+	  { U64(0xF8B5749E, 0xC75008AB), U64(0x79860A2F, 0x2A5B1990) } },
+	{ 3000, SEED, U64(0x6315293F, 0xF5EED57A),
+	  { U64(0x6315293F, 0xF5EED57A), U64(0xC61E2C34, 0x4CE985C5) } }
+};
+
+/* ========================== */
+/* Functions used for testing */
+/* ========================== */
+
+/* Hashes the first CBINPUT bytes of BS in pieces of varying length */
+static void
+hash_pieces(
+	const BS *bs,
+	size_t cbInput,
+	size_t cbPiece,
+	uint64_t seed,
+	uint64_t *hash64,
+	BShash128 *hash128
+)
+{
+	BShashstate *state = bs_hashstate_create(seed);
+	BS *bsPiece = bs_create();
+	size_t ibPiece = 0, cbLoad;
+
+	while (ibPiece < cbInput) {
+		cbLoad = cbInput - ibPiece < cbPiece ? cbInput - ibPiece : cbPiece;
+		bs_load(bsPiece, bs_get_buffer(bs) + ibPiece, cbLoad);
+		fail_unless(bs_hashstate_update(state, bsPiece) == BS_OK);
+		ibPiece += cbLoad;
+		cbPiece = cbPiece * 5 % 301 + 1;
+	}
+
+	fail_unless(bs_hashstate_digest64(state, hash64) == BS_OK);
+	fail_unless(bs_hashstate_digest128(state, hash128) == BS_OK);
+
+	bs_hashstate_free(state);
+	bs_free(bsPiece);
+}
+
+/* ========== */
+/* Hash tests */
+/* ========== */
+
+START_TEST(test_hash)
+{
+	const struct BSHashTestcase *tc = &rgTestcases[_i];
+	BS *bs = create_input(tc->length);
+	uint64_t hash64;
+	BShash128 hash128;
+	size_t iLevel;
+	BSresult result;
+
+	for (iLevel = 0; iLevel < C_CPU_LEVELS; iLevel++) {
+		bs_cpu_limit(rgCpuLevels[iLevel]);
+
+		result = bs_hash64_seeded(bs, tc->seed, &hash64);
+		fail_unless(result == BS_OK);
+		fail_unless(hash64 == tc->hash64);
+
+		result = bs_hash128_seeded(bs, tc->seed, &hash128);
+		fail_unless(result == BS_OK);
+		fail_unless(hash128.low == tc->hash128.low);
+		fail_unless(hash128.high == tc->hash128.high);
+
+		if (tc->seed == 0) {
+			result = bs_hash64(bs, &hash64);
+			fail_unless(result == BS_OK);
+			fail_unless(hash64 == tc->hash64);
+
+			result = bs_hash128(bs, &hash128);
+			fail_unless(result == BS_OK);
+			fail_unless(hash128.low == tc->hash128.low);
+			fail_unless(hash128.high == tc->hash128.high);
+		}
+	}
+
+	bs_cpu_limit(~0u);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_hash_seeds_differ)
+{
+	BS *bs = create_input(100);
+	uint64_t hash1, hash2;
+
+	bs_hash64_seeded(bs, 1, &hash1);
+	bs_hash64_seeded(bs, 2, &hash2);
+	fail_unless(hash1 != hash2);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_hash_null_bs)
+{
+	uint64_t hash64;
+	BShash128 hash128;
+
+	fail_unless(bs_hash64(NULL, &hash64) == BS_NULL);
+	fail_unless(bs_hash64_seeded(NULL, 0, &hash64) == BS_NULL);
+	fail_unless(bs_hash128(NULL, &hash128) == BS_NULL);
+	fail_unless(bs_hash128_seeded(NULL, 0, &hash128) == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_hash_null_hash)
+{
+	BS *bs = bs_create();
+
+	fail_unless(bs_hash64(bs, NULL) == BS_NULL);
+	fail_unless(bs_hash64_seeded(bs, 0, NULL) == BS_NULL);
+	fail_unless(bs_hash128(bs, NULL) == BS_NULL);
+	fail_unless(bs_hash128_seeded(bs, 0, NULL) == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+/* =============== */
+/* Streaming tests */
+/* =============== */
+
+START_TEST(test_hashstate)
+{
+	const struct BSHashTestcase *tc = &rgTestcases[_i];
+	BS *bs = create_input(tc->length);
+	uint64_t hash64;
+	BShash128 hash128;
+	size_t cbPiece;
+
+	for (cbPiece = 1; cbPiece <= 300; cbPiece += 37) {
+		hash_pieces(bs, tc->length, cbPiece, tc->seed, &hash64, &hash128);
+		fail_unless(hash64 == tc->hash64);
+		fail_unless(hash128.low == tc->hash128.low);
+		fail_unless(hash128.high == tc->hash128.high);
+	}
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_hashstate_lengths)
+{
+	BS *bs = create_input(CB_LONG);
+	BS *bsPrefix = bs_create();
+	uint64_t hash64, expected64;
+	BShash128 hash128, expected128;
+	size_t cbInput;
+
+	/* Every way the buffered input can line up with stripes and blocks */
+	for (cbInput = 1; cbInput <= CB_LONG; cbInput += 1 + cbInput / 16) {
+		bs_load(bsPrefix, bs_get_buffer(bs), cbInput);
+		bs_hash64_seeded(bsPrefix, _i, &expected64);
+		bs_hash128_seeded(bsPrefix, _i, &expected128);
+
+		hash_pieces(bs, cbInput, 1 + cbInput % 97, _i, &hash64, &hash128);
+		fail_unless(hash64 == expected64);
+		fail_unless(hash128.low == expected128.low);
+		fail_unless(hash128.high == expected128.high);
+	}
+
+	bs_free(bsPrefix);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_hashstate_digest_twice)
+{
+	BS *bs = create_input(CB_LONG);
+	BShashstate *state = bs_hashstate_create(0);
+	uint64_t hash64, expected64;
+
+	bs_hash64(bs, &expected64);
+
+	/* Digesting doesn't stop more being added */
+	bs_hashstate_update(state, bs);
+	bs_hashstate_digest64(state, &hash64);
+	fail_unless(hash64 == expected64);
+	bs_hashstate_digest64(state, &hash64);
+	fail_unless(hash64 == expected64);
+
+	bs_hashstate_update(state, bs);
+	bs_hashstate_digest64(state, &hash64);
+	fail_unless(hash64 != expected64);
+
+	/* Resetting starts again */
+	bs_hashstate_reset(state, 0);
+	bs_hashstate_update(state, bs);
+	bs_hashstate_digest64(state, &hash64);
+	fail_unless(hash64 == expected64);
+
+	bs_hashstate_free(state);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_hashstate_empty)
+{
+	BShashstate *state = bs_hashstate_create(0);
+	BS *bs = bs_create();
+	uint64_t hash64;
+	BShash128 hash128;
+
+	bs_hashstate_update(state, bs);
+	bs_hashstate_digest64(state, &hash64);
+	bs_hashstate_digest128(state, &hash128);
+	fail_unless(hash64 == rgTestcases[0].hash64);
+	fail_unless(hash128.low == rgTestcases[0].hash128.low);
+	fail_unless(hash128.high == rgTestcases[0].hash128.high);
+
+	bs_hashstate_free(state);
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_hashstate_null_pointers)
+{
+	BShashstate *state = bs_hashstate_create(0);
+	BS *bs = bs_create();
+	uint64_t hash64;
+	BShash128 hash128;
+
+	fail_unless(bs_hashstate_update(NULL, bs) == BS_NULL);
+	fail_unless(bs_hashstate_update(state, NULL) == BS_NULL);
+	fail_unless(bs_hashstate_digest64(NULL, &hash64) == BS_NULL);
+	fail_unless(bs_hashstate_digest64(state, NULL) == BS_NULL);
+	fail_unless(bs_hashstate_digest128(NULL, &hash128) == BS_NULL);
+	fail_unless(bs_hashstate_digest128(state, NULL) == BS_NULL);
+
+	bs_hashstate_reset(NULL, 0);
+	bs_hashstate_free(NULL);
+
+	bs_hashstate_free(state);
+	bs_free(bs);
+}
+END_TEST
+
+
+int
+main(/* int argc, char **argv */)
+{
+	Suite *s = suite_create("Hashing");
+	TCase *tc_core = tcase_create("Core");
+	size_t cTestcases = sizeof(rgTestcases) / sizeof(struct BSHashTestcase);
+	SRunner *sr;
+	int number_failed;
+
+	tcase_add_loop_test(tc_core, test_hash, 0, cTestcases);
+	tcase_add_test(tc_core, test_hash_seeds_differ);
+	tcase_add_test(tc_core, test_hash_null_bs);
+	tcase_add_test(tc_core, test_hash_null_hash);
+
+	tcase_add_loop_test(tc_core, test_hashstate, 0, cTestcases);
+	tcase_add_loop_test(tc_core, test_hashstate_lengths, 0, 2);
+	tcase_add_test(tc_core, test_hashstate_digest_twice);
+	tcase_add_test(tc_core, test_hashstate_empty);
+	tcase_add_test(tc_core, test_hashstate_null_pointers);
+
+	suite_add_tcase(s, tc_core);
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
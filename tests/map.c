@@ -28,6 +28,10 @@
 #include <check.h>
 #include <stdlib.h>
 
+#ifndef UNUSED
+#define UNUSED(x) (void)(x)
+#endif
+
 
 /* =============================== */
 /* Tiny functions used for testing */
@@ -57,19 +61,59 @@ map_noop(BS *bs)
 	return bs_map(bs, noop_byte);
 }
 
+static BSresult
+map_table_increment(BS *bs)
+{
+	BSbyte table[256];
+
+	bs_map_compile(table, increment_byte);
+
+	return bs_map_table(bs, table);
+}
+
+static BSresult
+map_chain_empty(BS *bs)
+{
+	BSmapchain *chain = bs_mapchain_create();
+	BSresult result;
+
+	result = bs_map_chain(bs, chain);
+	bs_mapchain_free(chain);
+
+	return result;
+}
+
+static BSresult
+map_chain_lower_increment_not(BS *bs)
+{
+	BSmapchain *chain = bs_mapchain_create();
+	BSresult result;
+
+	bs_mapchain_add_lowercase(chain);
+	bs_mapchain_add(chain, increment_byte);
+	bs_mapchain_add_not(chain);
+	result = bs_map_chain(bs, chain);
+	bs_mapchain_free(chain);
+
+	return result;
+}
+
 
 /* ========= */
 /* Testcases */
 /* ========= */
 
-#define C_MAPS 5
+#define C_MAPS 8
 
 static BSresult (*rgfMaps[C_MAPS])(BS *) = {
 	map_noop,
 	map_increment,
+	map_table_increment,
 	bs_map_uppercase,
 	bs_map_lowercase,
-	bs_map_not
+	bs_map_not,
+	map_chain_empty,
+	map_chain_lower_increment_not
 };
 
 struct BSMapTestcase {
@@ -85,12 +129,19 @@ rgTestcases[] = {
 	{ map_noop,         "@[`{+,AZaz09",         12, "@[`{+,AZaz09"         },
 	{ map_increment,    "00000",                 5, "11111"                },
 	{ map_increment,    "11111",                 5, "22222"                },
+	{ map_table_increment, "00000",              5, "11111"                },
+	{ map_table_increment, "\0\x7F\xFF",          3, "\x01\x80\0"           },
 	{ bs_map_uppercase, "\0\x7F\xFF",            3, "\0\x7F\xFF"           },
 	{ bs_map_uppercase, "@[`{+,AZaz09",         12, "@[`{+,AZAZ09"         },
 	{ bs_map_lowercase, "\0\x7F\xFF",            3, "\0\x7F\xFF"           },
 	{ bs_map_lowercase, "@[`{+,AZaz09",         12, "@[`{+,azaz09"         },
 	{ bs_map_not,       "\x01\x23\x45\x67\x89",  5, "\xFE\xDC\xBA\x98\x76" },
 	{ bs_map_not,       "\xAB\xCD\xEF",          3, "\x54\x32\x10"         },
+	{ bs_map_not,       "\0\x01\x02\x03\x04\x05\x06\x07\x08",
+	                                            9, "\xFF\xFE\xFD\xFC\xFB\xFA\xF9\xF8\xF7" },
+	{ map_chain_empty,  "\0\x7F\xFF",            3, "\0\x7F\xFF"           },
+	{ map_chain_lower_increment_not, "@[AZaz09", 8,
+	                            "\xBE\xA3\x9D\x84\x9D\x84\xCE\xC5"            },
 };
 
 
@@ -143,6 +194,339 @@ START_TEST(test_maps_null_bs)
 END_TEST
 
 
+/* ===================== */
+/* Processor-level tests */
+/* ===================== */
+
+#define C_CPU_LEVELS 4
+
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	BS_CPU_SSE2 | BS_CPU_AVX2,
+	~0u
+};
+
+#define CB_LONG 1000
+
+static BSbyte
+uppercase_byte(BSbyte byte)
+{
+	return (byte >= 'a' && byte <= 'z') ? byte - 'a' + 'A' : byte;
+}
+
+static BSbyte
+lowercase_byte(BSbyte byte)
+{
+	return (byte >= 'A' && byte <= 'Z') ? byte - 'A' + 'a' : byte;
+}
+
+static BSbyte
+not_byte(BSbyte byte)
+{
+	return ~byte;
+}
+
+static BSbyte
+scramble_byte(BSbyte byte)
+{
+	return (BSbyte) (byte * 167 + 13);
+}
+
+static BSresult
+map_table_scramble(BS *bs)
+{
+	BSbyte table[256];
+
+	bs_map_compile(table, scramble_byte);
+
+	return bs_map_table(bs, table);
+}
+
+static void
+check_long_map(BSresult (*pfMap)(BS *), BSbyte (*operation) (BSbyte byte))
+{
+	BSbyte rgbInput[CB_LONG];
+	size_t ibInput, cbInput;
+	BS *bs = bs_create();
+
+	for (ibInput = 0; ibInput < CB_LONG; ibInput++) {
+		rgbInput[ibInput] = (BSbyte) (ibInput * 7);
+	}
+
+	/* Odd lengths leave a tail after the last full vector */
+	for (cbInput = CB_LONG - 70; cbInput <= CB_LONG; cbInput += 7) {
+		fail_unless(bs_load(bs, rgbInput, cbInput) == BS_OK);
+		fail_unless(pfMap(bs) == BS_OK);
+		fail_unless(bs_size(bs) == cbInput);
+		for (ibInput = 0; ibInput < cbInput; ibInput++) {
+			fail_unless(
+				bs_get_byte(bs, ibInput) == operation(rgbInput[ibInput])
+			);
+		}
+	}
+
+	bs_free(bs);
+}
+
+START_TEST(test_maps_cpu_levels)
+{
+	bs_cpu_limit(rgCpuLevels[_i]);
+
+	check_long_map(bs_map_uppercase, uppercase_byte);
+	check_long_map(bs_map_lowercase, lowercase_byte);
+	check_long_map(bs_map_not, not_byte);
+	check_long_map(map_table_scramble, scramble_byte);
+
+	bs_cpu_limit(~0u);
+}
+END_TEST
+
+START_TEST(test_cpu_limit)
+{
+	unsigned int grfFeatures = bs_cpu_features();
+
+	bs_cpu_limit(BS_CPU_SSE2);
+	fail_unless((bs_cpu_features() & ~BS_CPU_SSE2) == 0);
+
+	bs_cpu_limit(0);
+	fail_unless(bs_cpu_features() == 0);
+
+	bs_cpu_limit(~0u);
+	fail_unless(bs_cpu_features() == grfFeatures);
+}
+END_TEST
+
+
+/* ========================== */
+/* Out-of-place mapping tests */
+/* ========================== */
+
+START_TEST(test_map_to)
+{
+	BS *src = bs_create(), *dst = bs_create();
+
+	bs_load(src, (BSbyte *) "abc", 3);
+
+	fail_unless(bs_map_to(dst, src, increment_byte) == BS_OK);
+	fail_unless(bs_size(dst) == 3);
+	fail_unless(memcmp(bs_get_buffer(dst), "bcd", 3) == 0);
+	fail_unless(memcmp(bs_get_buffer(src), "abc", 3) == 0);
+
+	/* A longer destination is cut down to size */
+	bs_load(dst, (BSbyte *) "0123456789", 10);
+	fail_unless(bs_map_to(dst, src, increment_byte) == BS_OK);
+	fail_unless(bs_size(dst) == 3);
+	fail_unless(memcmp(bs_get_buffer(dst), "bcd", 3) == 0);
+
+	bs_free(src);
+	bs_free(dst);
+}
+END_TEST
+
+START_TEST(test_map_table_to)
+{
+	BSbyte rgbInput[CB_LONG], table[256];
+	size_t ibInput;
+	BS *src = bs_create(), *dst = bs_create();
+
+	for (ibInput = 0; ibInput < CB_LONG; ibInput++) {
+		rgbInput[ibInput] = (BSbyte) ibInput;
+	}
+	bs_load(src, rgbInput, CB_LONG);
+	bs_map_compile(table, scramble_byte);
+
+	fail_unless(bs_map_table_to(dst, src, table) == BS_OK);
+	fail_unless(bs_size(dst) == CB_LONG);
+	for (ibInput = 0; ibInput < CB_LONG; ibInput++) {
+		fail_unless(bs_get_byte(src, ibInput) == rgbInput[ibInput]);
+		fail_unless(
+			bs_get_byte(dst, ibInput) == scramble_byte(rgbInput[ibInput])
+		);
+	}
+
+	bs_free(src);
+	bs_free(dst);
+}
+END_TEST
+
+
+/* ============================ */
+/* Context and block-wise tests */
+/* ============================ */
+
+static BSbyte
+xor_keystream_byte(BSbyte byte, size_t index, void *data)
+{
+	const BSbyte *rgbKey = data;
+
+	return byte ^ rgbKey[index % 3];
+}
+
+static BSresult
+xor_keystream_block(BSbyte *block, size_t length, size_t offset, void *data)
+{
+	size_t ibBlock;
+
+	for (ibBlock = 0; ibBlock < length; ibBlock++) {
+		block[ibBlock] = xor_keystream_byte(
+			block[ibBlock],
+			offset + ibBlock,
+			data
+		);
+	}
+
+	return BS_OK;
+}
+
+static BSresult
+fail_second_block(BSbyte *block, size_t length, size_t offset, void *data)
+{
+	UNUSED(length);
+	UNUSED(data);
+
+	if (offset > 0) {
+		return BS_OVERFLOW;
+	}
+	block[0] = 'X';
+
+	return BS_OK;
+}
+
+START_TEST(test_map_ctx)
+{
+	BS *bs = bs_create();
+	BSbyte rgbKey[3] = { 0x01, 0x02, 0x03 };
+
+	bs_load(bs, (BSbyte *) "\0\0\0\0\0", 5);
+
+	fail_unless(bs_map_ctx(bs, xor_keystream_byte, rgbKey) == BS_OK);
+	fail_unless(memcmp(bs_get_buffer(bs), "\x01\x02\x03\x01\x02", 5) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_blocks)
+{
+	BS *bs = bs_create();
+	BSbyte rgbKey[3] = { 0x01, 0x02, 0x03 };
+	size_t cbBlock;
+	BSresult result;
+
+	for (cbBlock = 1; cbBlock <= 6; cbBlock++) {
+		bs_load(bs, (BSbyte *) "\0\0\0\0\0", 5);
+		result = bs_map_blocks(bs, cbBlock, xor_keystream_block, rgbKey);
+		fail_unless(result == BS_OK);
+		fail_unless(memcmp(bs_get_buffer(bs), "\x01\x02\x03\x01\x02", 5) == 0);
+	}
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_blocks_failure)
+{
+	BS *bs = bs_create();
+
+	bs_load(bs, (BSbyte *) "abcd", 4);
+
+	fail_unless(bs_map_blocks(bs, 2, fail_second_block, NULL) == BS_OVERFLOW);
+	fail_unless(memcmp(bs_get_buffer(bs), "Xbcd", 4) == 0);
+
+	fail_unless(bs_map_blocks(bs, 0, fail_second_block, NULL) == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+/* ============== */
+/* Parallel tests */
+/* ============== */
+
+#define CB_PARALLEL (5 * 65536 + 123)
+
+static BS *
+create_parallel_input(void)
+{
+	BS *bs = bs_create_size(CB_PARALLEL);
+	BSbyte *pbBytes = bs_get_buffer(bs);
+	size_t ibBytes;
+
+	for (ibBytes = 0; ibBytes < CB_PARALLEL; ibBytes++) {
+		pbBytes[ibBytes] = (BSbyte) (ibBytes % 251);
+	}
+
+	return bs;
+}
+
+START_TEST(test_pool_threads)
+{
+	BSpool *pool = bs_pool_create(3);
+
+	fail_unless(pool != NULL);
+	fail_unless(bs_pool_threads(pool) == 3);
+	fail_unless(bs_pool_threads(NULL) == 1);
+
+	bs_pool_free(pool);
+	bs_pool_free(NULL);
+}
+END_TEST
+
+START_TEST(test_map_parallel)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = create_parallel_input();
+	BS *expected = create_parallel_input();
+	BSbyte table[256];
+
+	bs_map_compile(table, increment_byte);
+
+	fail_unless(bs_map_parallel(bs, scramble_byte, pool) == BS_OK);
+	bs_map(expected, scramble_byte);
+	fail_unless(bs_compare_equal(bs, expected) == BS_OK);
+
+	fail_unless(bs_map_table_parallel(bs, table, pool) == BS_OK);
+	bs_map_table(expected, table);
+	fail_unless(bs_compare_equal(bs, expected) == BS_OK);
+
+	bs_free(bs);
+	bs_free(expected);
+	bs_pool_free(pool);
+}
+END_TEST
+
+
+/* =============== */
+/* Map chain tests */
+/* =============== */
+
+START_TEST(test_map_chain_reuse)
+{
+	BSmapchain *chain = bs_mapchain_create();
+	BSbyte table[256];
+	BS *bs1 = bs_create();
+	BS *bs2 = bs_create();
+
+	bs_map_compile(table, increment_byte);
+	fail_unless(bs_mapchain_add_table(chain, table) == BS_OK);
+	fail_unless(bs_mapchain_add_uppercase(chain) == BS_OK);
+
+	bs_load(bs1, (BSbyte *) "`az", 3);
+	bs_load(bs2, (BSbyte *) "xyz{", 4);
+	fail_unless(bs_map_chain(bs1, chain) == BS_OK);
+	fail_unless(bs_map_chain(bs2, chain) == BS_OK);
+	fail_unless(memcmp(bs_get_buffer(bs1), "AB{", 3) == 0);
+	fail_unless(memcmp(bs_get_buffer(bs2), "YZ{|", 4) == 0);
+
+	bs_free(bs1);
+	bs_free(bs2);
+	bs_mapchain_free(chain);
+}
+END_TEST
+
+
 /* ==================== */
 /* NULL parameter tests */
 /* ==================== */
@@ -168,6 +552,181 @@ START_TEST(test_generic_map_null_operation)
 }
 END_TEST
 
+START_TEST(test_map_table_null_bs)
+{
+	BSbyte table[256];
+	BSresult result;
+
+	result = bs_map_table(NULL, table);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_map_table_null_table)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_table(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_compile_null_table)
+{
+	BSresult result;
+
+	result = bs_map_compile(NULL, noop_byte);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_map_compile_null_operation)
+{
+	BSbyte table[256];
+	BSresult result;
+
+	result = bs_map_compile(table, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_map_to_null_dst)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_to(NULL, bs, noop_byte);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_to_null_src)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_to(bs, NULL, noop_byte);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_table_to_null_src)
+{
+	BSbyte table[256];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_table_to(bs, NULL, table);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_ctx_null_bs)
+{
+	BSresult result;
+
+	result = bs_map_ctx(NULL, xor_keystream_byte, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_map_ctx_null_operation)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_ctx(bs, NULL, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_map_blocks_null_bs)
+{
+	BSresult result;
+
+	result = bs_map_blocks(NULL, 1, xor_keystream_block, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_map_blocks_null_operation)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_blocks(bs, 1, NULL, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_mapchain_add_null_chain)
+{
+	BSresult result;
+
+	result = bs_mapchain_add(NULL, noop_byte);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_mapchain_add_null_operation)
+{
+	BSmapchain *chain = bs_mapchain_create();
+	BSresult result;
+
+	result = bs_mapchain_add(chain, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_mapchain_free(chain);
+}
+END_TEST
+
+START_TEST(test_mapchain_add_table_null_chain)
+{
+	BSbyte table[256];
+	BSresult result;
+
+	result = bs_mapchain_add_table(NULL, table);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_mapchain_add_table_null_table)
+{
+	BSmapchain *chain = bs_mapchain_create();
+	BSresult result;
+
+	result = bs_mapchain_add_table(chain, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_mapchain_free(chain);
+}
+END_TEST
+
+START_TEST(test_map_chain_null_chain)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_map_chain(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
 
 int
 main(/* int argc, char **argv */)
@@ -182,8 +741,35 @@ main(/* int argc, char **argv */)
 	tcase_add_loop_test(tc_core, test_maps_empty_bs, 0, C_MAPS);
 	tcase_add_loop_test(tc_core, test_maps_null_bs,  0, C_MAPS);
 
+	tcase_add_loop_test(tc_core, test_maps_cpu_levels, 0, C_CPU_LEVELS);
+	tcase_add_test(tc_core, test_cpu_limit);
+	tcase_add_test(tc_core, test_map_to);
+	tcase_add_test(tc_core, test_map_table_to);
+	tcase_add_test(tc_core, test_map_ctx);
+	tcase_add_test(tc_core, test_map_blocks);
+	tcase_add_test(tc_core, test_map_blocks_failure);
+	tcase_add_test(tc_core, test_map_chain_reuse);
+	tcase_add_test(tc_core, test_pool_threads);
+	tcase_add_loop_test(tc_core, test_map_parallel, 0, 2);
+
 	tcase_add_test(tc_core, test_generic_map_null_bs);
 	tcase_add_test(tc_core, test_generic_map_null_operation);
+	tcase_add_test(tc_core, test_map_table_null_bs);
+	tcase_add_test(tc_core, test_map_table_null_table);
+	tcase_add_test(tc_core, test_map_compile_null_table);
+	tcase_add_test(tc_core, test_map_compile_null_operation);
+	tcase_add_test(tc_core, test_map_to_null_dst);
+	tcase_add_test(tc_core, test_map_to_null_src);
+	tcase_add_test(tc_core, test_map_table_to_null_src);
+	tcase_add_test(tc_core, test_map_ctx_null_bs);
+	tcase_add_test(tc_core, test_map_ctx_null_operation);
+	tcase_add_test(tc_core, test_map_blocks_null_bs);
+	tcase_add_test(tc_core, test_map_blocks_null_operation);
+	tcase_add_test(tc_core, test_mapchain_add_null_chain);
+	tcase_add_test(tc_core, test_mapchain_add_null_operation);
+	tcase_add_test(tc_core, test_mapchain_add_table_null_chain);
+	tcase_add_test(tc_core, test_mapchain_add_table_null_table);
+	tcase_add_test(tc_core, test_map_chain_null_chain);
 
 	suite_add_tcase(s, tc_core);
 	sr = srunner_create(s);
@@ -0,0 +1,417 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* =============================== */
+/* Tiny functions used for testing */
+/* =============================== */
+
+static const char *const *
+quote_table(void)
+{
+	static const char *rgszTable[256];
+
+	rgszTable['"'] = "\\\"";
+	rgszTable['\n'] = "\\n";
+
+	return rgszTable;
+}
+
+static const char *const *
+delete_table(void)
+{
+	static const char *rgszTable[256];
+
+	/* Deletes bytes ahead of growing ones, so the output runs ahead */
+	rgszTable['-'] = "";
+	rgszTable['+'] = "<plus>";
+
+	return rgszTable;
+}
+
+static const char *const *
+swap_table(void)
+{
+	static const char *rgszTable[256];
+
+	rgszTable['a'] = "b";
+
+	return rgszTable;
+}
+
+static const char *const *
+swap_grow_table(void)
+{
+	static const char *rgszTable[256];
+
+	/* Swaps bytes before growing ones, where the output catches up */
+	rgszTable['a'] = "b";
+	rgszTable['X'] = "xx";
+
+	return rgszTable;
+}
+
+static BSresult
+substitute_quotes(BS *bs)
+{
+	return bs_substitute(bs, quote_table());
+}
+
+static BSresult
+substitute_deletes(BS *bs)
+{
+	return bs_substitute(bs, delete_table());
+}
+
+static BSresult
+substitute_swaps(BS *bs)
+{
+	return bs_substitute(bs, swap_table());
+}
+
+static BSresult
+substitute_swaps_grow(BS *bs)
+{
+	return bs_substitute(bs, swap_grow_table());
+}
+
+static BSresult
+replace_shrink(BS *bs)
+{
+	return bs_replace(bs, (BSbyte *) "aa", 2, (BSbyte *) "b", 1);
+}
+
+static BSresult
+replace_grow(BS *bs)
+{
+	return bs_replace(bs, (BSbyte *) "aa", 2, (BSbyte *) "xyz", 3);
+}
+
+static BSresult
+replace_delete(BS *bs)
+{
+	return bs_replace(bs, (BSbyte *) ", ", 2, (BSbyte *) "", 0);
+}
+
+
+/* ========= */
+/* Testcases */
+/* ========= */
+
+#define C_TRANSFORMS 9
+
+static BSresult (*rgfTransforms[C_TRANSFORMS])(BS *) = {
+	substitute_quotes,
+	substitute_deletes,
+	substitute_swaps,
+	substitute_swaps_grow,
+	bs_escape_c,
+	bs_escape_percent,
+	replace_shrink,
+	replace_grow,
+	replace_delete,
+};
+
+struct BSReplaceTestcase {
+	BSresult (*pfTransform)(BS *); /* Function to test */
+	BSbyte *rgbInput;              /* Starting bytestream contents */
+	size_t cbInput;                /* Starting bytestream length */
+	const BSbyte *rgbOutput;       /* Expected bytestream contents */
+	size_t cbOutput;               /* Expected bytestream length */
+};
+
+static struct BSReplaceTestcase
+rgTestcases[] = {
+	{ substitute_quotes,  "say \"hi\"\n",  9, "say \\\"hi\\\"\\n", 12 },
+	{ substitute_quotes,  "plain",         5, "plain",              5 },
+	{ substitute_deletes, "--+",           3, "<plus>",             6 },
+	{ substitute_deletes, "+-+-",          4, "<plus><plus>",      12 },
+	{ substitute_deletes, "a-b-c",         5, "abc",                3 },
+	{ substitute_swaps,   "banana",        6, "bbnbnb",             6 },
+	{ substitute_swaps_grow, "aXY",        3, "bxxY",               4 },
+	{ substitute_swaps_grow, "aaXaa",      5, "bbxxbb",             6 },
+	{ bs_escape_c,        "tab\there",     8, "tab\\there",         9 },
+	{ bs_escape_c,        "\"\\\a\r",      4, "\\\"\\\\\\a\\r",      8 },
+	{ bs_escape_c,        "\0\x1F\x7F\xFF", 4, "\\000\\037\\177\\377", 16 },
+	{ bs_escape_c,        "clean",         5, "clean",              5 },
+	{ bs_escape_percent,  "a b&c",         5, "a%20b%26c",          9 },
+	{ bs_escape_percent,  "AZaz09-._~",   10, "AZaz09-._~",        10 },
+	{ bs_escape_percent,  "\xFF/",         2, "%FF%2F",             6 },
+	{ replace_shrink,     "aaa",           3, "ba",                 2 },
+	{ replace_shrink,     "xaaaay",        6, "xbby",               4 },
+	{ replace_grow,       "aaa",           3, "xyza",               4 },
+	{ replace_grow,       "aXaaYaa",       7, "aXxyzYxyz",          9 },
+	{ replace_grow,       "a",             1, "a",                  1 },
+	{ replace_delete,     "a, b, c",       7, "abc",                3 },
+};
+
+
+/* ============== */
+/* Testcase tests */
+/* ============== */
+
+START_TEST(test_transforms)
+{
+	struct BSReplaceTestcase testcase = rgTestcases[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_load(bs, testcase.rgbInput, testcase.cbInput);
+	fail_unless(result == BS_OK);
+
+	result = testcase.pfTransform(bs);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_size(bs) == testcase.cbOutput);
+	fail_unless(
+		memcmp(bs_get_buffer(bs), testcase.rgbOutput, testcase.cbOutput) == 0
+	);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_transforms_empty_bs)
+{
+	BSresult (*pfTransform)(BS *) = rgfTransforms[_i];
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = pfTransform(bs);
+	fail_unless(result == BS_OK);
+	fail_unless(bs_size(bs) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_transforms_null_bs)
+{
+	BSresult (*pfTransform)(BS *) = rgfTransforms[_i];
+	BSresult result;
+
+	result = pfTransform(NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+
+/* ===================== */
+/* Processor-level tests */
+/* ===================== */
+
+#define C_CPU_LEVELS 4
+
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	BS_CPU_SSE2 | BS_CPU_AVX2,
+	~0u
+};
+
+#define CB_LONG 1000
+
+/*
+ * Straightforward escapers to check against, returning the length written
+ */
+static size_t
+escape_c_byte(BSbyte byte, char *output)
+{
+	switch (byte) {
+		case '\a': return sprintf(output, "\\a");
+		case '\b': return sprintf(output, "\\b");
+		case '\t': return sprintf(output, "\\t");
+		case '\n': return sprintf(output, "\\n");
+		case '\v': return sprintf(output, "\\v");
+		case '\f': return sprintf(output, "\\f");
+		case '\r': return sprintf(output, "\\r");
+		case '"': return sprintf(output, "\\\"");
+		case '\\': return sprintf(output, "\\\\");
+
+		default:
+			if ((byte < 0x20) || (byte > 0x7E)) {
+				return sprintf(output, "\\%03o", byte);
+			}
+			return sprintf(output, "%c", byte);
+	}
+}
+
+static size_t
+escape_percent_byte(BSbyte byte, char *output)
+{
+	if (((byte >= 'A') && (byte <= 'Z'))
+	    || ((byte >= 'a') && (byte <= 'z'))
+	    || ((byte >= '0') && (byte <= '9'))
+	    || (byte == '-') || (byte == '.') || (byte == '_') || (byte == '~')) {
+		return sprintf(output, "%c", byte);
+	}
+	return sprintf(output, "%%%02X", byte);
+}
+
+START_TEST(test_escapes_cpu_levels)
+{
+	BSbyte rgbInput[CB_LONG];
+	char rgchExpected[CB_LONG * 4 + 1];
+	size_t ibInput, cbInput, cchExpected;
+	BS *bs = bs_create();
+	BSresult result;
+
+	bs_cpu_limit(rgCpuLevels[_i]);
+
+	/* Mostly printable, with every byte value somewhere */
+	for (ibInput = 0; ibInput < CB_LONG; ibInput++) {
+		rgbInput[ibInput] = (ibInput % 3 == 0)
+			? (BSbyte) (ibInput / 3)
+			: (BSbyte) (' ' + ibInput % 95);
+	}
+
+	/* Odd lengths leave a tail after the last full vector */
+	for (cbInput = CB_LONG - 70; cbInput <= CB_LONG; cbInput += 7) {
+		cchExpected = 0;
+		for (ibInput = 0; ibInput < cbInput; ibInput++) {
+			cchExpected += escape_c_byte(
+				rgbInput[ibInput],
+				rgchExpected + cchExpected
+			);
+		}
+
+		bs_load(bs, rgbInput, cbInput);
+		result = bs_escape_c(bs);
+		fail_unless(result == BS_OK);
+		fail_unless(bs_size(bs) == cchExpected);
+		fail_unless(memcmp(bs_get_buffer(bs), rgchExpected, cchExpected) == 0);
+
+		cchExpected = 0;
+		for (ibInput = 0; ibInput < cbInput; ibInput++) {
+			cchExpected += escape_percent_byte(
+				rgbInput[ibInput],
+				rgchExpected + cchExpected
+			);
+		}
+
+		bs_load(bs, rgbInput, cbInput);
+		result = bs_escape_percent(bs);
+		fail_unless(result == BS_OK);
+		fail_unless(bs_size(bs) == cchExpected);
+		fail_unless(memcmp(bs_get_buffer(bs), rgchExpected, cchExpected) == 0);
+	}
+
+	bs_free(bs);
+
+	bs_cpu_limit(~0u);
+}
+END_TEST
+
+
+/* ================== */
+/* Invalid data tests */
+/* ================== */
+
+START_TEST(test_substitute_null_table)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_substitute(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_replace_null_find)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_replace(bs, NULL, 1, (BSbyte *) "", 0);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_replace_null_replacement)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_replace(bs, (BSbyte *) "a", 1, NULL, 0);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_replace_empty_find)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	bs_load(bs, (BSbyte *) "abc", 3);
+
+	result = bs_replace(bs, (BSbyte *) "", 0, (BSbyte *) "x", 1);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+int
+main(/* int argc, char **argv */)
+{
+	Suite *s = suite_create("Replacements");
+	TCase *tc_core = tcase_create("Core");
+	size_t cTestcases = sizeof(rgTestcases) / sizeof(struct BSReplaceTestcase);
+	SRunner *sr;
+	int number_failed;
+
+	tcase_add_loop_test(tc_core, test_transforms,          0, cTestcases);
+	tcase_add_loop_test(tc_core, test_transforms_empty_bs, 0, C_TRANSFORMS);
+	tcase_add_loop_test(tc_core, test_transforms_null_bs,  0, C_TRANSFORMS);
+
+	tcase_add_loop_test(tc_core, test_escapes_cpu_levels, 0, C_CPU_LEVELS);
+
+	tcase_add_test(tc_core, test_substitute_null_table);
+	tcase_add_test(tc_core, test_replace_null_find);
+	tcase_add_test(tc_core, test_replace_null_replacement);
+	tcase_add_test(tc_core, test_replace_empty_find);
+
+	suite_add_tcase(s, tc_core);
+	sr = srunner_create(s);
+	srunner_set_fork_status(sr, CK_NOFORK);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
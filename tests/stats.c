@@ -0,0 +1,460 @@
+/*
+   ________        _____     ____________
+   ___  __ )____  ___  /_______  ___/_  /__________________ _______ ___
+   __  __  |_  / / /  __/  _ \____ \_  __/_  ___/  _ \  __ `/_  __ `__ \
+   _  /_/ /_  /_/ // /_ /  __/___/ // /_ _  /   /  __/ /_/ /_  / / / / /
+   /_____/ _\__, / \__/ \___//____/ \__/ /_/    \___/\__,_/ /_/ /_/ /_/
+           /____/
+
+   Byte stream manipulation library.
+   Copyright (C) 2013  Leigh Simpson <code@simpleigh.com>
+
+   This library is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 2.1 of the License, or any
+   later version.
+
+   This library is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+   License for more details.
+
+   A copy of the GNU Lesser General Public License is available within
+   COPYING.LGPL; alternatively write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "libbs.h"
+#include <check.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CB_PARALLEL (4 * 65536 + 1000)
+
+/* ========================== */
+/* Functions used for testing */
+/* ========================== */
+
+static BS *
+create_input(size_t cbInput)
+{
+	BS *bs = bs_create_size(cbInput);
+	BSbyte *pbBytes = bs_get_buffer(bs);
+	size_t ibBytes;
+
+	/* Runs of the same byte exercise the interleaved counters */
+	for (ibBytes = 0; ibBytes < cbInput; ibBytes++) {
+		pbBytes[ibBytes] = (BSbyte) ((ibBytes / 3) % 251);
+	}
+
+	return bs;
+}
+
+static void
+count_bytes(const BS *bs, uint64_t counts[256])
+{
+	const BSbyte *pbBytes = bs_get_buffer(bs);
+	size_t ibBytes;
+
+	memset(counts, 0, 256 * sizeof(uint64_t));
+	for (ibBytes = 0; ibBytes < bs_size(bs); ibBytes++) {
+		counts[pbBytes[ibBytes]]++;
+	}
+}
+
+/* =============== */
+/* Histogram tests */
+/* =============== */
+
+START_TEST(test_histogram)
+{
+	uint64_t rgcCounts[256], rgcExpected[256];
+	size_t cbInput;
+	BS *bs;
+	BSresult result;
+
+	for (cbInput = 1; cbInput < 100; cbInput++) {
+		bs = create_input(cbInput);
+		count_bytes(bs, rgcExpected);
+
+		memset(rgcCounts, 0xFF, sizeof(rgcCounts));
+		result = bs_histogram(bs, rgcCounts);
+		fail_unless(result == BS_OK);
+		fail_unless(memcmp(rgcCounts, rgcExpected, sizeof(rgcCounts)) == 0);
+
+		bs_free(bs);
+	}
+}
+END_TEST
+
+START_TEST(test_histogram_parallel)
+{
+	BSpool *pool = _i ? bs_pool_create(4) : NULL;
+	BS *bs = create_input(CB_PARALLEL);
+	uint64_t rgcCounts[256], rgcExpected[256];
+	BSresult result;
+
+	count_bytes(bs, rgcExpected);
+
+	memset(rgcCounts, 0xFF, sizeof(rgcCounts));
+	result = bs_histogram_parallel(bs, rgcCounts, pool);
+	fail_unless(result == BS_OK);
+	fail_unless(memcmp(rgcCounts, rgcExpected, sizeof(rgcCounts)) == 0);
+
+	memset(rgcCounts, 0xFF, sizeof(rgcCounts));
+	result = bs_histogram(bs, rgcCounts);
+	fail_unless(result == BS_OK);
+	fail_unless(memcmp(rgcCounts, rgcExpected, sizeof(rgcCounts)) == 0);
+
+	bs_free(bs);
+	bs_pool_free(pool);
+}
+END_TEST
+
+START_TEST(test_histogram_empty_bs)
+{
+	BS *bs = bs_create();
+	uint64_t rgcCounts[256], rgcExpected[256];
+	BSresult result;
+
+	memset(rgcExpected, 0, sizeof(rgcExpected));
+
+	memset(rgcCounts, 0xFF, sizeof(rgcCounts));
+	result = bs_histogram(bs, rgcCounts);
+	fail_unless(result == BS_OK);
+	fail_unless(memcmp(rgcCounts, rgcExpected, sizeof(rgcCounts)) == 0);
+
+	memset(rgcCounts, 0xFF, sizeof(rgcCounts));
+	result = bs_histogram_parallel(bs, rgcCounts, NULL);
+	fail_unless(result == BS_OK);
+	fail_unless(memcmp(rgcCounts, rgcExpected, sizeof(rgcCounts)) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_histogram_null_bs)
+{
+	uint64_t rgcCounts[256];
+	BSresult result;
+
+	result = bs_histogram(NULL, rgcCounts);
+	fail_unless(result == BS_NULL);
+
+	result = bs_histogram_parallel(NULL, rgcCounts, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+START_TEST(test_histogram_null_counts)
+{
+	BS *bs = bs_create();
+	BSresult result;
+
+	result = bs_histogram(bs, NULL);
+	fail_unless(result == BS_NULL);
+
+	result = bs_histogram_parallel(bs, NULL, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+/* ======================= */
+/* Distribution statistics */
+/* ======================= */
+
+START_TEST(test_entropy)
+{
+	uint64_t rgcCounts[256];
+	double entropy;
+	unsigned int iByte;
+	BSresult result;
+
+	/* Nothing, or a single value, carries no information */
+	memset(rgcCounts, 0, sizeof(rgcCounts));
+	result = bs_histogram_entropy(rgcCounts, &entropy);
+	fail_unless(result == BS_OK);
+	fail_unless(entropy == 0.0);
+
+	rgcCounts['a'] = 1000;
+	result = bs_histogram_entropy(rgcCounts, &entropy);
+	fail_unless(result == BS_OK);
+	fail_unless(entropy == 0.0);
+
+	/* Two equally likely values need one bit */
+	rgcCounts['b'] = 1000;
+	result = bs_histogram_entropy(rgcCounts, &entropy);
+	fail_unless(result == BS_OK);
+	fail_unless(fabs(entropy - 1.0) < 1e-9);
+
+	/* Probabilities of 1/2, 1/4 and 1/4 need 1.5 bits */
+	rgcCounts['a'] = 2000;
+	rgcCounts['c'] = 1000;
+	result = bs_histogram_entropy(rgcCounts, &entropy);
+	fail_unless(result == BS_OK);
+	fail_unless(fabs(entropy - 1.5) < 1e-9);
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		rgcCounts[iByte] = 7;
+	}
+	result = bs_histogram_entropy(rgcCounts, &entropy);
+	fail_unless(result == BS_OK);
+	fail_unless(fabs(entropy - 8.0) < 1e-9);
+}
+END_TEST
+
+START_TEST(test_chi_squared)
+{
+	uint64_t rgcCounts[256];
+	double chi_squared;
+	unsigned int iByte;
+	BSresult result;
+
+	memset(rgcCounts, 0, sizeof(rgcCounts));
+	result = bs_histogram_chi_squared(rgcCounts, &chi_squared);
+	fail_unless(result == BS_OK);
+	fail_unless(chi_squared == 0.0);
+
+	for (iByte = 0; iByte < 256; iByte++) {
+		rgcCounts[iByte] = 10;
+	}
+	result = bs_histogram_chi_squared(rgcCounts, &chi_squared);
+	fail_unless(result == BS_OK);
+	fail_unless(fabs(chi_squared) < 1e-9);
+
+	/* Moving ten counts gives two cells ten away from the expected ten */
+	rgcCounts[0] = 0;
+	rgcCounts[1] = 20;
+	result = bs_histogram_chi_squared(rgcCounts, &chi_squared);
+	fail_unless(result == BS_OK);
+	fail_unless(fabs(chi_squared - 20.0) < 1e-9);
+
+	/* A single value scores 255 times the number of bytes */
+	memset(rgcCounts, 0, sizeof(rgcCounts));
+	rgcCounts['x'] = 100;
+	result = bs_histogram_chi_squared(rgcCounts, &chi_squared);
+	fail_unless(result == BS_OK);
+	fail_unless(fabs(chi_squared - 25500.0) < 1e-6);
+}
+END_TEST
+
+START_TEST(test_statistics_null_pointers)
+{
+	uint64_t rgcCounts[256];
+	double value;
+	BSresult result;
+
+	memset(rgcCounts, 0, sizeof(rgcCounts));
+
+	result = bs_histogram_entropy(NULL, &value);
+	fail_unless(result == BS_NULL);
+	result = bs_histogram_entropy(rgcCounts, NULL);
+	fail_unless(result == BS_NULL);
+
+	result = bs_histogram_chi_squared(NULL, &value);
+	fail_unless(result == BS_NULL);
+	result = bs_histogram_chi_squared(rgcCounts, NULL);
+	fail_unless(result == BS_NULL);
+}
+END_TEST
+
+/* ========================= */
+/* Combined statistics tests */
+/* ========================= */
+
+#define C_CPU_LEVELS 4
+static const unsigned int rgCpuLevels[C_CPU_LEVELS] = {
+	0,
+	BS_CPU_SSE2,
+	BS_CPU_SSE2 | BS_CPU_AVX2,
+	~0u
+};
+
+static void
+check_stats(const BS *bs)
+{
+	const BSbyte *pbBytes = bs_get_buffer(bs);
+	BSstats stats;
+	uint64_t cExpected, rgcExpected[256];
+	size_t ibBytes;
+	BSbyte bMin = 255, bMax = 0;
+	BSresult result;
+
+	for (ibBytes = 0; ibBytes < bs_size(bs); ibBytes++) {
+		if (pbBytes[ibBytes] < bMin) {
+			bMin = pbBytes[ibBytes];
+		}
+		if (pbBytes[ibBytes] > bMax) {
+			bMax = pbBytes[ibBytes];
+		}
+	}
+	count_bytes(bs, rgcExpected);
+
+	memset(&stats, 0xAA, sizeof(stats));
+	result = bs_stats(bs, BS_STAT_ALL, &stats);
+	fail_unless(result == BS_OK);
+
+	bs_sum64(bs, &cExpected);
+	fail_unless(stats.sum == cExpected);
+	bs_popcount(bs, &cExpected);
+	fail_unless(stats.popcount == cExpected);
+	fail_unless(stats.min == bMin);
+	fail_unless(stats.max == bMax);
+	fail_unless(memcmp(stats.counts, rgcExpected, sizeof(rgcExpected)) == 0);
+}
+
+START_TEST(test_stats_cpu_levels)
+{
+	size_t cbInput;
+	BS *bs;
+
+	bs_cpu_limit(rgCpuLevels[_i]);
+
+	for (cbInput = 1; cbInput < 200; cbInput++) {
+		bs = create_input(cbInput);
+		check_stats(bs);
+
+		/* Extremes in the tail, after the last whole vector */
+		bs_get_buffer(bs)[cbInput - 1] = 255;
+		check_stats(bs);
+		bs_get_buffer(bs)[cbInput - 1] = 0;
+		bs_get_buffer(bs)[0] = 128;
+		check_stats(bs);
+
+		bs_free(bs);
+	}
+
+	/* Several blocks, with the extremes well inside */
+	bs = create_input(CB_PARALLEL);
+	bs_get_buffer(bs)[0] = 1;
+	bs_get_buffer(bs)[CB_PARALLEL / 2] = 255;
+	check_stats(bs);
+	bs_free(bs);
+
+	bs_cpu_limit(~0u);
+}
+END_TEST
+
+START_TEST(test_stats_selected)
+{
+	BS *bs = create_input(600);  /* Values 0 to 199, each three times */
+	BSstats stats, untouched;
+	BSresult result;
+
+	memset(&untouched, 0xAA, sizeof(untouched));
+
+	/* Statistics which weren't requested are left alone */
+	stats = untouched;
+	result = bs_stats(bs, BS_STAT_MIN, &stats);
+	fail_unless(result == BS_OK);
+	fail_unless(stats.min == 0);
+	fail_unless(stats.max == untouched.max);
+	fail_unless(stats.sum == untouched.sum);
+	fail_unless(stats.popcount == untouched.popcount);
+	fail_unless(stats.counts[0] == untouched.counts[0]);
+
+	stats = untouched;
+	result = bs_stats(bs, BS_STAT_SUM | BS_STAT_MAX, &stats);
+	fail_unless(result == BS_OK);
+	fail_unless(stats.max == 199);
+	fail_unless(stats.sum == 3 * (199 * 200 / 2));
+	fail_unless(stats.min == untouched.min);
+	fail_unless(stats.popcount == untouched.popcount);
+
+	/* Asking for nothing does nothing */
+	stats = untouched;
+	result = bs_stats(bs, 0, &stats);
+	fail_unless(result == BS_OK);
+	fail_unless(memcmp(&stats, &untouched, sizeof(stats)) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_stats_empty_bs)
+{
+	BS *bs = bs_create();
+	BSstats stats;
+	uint64_t rgcExpected[256];
+	BSresult result;
+
+	memset(rgcExpected, 0, sizeof(rgcExpected));
+	memset(&stats, 0xAA, sizeof(stats));
+
+	result = bs_stats(bs, BS_STAT_ALL, &stats);
+	fail_unless(result == BS_OK);
+	fail_unless(stats.sum == 0);
+	fail_unless(stats.popcount == 0);
+	fail_unless(stats.min == 255);
+	fail_unless(stats.max == 0);
+	fail_unless(memcmp(stats.counts, rgcExpected, sizeof(rgcExpected)) == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_stats_unknown_flags)
+{
+	BS *bs = bs_create();
+	BSstats stats;
+	BSresult result;
+
+	result = bs_stats(bs, BS_STAT_ALL + 1, &stats);
+	fail_unless(result == BS_INVALID);
+
+	bs_free(bs);
+}
+END_TEST
+
+START_TEST(test_stats_null_pointers)
+{
+	BS *bs = bs_create();
+	BSstats stats;
+	BSresult result;
+
+	result = bs_stats(NULL, BS_STAT_ALL, &stats);
+	fail_unless(result == BS_NULL);
+
+	result = bs_stats(bs, BS_STAT_ALL, NULL);
+	fail_unless(result == BS_NULL);
+
+	bs_free(bs);
+}
+END_TEST
+
+
+int
+main(/* int argc, char **argv */)
+{
+	Suite *s = suite_create("Statistics");
+	TCase *tc_core = tcase_create("Core");
+	SRunner *sr;
+	int number_failed;
+
+	tcase_add_test(tc_core, test_histogram);
+	tcase_add_loop_test(tc_core, test_histogram_parallel, 0, 2);
+	tcase_add_test(tc_core, test_histogram_empty_bs);
+	tcase_add_test(tc_core, test_histogram_null_bs);
+	tcase_add_test(tc_core, test_histogram_null_counts);
+
+	tcase_add_test(tc_core, test_entropy);
+	tcase_add_test(tc_core, test_chi_squared);
+	tcase_add_test(tc_core, test_statistics_null_pointers);
+
+	tcase_add_loop_test(tc_core, test_stats_cpu_levels, 0, C_CPU_LEVELS);
+	tcase_add_test(tc_core, test_stats_selected);
+	tcase_add_test(tc_core, test_stats_empty_bs);
+	tcase_add_test(tc_core, test_stats_unknown_flags);
+	tcase_add_test(tc_core, test_stats_null_pointers);
+
+	suite_add_tcase(s, tc_core);
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -111,6 +111,32 @@ START_TEST(test_stream)
 }
 END_TEST
 
+START_TEST(test_stream_partial_then_chunks)
+{
+	struct operation_data data = { 0, 0, "" };
+	BS *bs = bs_create_size(5);
+	BSresult result;
+
+	/* Whole chunks after topping up a partial one are copied in full */
+	result = bs_stream(bs, stream, 2, operation, &data);
+	fail_unless(result == BS_OK);
+
+	result = bs_stream(bs, stream, 10, operation, &data);
+	fail_unless(result == BS_OK);
+	fail_unless(data.cCalls == 2);
+	fail_unless(data.cbWritten == 10);
+
+	result = bs_stream_flush(bs, operation, &data);
+	fail_unless(result == BS_OK);
+	fail_unless(data.cCalls == 3);
+	fail_unless(data.cbWritten == 12);
+
+	fail_unless(strcmp(data.szData, "121234567890") == 0);
+
+	bs_free(bs);
+}
+END_TEST
+
 static BSresult
 operation_invalid(const BS *bs, void *data)
 {
@@ -249,6 +275,7 @@ main(/* int argc, char **argv */)
 	int number_failed;
 
 	tcase_add_test(tc_core, test_stream);
+	tcase_add_test(tc_core, test_stream_partial_then_chunks);
 	tcase_add_test(tc_core, test_stream_bad_operation);
 	tcase_add_test(tc_core, test_stream_empty_bs);
 	tcase_add_test(tc_core, test_stream_null_bs);